@@ -0,0 +1,86 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRCCLOCK_H
+#define IRCCLOCK_H
+
+#include <IrcGlobal>
+#include <QtCore/qobject.h>
+#include <QtCore/qdatetime.h>
+#include <QtCore/qmetatype.h>
+#include <QtCore/qscopedpointer.h>
+
+IRC_BEGIN_NAMESPACE
+
+class IrcClockPrivate;
+
+class IRC_CORE_EXPORT IrcClock : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(Mode mode READ mode CONSTANT)
+    Q_PROPERTY(qint64 elapsed READ elapsed)
+    Q_PROPERTY(int pendingTimers READ pendingTimers)
+    Q_ENUMS(Mode)
+
+public:
+    enum Mode {
+        RealTime,
+        VirtualTime
+    };
+
+    explicit IrcClock(QObject* parent = nullptr);
+    explicit IrcClock(Mode mode, QObject* parent = nullptr);
+    ~IrcClock() override;
+
+    static IrcClock* system();
+
+    Mode mode() const;
+
+    qint64 elapsed() const;
+    qint64 currentMSecsSinceEpoch() const;
+    QDateTime currentDateTime() const;
+
+    int pendingTimers() const;
+
+public Q_SLOTS:
+    void advance(qint64 msecs);
+    bool advanceToNextTimer();
+
+private:
+    friend class IrcTimer;
+    QScopedPointer<IrcClockPrivate> d_ptr;
+    Q_DECLARE_PRIVATE(IrcClock)
+    Q_DISABLE_COPY(IrcClock)
+};
+
+IRC_END_NAMESPACE
+
+Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcClock*))
+Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcClock::Mode))
+
+#endif // IRCCLOCK_H
@@ -148,6 +148,8 @@ public:
     Q_INVOKABLE static IrcCommand* createWhois(const QString& user);
     Q_INVOKABLE static IrcCommand* createWhowas(const QString& user, int count = 1);
 
+    static QList<IrcCommand*> createPacked(Type type, const QStringList& targets, const QStringList& arguments = QStringList(), IrcNetwork* network = nullptr);
+
 private:
     QScopedPointer<IrcCommandPrivate> d_ptr;
     Q_DECLARE_PRIVATE(IrcCommand)
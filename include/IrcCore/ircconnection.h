@@ -41,8 +41,11 @@
 
 IRC_BEGIN_NAMESPACE
 
+class IrcClock;
 class IrcCommand;
 class IrcProtocol;
+class IrcReconnectPolicy;
+class IrcConnectionStatistics;
 class IrcConnectionPrivate;
 
 class IRC_CORE_EXPORT IrcConnection : public QObject
@@ -73,7 +76,21 @@ class IRC_CORE_EXPORT IrcConnection : public QObject
     Q_PROPERTY(QStringList supportedSaslMechanisms READ supportedSaslMechanisms CONSTANT)
     Q_PROPERTY(QVariantMap ctcpReplies READ ctcpReplies WRITE setCtcpReplies NOTIFY ctcpRepliesChanged)
     Q_PROPERTY(IrcNetwork* network READ network CONSTANT)
+    Q_PROPERTY(IrcConnectionStatistics* statistics READ statistics CONSTANT)
     Q_PROPERTY(IrcProtocol* protocol READ protocol WRITE setProtocol)
+    Q_PROPERTY(int readLineLimit READ readLineLimit WRITE setReadLineLimit)
+    Q_PROPERTY(int readTimeLimit READ readTimeLimit WRITE setReadTimeLimit)
+    Q_PROPERTY(int readHighWatermark READ readHighWatermark WRITE setReadHighWatermark)
+    Q_PROPERTY(int readLowWatermark READ readLowWatermark WRITE setReadLowWatermark)
+    Q_PROPERTY(qint64 bufferedBytes READ bufferedBytes)
+    Q_PROPERTY(int raceCount READ raceCount WRITE setRaceCount)
+    Q_PROPERTY(int raceInterval READ raceInterval WRITE setRaceInterval)
+    Q_PROPERTY(IrcReconnectPolicy* reconnectPolicy READ reconnectPolicy WRITE setReconnectPolicy)
+    Q_PROPERTY(bool sessionResumptionEnabled READ isSessionResumptionEnabled WRITE setSessionResumptionEnabled)
+    Q_PROPERTY(int sessionCacheHits READ sessionCacheHits)
+    Q_PROPERTY(int sessionCacheMisses READ sessionCacheMisses)
+    Q_PROPERTY(bool optimisticHandshakeEnabled READ isOptimisticHandshakeEnabled WRITE setOptimisticHandshakeEnabled)
+    Q_PROPERTY(IrcClock* clock READ clock WRITE setClock NOTIFY clockChanged)
     Q_ENUMS(Status)
 
 public:
@@ -153,10 +170,48 @@ public:
     void setCtcpReplies(const QVariantMap& replies);
 
     IrcNetwork* network() const;
+    IrcConnectionStatistics* statistics() const;
 
     IrcProtocol* protocol() const;
     void setProtocol(IrcProtocol* protocol);
 
+    int readLineLimit() const;
+    void setReadLineLimit(int lines);
+
+    int readTimeLimit() const;
+    void setReadTimeLimit(int usecs);
+
+    int readHighWatermark() const;
+    void setReadHighWatermark(int bytes);
+
+    int readLowWatermark() const;
+    void setReadLowWatermark(int bytes);
+
+    qint64 bufferedBytes() const;
+    Q_INVOKABLE qint64 memoryUsage() const;
+
+    int raceCount() const;
+    void setRaceCount(int count);
+
+    int raceInterval() const;
+    void setRaceInterval(int msecs);
+
+    IrcReconnectPolicy* reconnectPolicy() const;
+    void setReconnectPolicy(IrcReconnectPolicy* policy);
+
+    bool isSessionResumptionEnabled() const;
+    void setSessionResumptionEnabled(bool enabled);
+
+    int sessionCacheHits() const;
+    int sessionCacheMisses() const;
+    Q_INVOKABLE void clearSessionCache();
+
+    bool isOptimisticHandshakeEnabled() const;
+    void setOptimisticHandshakeEnabled(bool enabled);
+
+    IrcClock* clock() const;
+    void setClock(IrcClock* clock);
+
     void installMessageFilter(QObject* filter);
     void removeMessageFilter(QObject* filter);
 
@@ -233,6 +288,7 @@ Q_SIGNALS:
     void secureChanged(bool secure);
     void saslMechanismChanged(const QString& mechanism);
     void ctcpRepliesChanged(const QVariantMap& replies);
+    void clockChanged(IrcClock* clock);
 
     void destroyed(IrcConnection* connection);
 
@@ -251,9 +307,14 @@ private:
     Q_PRIVATE_SLOT(d_func(), void _irc_error(QAbstractSocket::SocketError))
     Q_PRIVATE_SLOT(d_func(), void _irc_state(QAbstractSocket::SocketState))
     Q_PRIVATE_SLOT(d_func(), void _irc_sslErrors())
+    Q_PRIVATE_SLOT(d_func(), void _irc_sessionTicket())
     Q_PRIVATE_SLOT(d_func(), void _irc_reconnect())
     Q_PRIVATE_SLOT(d_func(), void _irc_readData())
     Q_PRIVATE_SLOT(d_func(), void _irc_filterDestroyed(QObject*))
+    Q_PRIVATE_SLOT(d_func(), void _irc_drainOutbound())
+    Q_PRIVATE_SLOT(d_func(), void _irc_raceNext())
+    Q_PRIVATE_SLOT(d_func(), void _irc_raceConnected())
+    Q_PRIVATE_SLOT(d_func(), void _irc_raceError())
 };
 
 #ifndef QT_NO_DEBUG_STREAM
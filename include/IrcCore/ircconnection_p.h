@@ -30,6 +30,9 @@
 #define IRCCONNECTION_P_H
 
 #include "ircconnection.h"
+#include "ircreconnectpolicy.h"
+#include "irctraffic.h"
+#include "irctimer_p.h"
 
 #include <QSet>
 #include <QList>
@@ -39,12 +42,47 @@
 #include <QString>
 #include <QByteArray>
 #include <QAbstractSocket>
+#include <QAtomicPointer>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QPointer>
 
 IRC_BEGIN_NAMESPACE
 
 class IrcMessageFilter;
 class IrcCommandFilter;
 
+struct IrcOutboundNode
+{
+    QAtomicPointer<IrcOutboundNode> next;
+    QByteArray data;
+    IrcCommand* command = nullptr;
+};
+
+struct IrcServerRacer
+{
+    QAbstractSocket* socket = nullptr;
+    int server = -1;
+    QString host;
+    int port = 6667;
+    bool secure = false;
+};
+
+class IrcOutboundQueue
+{
+public:
+    IrcOutboundQueue();
+    ~IrcOutboundQueue();
+
+    void enqueue(IrcOutboundNode* node);
+    IrcOutboundNode* dequeue();
+
+private:
+    QAtomicPointer<IrcOutboundNode> head;
+    IrcOutboundNode* tail;
+    IrcOutboundNode stub;
+};
+
 class IrcConnectionPrivate
 {
     Q_DECLARE_PUBLIC(IrcConnection)
@@ -59,13 +97,22 @@ public:
     void _irc_error(QAbstractSocket::SocketError error);
     void _irc_state(QAbstractSocket::SocketState state);
     void _irc_sslErrors();
+    void _irc_sessionTicket();
     void _irc_reconnect();
     void _irc_readData();
 
     void _irc_filterDestroyed(QObject* filter);
+    void _irc_drainOutbound();
+    void _irc_raceNext();
+    void _irc_raceConnected();
+    void _irc_raceError();
 
     void open();
     void reconnect();
+    void post(IrcOutboundNode* node);
+    void startRace();
+    void abortRace();
+    void resumeSession();
     void setConnectionCount(int count);
     void setNick(const QString& nick);
     void setStatus(IrcConnection::Status status);
@@ -82,6 +129,7 @@ public:
     IrcConnection* q_ptr = nullptr;
     QByteArray encoding;
     IrcNetwork* network = nullptr;
+    IrcConnectionStatistics* statistics = nullptr;
     IrcProtocol* protocol = nullptr;
     QAbstractSocket* socket = nullptr;
     QString host;
@@ -95,7 +143,14 @@ public:
     QStringList nickNames;
     QString displayName;
     QVariantMap userData;
-    QTimer reconnecter;
+    IrcTimer reconnecter;
+    int reconnectDelay = 0;
+    int reconnectAttempts = 0;
+    QPointer<IrcReconnectPolicy> reconnectPolicy;
+    QStringList attemptedServers;
+    qint64 attemptStart = 0;
+    QPointer<IrcTrafficRecorder> recorder;
+    QPointer<IrcClock> clock;
     int connectionCount = 0;
     QString saslMechanism;
     QVariantMap ctcpReplies;
@@ -108,6 +163,22 @@ public:
     QSet<int> replies;
     bool pendingOpen = false;
     bool closed = false;
+    int readLineLimit = 0;
+    int readTimeLimit = 0;
+    int readHighWatermark = 0;
+    int readLowWatermark = 0;
+    IrcOutboundQueue outbound;
+    QAtomicInt outboundScheduled;
+    int raceCount = 1;
+    int raceInterval = 250;
+    IrcTimer racer;
+    QList<IrcServerRacer> racers;
+    bool sessionResumption = false;
+    QHash<QString, QByteArray> sessionTickets;
+    int sessionCacheHits = 0;
+    int sessionCacheMisses = 0;
+    bool optimisticHandshake = false;
+    QHash<QString, QStringList> capabilityCache;
 };
 
 IRC_END_NAMESPACE
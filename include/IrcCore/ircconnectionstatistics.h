@@ -0,0 +1,117 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRCCONNECTIONSTATISTICS_H
+#define IRCCONNECTIONSTATISTICS_H
+
+#include <IrcGlobal>
+#include <IrcMessage>
+#include <QtCore/qlist.h>
+#include <QtCore/qobject.h>
+#include <QtCore/qvariant.h>
+#include <QtCore/qmetatype.h>
+#include <QtCore/qscopedpointer.h>
+
+IRC_BEGIN_NAMESPACE
+
+class IrcConnection;
+class IrcConnectionStatisticsPrivate;
+
+class IRC_CORE_EXPORT IrcConnectionStatistics : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(IrcConnection* connection READ connection CONSTANT)
+    Q_PROPERTY(qint64 bytesReceived READ bytesReceived)
+    Q_PROPERTY(qint64 bytesSent READ bytesSent)
+    Q_PROPERTY(qint64 linesReceived READ linesReceived)
+    Q_PROPERTY(qint64 linesSent READ linesSent)
+    Q_PROPERTY(qint64 bufferedBytes READ bufferedBytes)
+    Q_PROPERTY(int commandQueueDepth READ commandQueueDepth)
+    Q_PROPERTY(int reconnectCount READ reconnectCount)
+    Q_PROPERTY(qint64 lag READ lag)
+    Q_PROPERTY(bool filterProfilingEnabled READ isFilterProfilingEnabled WRITE setFilterProfilingEnabled)
+    Q_ENUMS(Timing)
+
+public:
+    ~IrcConnectionStatistics() override;
+
+    enum Timing {
+        ParseTime,
+        DecodeTime,
+        FilterTime,
+        DispatchTime,
+        RoundTripTime
+    };
+
+    IrcConnection* connection() const;
+
+    qint64 bytesReceived() const;
+    qint64 bytesSent() const;
+
+    qint64 linesReceived() const;
+    qint64 linesSent() const;
+
+    Q_INVOKABLE qint64 messageCount(IrcMessage::Type type) const;
+
+    Q_INVOKABLE qint64 timingCount(IrcConnectionStatistics::Timing timing) const;
+    Q_INVOKABLE qint64 timingTotal(IrcConnectionStatistics::Timing timing) const;
+    Q_INVOKABLE QList<qint64> timingHistogram(IrcConnectionStatistics::Timing timing) const;
+    static int histogramBuckets();
+
+    qint64 bufferedBytes() const;
+
+    int commandQueueDepth() const;
+
+    int reconnectCount() const;
+
+    qint64 lag() const;
+
+    bool isFilterProfilingEnabled() const;
+    void setFilterProfilingEnabled(bool enabled);
+    Q_INVOKABLE QVariantList filterProfile() const;
+
+    Q_INVOKABLE QVariantMap snapshot() const;
+
+public Q_SLOTS:
+    void reset();
+
+private:
+    friend class IrcConnection;
+    friend class IrcConnectionPrivate;
+    explicit IrcConnectionStatistics(IrcConnection* connection);
+
+    QScopedPointer<IrcConnectionStatisticsPrivate> d_ptr;
+    Q_DECLARE_PRIVATE(IrcConnectionStatistics)
+    Q_DISABLE_COPY(IrcConnectionStatistics)
+};
+
+IRC_END_NAMESPACE
+
+Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcConnectionStatistics*))
+
+#endif // IRCCONNECTIONSTATISTICS_H
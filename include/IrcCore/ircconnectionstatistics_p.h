@@ -0,0 +1,187 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRCCONNECTIONSTATISTICS_P_H
+#define IRCCONNECTIONSTATISTICS_P_H
+
+#include "ircconnectionstatistics.h"
+#include "irccore_p.h"
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMap>
+#include <QPointer>
+
+IRC_BEGIN_NAMESPACE
+
+class IrcStatisticsHistogram
+{
+public:
+    // bucket N holds durations below 2^N microseconds,
+    // and the last one everything that took longer
+    enum { BucketCount = 24 };
+
+    void record(qint64 nsecs);
+    void reset();
+
+    QAtomicInteger<qint64> count;
+    QAtomicInteger<qint64> total;
+    QAtomicInteger<qint64> buckets[BucketCount];
+};
+
+struct IrcFilterProfileKey
+{
+    QObject* filter;
+    bool command;
+    int type;
+
+    bool operator<(const IrcFilterProfileKey& other) const
+    {
+        if (filter != other.filter)
+            return filter < other.filter;
+        if (command != other.command)
+            return command < other.command;
+        return type < other.type;
+    }
+};
+
+struct IrcFilterProfile
+{
+    QString filter;
+    bool command = false;
+    int type = 0;
+    qint64 invocations = 0;
+    qint64 filtered = 0;
+    qint64 total = 0;
+    qint64 max = 0;
+};
+
+class IRC_CORE_EXPORT IrcConnectionStatisticsPrivate
+{
+    Q_DECLARE_PUBLIC(IrcConnectionStatistics)
+
+public:
+    static IrcConnectionStatisticsPrivate* get(const IrcConnectionStatistics* statistics)
+    {
+        return statistics ? statistics->d_ptr.data() : nullptr;
+    }
+
+    static void add(QAtomicInteger<qint64>& counter, qint64 value = 1)
+    {
+        counter.fetchAndAddRelaxed(value);
+    }
+
+    void countMessage(IrcMessage::Type type)
+    {
+        if (type >= IrcMessage::Unknown && type <= IrcMessage::Batch)
+            add(messages[type]);
+    }
+
+    // fed by IrcCommandQueue and IrcLagTimer
+    void setCommandQueueDepth(int depth);
+    void setLag(qint64 msecs);
+    void addRoundTripTime(qint64 msecs);
+
+    void profileFilter(QObject* filter, const char* className, const QString& objectName, bool command, int type, qint64 nsecs, bool filtered);
+    void removeFilterProfile(QObject* filter, bool command);
+
+    IrcConnectionStatistics* q_ptr = nullptr;
+    IrcConnection* connection = nullptr;
+    QAtomicInteger<qint64> bytesReceived;
+    QAtomicInteger<qint64> bytesSent;
+    QAtomicInteger<qint64> linesReceived;
+    QAtomicInteger<qint64> linesSent;
+    QAtomicInteger<qint64> messages[IrcMessage::Batch + 1];
+    IrcStatisticsHistogram timings[IrcConnectionStatistics::RoundTripTime + 1];
+    QAtomicInteger<qint64> bufferedBytes;
+    QAtomicInt commandQueueDepth;
+    QAtomicInt reconnectCount;
+    QAtomicInteger<qint64> lag{-1};
+    QAtomicInt filterProfiling;
+    mutable QMutex filterMutex;
+    QMap<IrcFilterProfileKey, IrcFilterProfile> filterProfiles;
+};
+
+class IrcStatisticsTimer
+{
+public:
+    IrcStatisticsTimer(IrcConnectionStatisticsPrivate* statistics, IrcConnectionStatistics::Timing timing)
+        : histogram(statistics ? &statistics->timings[timing] : nullptr)
+    {
+        if (histogram)
+            timer.start();
+    }
+
+    ~IrcStatisticsTimer()
+    {
+        if (histogram)
+            histogram->record(timer.nsecsElapsed());
+    }
+
+private:
+    IrcStatisticsHistogram* histogram;
+    QElapsedTimer timer;
+};
+
+class IrcFilterProfiler
+{
+public:
+    IrcFilterProfiler(IrcConnectionStatisticsPrivate* statistics, QObject* filter, bool command, int type)
+        : statistics(statistics && IrcPrivate::loadRelaxed(statistics->filterProfiling) ? statistics : nullptr),
+          className(nullptr), command(command), type(type)
+    {
+        if (this->statistics) {
+            // a filter may delete itself, so do not touch it afterwards
+            this->filter = filter;
+            className = filter->metaObject()->className();
+            objectName = filter->objectName();
+            timer.start();
+        }
+    }
+
+    void finish(bool filtered)
+    {
+        // nor profile it, the entries of a destroyed filter are gone
+        if (statistics && filter)
+            statistics->profileFilter(filter, className, objectName, command, type, timer.nsecsElapsed(), filtered);
+    }
+
+private:
+    IrcConnectionStatisticsPrivate* statistics;
+    QPointer<QObject> filter;
+    const char* className;
+    QString objectName;
+    bool command;
+    int type;
+    QElapsedTimer timer;
+};
+
+IRC_END_NAMESPACE
+
+#endif // IRCCONNECTIONSTATISTICS_P_H
@@ -30,13 +30,18 @@
 #define IRCCORE_H
 
 #include "irc.h"
+#include "ircclock.h"
 #include "irccommand.h"
 #include "ircconnection.h"
+#include "ircconnectionstatistics.h"
 #include "ircglobal.h"
 #include "ircmessage.h"
 #include "ircfilter.h"
 #include "ircnetwork.h"
 #include "ircprotocol.h"
+#include "ircreconnectpolicy.h"
+#include "irctrace.h"
+#include "irctraffic.h"
 
 IRC_BEGIN_NAMESPACE
 
@@ -33,6 +33,7 @@
 
 #include <QtCore/qlist.h>
 #include <QtCore/qset.h>
+#include <QtCore/qatomic.h>
 #include <QtCore/qstring.h>
 
 #if QT_VERSION < QT_VERSION_CHECK(5, 14, 0)
@@ -55,6 +56,26 @@ namespace IrcPrivate {
     template <typename T>
     static inline QList<T> setToList(const QSet<T> &set) { return set.toList(); }
 #endif
+
+    // QAtomicInteger::load() and store() are relaxed, but removed in Qt 6
+    template <typename T>
+    static inline T loadRelaxed(const QBasicAtomicInteger<T> &atomic)
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        return atomic.loadRelaxed();
+#else
+        return atomic.load();
+#endif
+    }
+    template <typename T, typename V>
+    static inline void storeRelaxed(QBasicAtomicInteger<T> &atomic, V value)
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+        atomic.storeRelaxed(T(value));
+#else
+        atomic.store(T(value));
+#endif
+    }
 }
 
 #ifndef Q_FALLTHROUGH
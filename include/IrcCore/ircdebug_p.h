@@ -31,52 +31,27 @@
 
 #include <IrcGlobal>
 #include <IrcConnection>
+#include "irccore_p.h"
 #include <QtCore/qdebug.h>
 #include <QtCore/qstring.h>
-#include <QtCore/qdatetime.h>
-#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
-#include <QRegularExpression>
-#else
-#include <QRegExp>
-#endif
+#include <QtCore/qatomic.h>
 
 IRC_BEGIN_NAMESPACE
 
 #ifndef IRC_DOXYGEN
-static bool irc_debug_enabled(IrcConnection* c, uint l);
-
-class IrcDebug
+class IRC_CORE_EXPORT IrcDebug
 {
 public:
     enum Level { None, Error, Status, Write, Read };
 
-    IrcDebug(IrcConnection* c, Level l) : enabled(irc_debug_enabled(c, l))
-#ifndef QT_NO_DEBUG_STREAM
-      , debug(&str)
-#endif // QT_NO_DEBUG_STREAM
-    {
-#ifndef QT_NO_DEBUG_STREAM
-        if (enabled) {
-            const QString desc = c->displayName();
-            const QString stamp = QDateTime::currentDateTime().toString(Qt::ISODate);
-            debug << qPrintable("[" + stamp + " " + desc + "]");
-            switch (l) {
-                case Error: debug << "!!"; break;
-                case Status: debug << "??"; break;
-                case Write: debug << "->"; break;
-                case Read: debug << "<-"; break;
-                default: break;
-            }
-        }
-#endif // QT_NO_DEBUG_STREAM
-    }
+    IrcDebug(IrcConnection* c, Level l);
+    ~IrcDebug();
 
-    ~IrcDebug() {
-#ifndef QT_NO_DEBUG_STREAM
-        if (enabled)
-            qDebug() << qPrintable(str);
-#endif // QT_NO_DEBUG_STREAM
-    }
+    // the level is cached after the environment has been read for the
+    // first time; until then it lets everything through to the slow path
+    static inline bool isEnabled(Level l) { return l <= IrcPrivate::loadRelaxed(maxLevel); }
+
+    static void flush();
 
     template<typename T>
     inline IrcDebug &operator<<(const T& t)
@@ -92,77 +67,22 @@ public:
     }
 
 private:
+    Level level;
     bool enabled;
+    qint64 stamp;
+    QString name;
     QString str;
 #ifndef QT_NO_DEBUG_STREAM
     QDebug debug;
 #endif // QT_NO_DEBUG_STREAM
+    static QBasicAtomicInt maxLevel;
+    friend struct IrcDebugConfig;
 };
 
-static bool irc_debug_enabled(IrcConnection* c, uint l)
-{
-    static QString dbg_name;
-    static uint dbg_level = IrcDebug::None;
-
-    static bool dbg_init = false;
-    if (!dbg_init) {
-        QByteArray lenv = qgetenv("IRC_DEBUG_LEVEL").toLower();
-        if (!lenv.isEmpty()) {
-            bool ok = false;
-            int number = lenv.toInt(&ok);
-            if (ok) {
-                dbg_level = number;
-            } else if (lenv == "none") {
-                dbg_level = IrcDebug::None;
-            } else if (lenv == "error") {
-                dbg_level = IrcDebug::Error;
-            } else if (lenv == "status") {
-                dbg_level = IrcDebug::Status;
-            } else if (lenv == "write") {
-                dbg_level = IrcDebug::Write;
-            } else if (lenv == "read") {
-                dbg_level = IrcDebug::Read;
-            } else {
-                qWarning("Unknown IRC_DEBUG_LEVEL value '%s'", lenv.data());
-                qWarning("Available values: 0-4, none, error, status, write, read.");
-            }
-        }
-
-        QByteArray denv = qgetenv("IRC_DEBUG");
-        if (!denv.isEmpty()) {
-            bool ok = false;
-            int number = denv.toInt(&ok);
-            if (ok) {
-                if (number == 0)
-                    dbg_level = IrcDebug::None;
-                else if (lenv.isEmpty())
-                    dbg_level = IrcDebug::Read;
-            }
-        }
-
-        dbg_name = QString::fromUtf8(qgetenv("IRC_DEBUG_NAME"));
-        if (!dbg_name.isEmpty() && lenv.isEmpty() && denv.isEmpty())
-            dbg_level = IrcDebug::Read;
-
-        dbg_init = true;
-    }
-    if (l <= dbg_level) {
-        if (dbg_name.isEmpty())
-            return true;
-
-#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
-        return QRegularExpression(QRegularExpression::wildcardToRegularExpression(dbg_name),
-                       QRegularExpression::CaseInsensitiveOption).match(c->displayName()).hasMatch();
-#else
-        return QRegExp(dbg_name,
-                   Qt::CaseInsensitive,
-                   QRegExp::Wildcard).exactMatch(c->displayName());
-#endif
-    }
-    return false;
-}
-
-#define ircDebug(Connection, Flag) IrcDebug(Connection, Flag)
+// the arguments are not evaluated at all when the level is disabled
+#define ircDebug(Connection, Flag) \
+    for (bool irc_debug_enabled = IrcDebug::isEnabled(Flag); irc_debug_enabled; irc_debug_enabled = false) \
+        IrcDebug(Connection, Flag)
 #endif // IRC_DOXYGEN
 
 IRC_END_NAMESPACE
@@ -0,0 +1,130 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRCMEMORY_P_H
+#define IRCMEMORY_P_H
+
+#include <IrcGlobal>
+#include <QtCore/qbytearray.h>
+#include <QtCore/qstring.h>
+#include <QtCore/qvariant.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qmap.h>
+#include <QtCore/qset.h>
+
+IRC_BEGIN_NAMESPACE
+
+// Estimates the heap bytes held by Qt values and containers. The numbers
+// are approximate: the allocator overhead is not counted, and implicitly
+// shared data is counted once for every holder.
+class IrcMemory
+{
+public:
+    // a QObject and its private data, without the dynamic properties
+    enum { ObjectSize = 128 };
+
+    static qint64 of(const QString& str)
+    {
+        return str.capacity() ? qint64(sizeof(QArrayData)) + (str.capacity() + 1) * qint64(sizeof(QChar)) : 0;
+    }
+
+    static qint64 of(const QByteArray& data)
+    {
+        return data.capacity() ? qint64(sizeof(QArrayData)) + data.capacity() + 1 : 0;
+    }
+
+    static qint64 of(const QVariant& value)
+    {
+        switch (value.userType()) {
+        case QMetaType::QString:
+            return of(value.toString());
+        case QMetaType::QByteArray:
+            return of(value.toByteArray());
+        case QMetaType::QStringList:
+            return of(value.toStringList());
+        case QMetaType::QVariantList:
+            return of(value.toList());
+        case QMetaType::QVariantMap:
+            return of(value.toMap());
+        default:
+            return 0;
+        }
+    }
+
+    static qint64 of(int) { return 0; }
+    static qint64 of(bool) { return 0; }
+    template <typename T>
+    static qint64 of(T*) { return 0; }
+
+    template <typename T>
+    static qint64 of(const QList<T>& list)
+    {
+        if (list.isEmpty())
+            return 0;
+        qint64 bytes = qint64(sizeof(QArrayData)) + list.count() * qint64(qMax(sizeof(T), sizeof(void*)));
+        foreach (const T& value, list)
+            bytes += of(value);
+        return bytes;
+    }
+
+    template <typename K, typename V>
+    static qint64 of(const QMap<K, V>& map)
+    {
+        // three links and the color of a red-black tree node
+        qint64 bytes = map.count() * qint64(3 * sizeof(void*) + sizeof(int) + sizeof(K) + sizeof(V));
+        for (typename QMap<K, V>::const_iterator it = map.constBegin(); it != map.constEnd(); ++it)
+            bytes += of(it.key()) + of(it.value());
+        return bytes;
+    }
+
+    template <typename K, typename V>
+    static qint64 of(const QHash<K, V>& hash)
+    {
+        // a chain link and the hash value of a node, and the bucket array
+        qint64 bytes = hash.count() * qint64(sizeof(void*) + sizeof(uint) + sizeof(K) + sizeof(V));
+        bytes += hash.capacity() * qint64(sizeof(void*));
+        for (typename QHash<K, V>::const_iterator it = hash.constBegin(); it != hash.constEnd(); ++it)
+            bytes += of(it.key()) + of(it.value());
+        return bytes;
+    }
+
+    template <typename T>
+    static qint64 of(const QSet<T>& set)
+    {
+        qint64 bytes = set.count() * qint64(sizeof(void*) + sizeof(uint) + sizeof(T));
+        bytes += set.capacity() * qint64(sizeof(void*));
+        foreach (const T& value, set)
+            bytes += of(value);
+        return bytes;
+    }
+};
+
+IRC_END_NAMESPACE
+
+#endif // IRCMEMORY_P_H
@@ -35,6 +35,7 @@
 #include <QtCore/qvariant.h>
 #include <QtCore/qbytearray.h>
 #include <QtCore/qstringlist.h>
+#include <QtCore/qshareddata.h>
 
 #include "ircmessage.h"
 
@@ -75,6 +76,22 @@ public:
     QMap<QByteArray, QByteArray> tags;
 };
 
+class IrcMessageBody : public QSharedData
+{
+public:
+    IrcMessageBody() : encoding("ISO-8859-15") { }
+
+    QByteArray encoding;
+    IrcMessageData data;
+
+    mutable bool m_parsed = false;
+    mutable QString m_nick, m_ident, m_host;
+    mutable IrcExplicitValue<QString> m_prefix;
+    mutable IrcExplicitValue<QString> m_command;
+    mutable IrcExplicitValue<QStringList> m_params;
+    mutable IrcExplicitValue<QVariantMap> m_tags;
+};
+
 class IrcMessagePrivate
 {
 public:
@@ -88,6 +105,7 @@ public:
     QString prefix() const;
     void setPrefix(const QString& prefix);
 
+    void parseNickIdentHost() const;
     QString nick() const;
     QString ident() const;
     QString host() const;
@@ -104,24 +122,22 @@ public:
 
     QByteArray content() const;
 
+    void decodeAll() const;
     void invalidate();
 
+    qint64 memoryUsage() const;
+
     static QString decode(const QByteArray& data, const QByteArray& encoding);
     static bool parsePrefix(const QString& prefix, QString* nick, QString* ident, QString* host);
 
     IrcConnection* connection = nullptr;
     IrcMessage::Type type = IrcMessage::Unknown;
     QDateTime timeStamp;
-    QByteArray encoding;
     mutable int flags = -1;
-    IrcMessageData data;
     QList<IrcMessage*> batch;
 
-    mutable QString m_nick, m_ident, m_host;
-    mutable IrcExplicitValue<QString> m_prefix;
-    mutable IrcExplicitValue<QString> m_command;
-    mutable IrcExplicitValue<QStringList> m_params;
-    mutable IrcExplicitValue<QVariantMap> m_tags;
+    // shared between clones, detached by the setters
+    QSharedDataPointer<IrcMessageBody> body;
 };
 
 IRC_END_NAMESPACE
@@ -51,6 +51,8 @@ public:
 
     void composeMessage(IrcNumericMessage* message);
 
+    qint64 memoryUsage() const;
+
 Q_SIGNALS:
     void messageComposed(IrcMessage* message);
 
@@ -61,6 +61,9 @@ public:
     virtual void read();
     virtual bool write(const QByteArray& data);
 
+    int bufferedBytes() const;
+    qint64 memoryUsage() const;
+
 public Q_SLOTS:
     void receiveMessage(IrcMessage* message);
 
@@ -78,6 +81,7 @@ private:
 
     Q_PRIVATE_SLOT(d_func(), void _irc_pauseHandshake())
     Q_PRIVATE_SLOT(d_func(), void _irc_resumeHandshake())
+    Q_PRIVATE_SLOT(d_func(), void _irc_readLines())
 };
 
 IRC_END_NAMESPACE
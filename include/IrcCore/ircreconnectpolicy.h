@@ -0,0 +1,80 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRCRECONNECTPOLICY_H
+#define IRCRECONNECTPOLICY_H
+
+#include <IrcGlobal>
+#include <QtCore/qobject.h>
+#include <QtCore/qmetatype.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qscopedpointer.h>
+
+IRC_BEGIN_NAMESPACE
+
+class IrcReconnectPolicyPrivate;
+
+class IRC_CORE_EXPORT IrcReconnectPolicy : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int minimumDelay READ minimumDelay WRITE setMinimumDelay)
+    Q_PROPERTY(int maximumDelay READ maximumDelay WRITE setMaximumDelay)
+
+public:
+    explicit IrcReconnectPolicy(QObject* parent = nullptr);
+    ~IrcReconnectPolicy() override;
+
+    int minimumDelay() const;
+    void setMinimumDelay(int msecs);
+
+    int maximumDelay() const;
+    void setMaximumDelay(int msecs);
+
+    Q_INVOKABLE int failures(const QString& server) const;
+    Q_INVOKABLE qint64 latency(const QString& server) const;
+
+    static qreal globalRate();
+    static void setGlobalRate(qreal rate);
+
+    virtual int reconnectDelay(int attempt);
+    virtual QStringList rankServers(const QStringList& servers);
+
+    virtual void serverSucceeded(const QString& server, qint64 latency);
+    virtual void serverFailed(const QString& server);
+
+private:
+    QScopedPointer<IrcReconnectPolicyPrivate> d_ptr;
+    Q_DECLARE_PRIVATE(IrcReconnectPolicy)
+    Q_DISABLE_COPY(IrcReconnectPolicy)
+};
+
+IRC_END_NAMESPACE
+
+Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcReconnectPolicy*))
+
+#endif // IRCRECONNECTPOLICY_H
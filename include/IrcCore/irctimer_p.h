@@ -0,0 +1,89 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRCTIMER_P_H
+#define IRCTIMER_P_H
+
+#include "ircclock.h"
+
+#include <QPointer>
+#include <QTimer>
+
+IRC_BEGIN_NAMESPACE
+
+// A QTimer lookalike that runs on an IrcClock. With a real time clock
+// (or none), it is a plain QTimer. With a virtual clock, it fires when
+// the clock is advanced past its deadline.
+class IRC_CORE_EXPORT IrcTimer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit IrcTimer(QObject* parent = nullptr);
+    ~IrcTimer() override;
+
+    IrcClock* clock() const;
+    void setClock(IrcClock* clock);
+
+    int interval() const;
+    void setInterval(int msecs);
+
+    bool isSingleShot() const;
+    void setSingleShot(bool singleShot);
+
+    bool isActive() const;
+    int remainingTime() const;
+
+    static void singleShot(IrcClock* clock, int msecs, QObject* receiver, const char* member);
+
+public Q_SLOTS:
+    void start();
+    void start(int msecs);
+    void stop();
+
+Q_SIGNALS:
+    void timeout();
+
+private:
+    friend class IrcClock;
+    friend class IrcClockPrivate;
+    bool isVirtual() const;
+
+    QTimer timer;
+    QPointer<IrcClock> source;
+    int msecs = 0;
+    bool single = false;
+    bool active = false;
+    bool autoDelete = false;
+    qint64 deadline = 0;
+    quint64 sequence = 0;
+};
+
+IRC_END_NAMESPACE
+
+#endif // IRCTIMER_P_H
@@ -0,0 +1,58 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRCTRACE_P_H
+#define IRCTRACE_P_H
+
+#include "irctrace.h"
+
+IRC_BEGIN_NAMESPACE
+
+#ifdef IRC_TRACE
+class IRC_CORE_EXPORT IrcTraceScope
+{
+public:
+    IrcTraceScope(const char* category, const char* name);
+    ~IrcTraceScope();
+
+private:
+    const char* category;
+    const char* name;
+    qint64 start;
+};
+
+#define IRC_TRACE_CONCAT_IMPL(a, b) a##b
+#define IRC_TRACE_CONCAT(a, b) IRC_TRACE_CONCAT_IMPL(a, b)
+#define IRC_TRACE_SCOPE(category, name) IrcTraceScope IRC_TRACE_CONCAT(irc_trace_scope_, __LINE__)(category, name)
+#else
+#define IRC_TRACE_SCOPE(category, name) do { } while (false)
+#endif // IRC_TRACE
+
+IRC_END_NAMESPACE
+
+#endif // IRCTRACE_P_H
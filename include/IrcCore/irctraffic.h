@@ -0,0 +1,137 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRCTRAFFIC_H
+#define IRCTRAFFIC_H
+
+#include <IrcGlobal>
+#include <QtCore/qobject.h>
+#include <QtCore/qmetatype.h>
+#include <QtCore/qscopedpointer.h>
+
+IRC_BEGIN_NAMESPACE
+
+class IrcConnection;
+class IrcTrafficRecorderPrivate;
+class IrcTrafficReplayPrivate;
+
+class IRC_CORE_EXPORT IrcTrafficRecorder : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(IrcConnection* connection READ connection WRITE setConnection)
+    Q_PROPERTY(QString fileName READ fileName WRITE setFileName)
+    Q_PROPERTY(bool active READ isActive NOTIFY activeChanged)
+    Q_PROPERTY(qint64 recordCount READ recordCount)
+    Q_PROPERTY(qint64 byteCount READ byteCount)
+
+public:
+    explicit IrcTrafficRecorder(QObject* parent = nullptr);
+    ~IrcTrafficRecorder() override;
+
+    IrcConnection* connection() const;
+    void setConnection(IrcConnection* connection);
+
+    QString fileName() const;
+    void setFileName(const QString& fileName);
+
+    bool isActive() const;
+
+    qint64 recordCount() const;
+    qint64 byteCount() const;
+
+public Q_SLOTS:
+    bool start();
+    void stop();
+
+Q_SIGNALS:
+    void activeChanged(bool active);
+
+private:
+    QScopedPointer<IrcTrafficRecorderPrivate> d_ptr;
+    Q_DECLARE_PRIVATE(IrcTrafficRecorder)
+    Q_DISABLE_COPY(IrcTrafficRecorder)
+};
+
+class IRC_CORE_EXPORT IrcTrafficReplay : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(IrcConnection* connection READ connection WRITE setConnection)
+    Q_PROPERTY(QString fileName READ fileName WRITE setFileName)
+    Q_PROPERTY(Pace pace READ pace WRITE setPace)
+    Q_PROPERTY(bool active READ isActive NOTIFY activeChanged)
+    Q_PROPERTY(qint64 recordCount READ recordCount)
+    Q_PROPERTY(qint64 position READ position)
+    Q_ENUMS(Pace)
+
+public:
+    explicit IrcTrafficReplay(QObject* parent = nullptr);
+    ~IrcTrafficReplay() override;
+
+    enum Pace {
+        OriginalPace,
+        MaximumPace
+    };
+
+    IrcConnection* connection() const;
+    void setConnection(IrcConnection* connection);
+
+    QString fileName() const;
+    void setFileName(const QString& fileName);
+
+    Pace pace() const;
+    void setPace(Pace pace);
+
+    bool isActive() const;
+
+    qint64 recordCount() const;
+    qint64 position() const;
+
+public Q_SLOTS:
+    bool start();
+    void stop();
+
+Q_SIGNALS:
+    void activeChanged(bool active);
+    void finished();
+
+private:
+    QScopedPointer<IrcTrafficReplayPrivate> d_ptr;
+    Q_DECLARE_PRIVATE(IrcTrafficReplay)
+    Q_DISABLE_COPY(IrcTrafficReplay)
+
+    Q_PRIVATE_SLOT(d_func(), void _irc_connected())
+    Q_PRIVATE_SLOT(d_func(), void _irc_deliver())
+};
+
+IRC_END_NAMESPACE
+
+Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcTrafficRecorder*))
+Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcTrafficReplay*))
+Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcTrafficReplay::Pace))
+
+#endif // IRCTRAFFIC_H
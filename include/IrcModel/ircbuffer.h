@@ -96,6 +96,7 @@ public:
     void setUserData(const QVariantMap& data);
 
     Q_INVOKABLE bool sendCommand(IrcCommand* command);
+    Q_INVOKABLE qint64 memoryUsage() const;
 
     virtual IrcBuffer *clone(QObject* parent = nullptr);
 
@@ -52,6 +52,7 @@ public:
     virtual void init(const QString& title, IrcBufferModel* model);
     virtual void connected();
     virtual void disconnected();
+    virtual qint64 memoryUsage() const;
 
     void setName(const QString& name);
     void setPrefix(const QString& prefix);
@@ -79,6 +79,7 @@ public:
     Q_INVOKABLE IrcBuffer* find(const QString& title) const;
     Q_INVOKABLE bool contains(const QString& title) const;
     Q_INVOKABLE int indexOf(IrcBuffer* buffer) const;
+    Q_INVOKABLE qint64 memoryUsage() const;
 
     Q_INVOKABLE IrcBuffer* add(const QString& title);
     Q_INVOKABLE void add(IrcBuffer* buffer);
@@ -49,6 +49,7 @@ public:
     void init(const QString& title, IrcBufferModel* model) override;
     void connected() override;
     void disconnected() override;
+    qint64 memoryUsage() const override;
 
     void setActive(bool active);
 
@@ -72,6 +72,8 @@ public:
     Q_INVOKABLE bool contains(const QString& name) const;
     Q_INVOKABLE int indexOf(IrcUser* user) const;
 
+    Q_INVOKABLE qint64 memoryUsage() const;
+
     Irc::DataRole displayRole() const;
     void setDisplayRole(Irc::DataRole role);
 
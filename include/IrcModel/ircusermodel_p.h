@@ -53,6 +53,8 @@ public:
     bool updateUser(IrcUser* user);
     bool updateTitles();
 
+    qint64 memoryUsage() const;
+
     static IrcUserModelPrivate* get(IrcUserModel* model)
     {
         return model->d_func();
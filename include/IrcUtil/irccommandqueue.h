@@ -30,6 +30,7 @@
 #define IRCCOMMANDQUEUE_H
 
 #include <IrcGlobal>
+#include <IrcCommand>
 #include <QtCore/qobject.h>
 #include <QtCore/qmetatype.h>
 #include <QtCore/qscopedpointer.h>
@@ -42,23 +43,61 @@ class IrcCommandQueuePrivate;
 class IRC_UTIL_EXPORT IrcCommandQueue : public QObject
 {
     Q_OBJECT
+    Q_PROPERTY(Mode mode READ mode WRITE setMode)
     Q_PROPERTY(int batch READ batch WRITE setBatch)
     Q_PROPERTY(int interval READ interval WRITE setInterval)
+    Q_PROPERTY(qreal burst READ burst WRITE setBurst)
+    Q_PROPERTY(qreal rate READ rate WRITE setRate)
+    Q_PROPERTY(qreal commandCost READ commandCost WRITE setCommandCost)
+    Q_PROPERTY(qreal byteCost READ byteCost WRITE setByteCost)
     Q_PROPERTY(int size READ size NOTIFY sizeChanged)
     Q_PROPERTY(IrcConnection* connection READ connection WRITE setConnection)
+    Q_ENUMS(Mode Priority)
 
 public:
     explicit IrcCommandQueue(QObject* parent = nullptr);
     ~IrcCommandQueue() override;
 
+    enum Mode {
+        Batch,
+        TokenBucket
+    };
+
+    Mode mode() const;
+    void setMode(Mode mode);
+
+    enum Priority {
+        HighPriority,
+        NormalPriority,
+        LowPriority
+    };
+
     int batch() const;
     void setBatch(int batch);
 
     int interval() const;
     void setInterval(int seconds);
 
+    qreal burst() const;
+    void setBurst(qreal burst);
+
+    qreal rate() const;
+    void setRate(qreal rate);
+
+    qreal commandCost() const;
+    void setCommandCost(qreal cost);
+
+    qreal byteCost() const;
+    void setByteCost(qreal cost);
+
     int size() const;
 
+    Q_INVOKABLE IrcCommandQueue::Priority priority(IrcCommand::Type type) const;
+    Q_INVOKABLE void setPriority(IrcCommand::Type type, IrcCommandQueue::Priority priority);
+
+    Q_INVOKABLE int depth(Priority priority) const;
+    Q_INVOKABLE qint64 waitTime(Priority priority) const;
+
     IrcConnection* connection() const;
     void setConnection(IrcConnection* connection);
 
@@ -74,6 +113,7 @@ private:
     Q_DECLARE_PRIVATE(IrcCommandQueue)
     Q_DISABLE_COPY(IrcCommandQueue)
 
+    Q_PRIVATE_SLOT(d_func(), void _irc_connected())
     Q_PRIVATE_SLOT(d_func(), void _irc_updateTimer())
     Q_PRIVATE_SLOT(d_func(), void _irc_sendBatch())
 };
@@ -81,5 +121,7 @@ private:
 IRC_END_NAMESPACE
 
 Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcCommandQueue*))
+Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcCommandQueue::Mode))
+Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcCommandQueue::Priority))
 
 #endif // IRCCOMMANDQUEUE_H
@@ -31,12 +31,40 @@
 
 #include "irccommandqueue.h"
 #include "ircfilter.h"
+#include "irctimer_p.h"
 #include <QPointer>
 #include <QQueue>
-#include <QTimer>
+#include <QHash>
+#include <QMap>
 
 IRC_BEGIN_NAMESPACE
 
+struct IrcQueuedCommand
+{
+    QPointer<IrcCommand> command;
+    qint64 queued = 0;
+};
+
+class IrcCommandLane
+{
+public:
+    bool isEmpty() const { return count == 0; }
+    int size() const { return count; }
+    bool contains(const QString& target) const { return commands.contains(target); }
+
+    IrcCommand* head() const;
+    qint64 waitTime(qint64 now) const;
+
+    void enqueue(IrcCommand* cmd, const QString& target, qint64 now);
+    IrcCommand* dequeue();
+    void clear();
+
+private:
+    int count = 0;
+    QQueue<QString> targets;
+    QHash<QString, QQueue<IrcQueuedCommand> > commands;
+};
+
 class IrcCommandQueuePrivate : public QObject,  public IrcCommandFilter
 {
     Q_OBJECT
@@ -48,15 +76,37 @@ public:
 
     bool commandFilter(IrcCommand* cmd) override;
 
+    bool isEnabled() const;
+
+    int size() const;
+    void updateSize();
+    IrcCommandLane* nextLane();
+
+    static IrcCommandQueue::Priority defaultPriority(IrcCommand::Type type);
+    static QString target(IrcCommand* cmd);
+
+    qint64 now() const;
+    void refill();
+    qreal cost(IrcCommand* cmd) const;
+
+    void _irc_connected();
     void _irc_updateTimer();
     void _irc_sendBatch(bool force = false);
 
     IrcCommandQueue* q_ptr = nullptr;
     IrcConnection* connection = nullptr;
-    QTimer timer;
+    IrcTimer timer;
+    IrcCommandQueue::Mode mode = IrcCommandQueue::Batch;
     int batch;
     int interval;
-    QQueue<QPointer<IrcCommand> > commands;
+    qreal burst;
+    qreal rate;
+    qreal commandCost;
+    qreal byteCost;
+    qreal tokens;
+    qint64 refilled = -1;
+    IrcCommandLane lanes[IrcCommandQueue::LowPriority + 1];
+    QMap<int, IrcCommandQueue::Priority> priorities;
 };
 
 IRC_END_NAMESPACE
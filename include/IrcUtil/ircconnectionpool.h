@@ -0,0 +1,86 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRCCONNECTIONPOOL_H
+#define IRCCONNECTIONPOOL_H
+
+#include <IrcGlobal>
+#include <QtCore/qlist.h>
+#include <QtCore/qobject.h>
+#include <QtCore/qmetatype.h>
+#include <QtCore/qscopedpointer.h>
+
+IRC_BEGIN_NAMESPACE
+
+class IrcCommand;
+class IrcMessage;
+class IrcConnection;
+class IrcConnectionPoolPrivate;
+
+class IRC_UTIL_EXPORT IrcConnectionPool : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int threadCount READ threadCount WRITE setThreadCount)
+    Q_PROPERTY(int count READ count)
+
+public:
+    explicit IrcConnectionPool(QObject* parent = nullptr);
+    ~IrcConnectionPool() override;
+
+    int threadCount() const;
+    void setThreadCount(int count);
+
+    int count() const;
+    QList<IrcConnection*> connections() const;
+
+    Q_INVOKABLE int load(int thread) const;
+
+    Q_INVOKABLE bool addConnection(IrcConnection* connection);
+    Q_INVOKABLE bool removeConnection(IrcConnection* connection);
+
+public Q_SLOTS:
+    bool sendCommand(IrcConnection* connection, IrcCommand* command);
+
+Q_SIGNALS:
+    void messageReceived(IrcConnection* connection, IrcMessage* message);
+
+protected:
+    void connectNotify(const QMetaMethod& signal) override;
+    void disconnectNotify(const QMetaMethod& signal) override;
+
+private:
+    QScopedPointer<IrcConnectionPoolPrivate> d_ptr;
+    Q_DECLARE_PRIVATE(IrcConnectionPool)
+    Q_DISABLE_COPY(IrcConnectionPool)
+};
+
+IRC_END_NAMESPACE
+
+Q_DECLARE_METATYPE(IRC_PREPEND_NAMESPACE(IrcConnectionPool*))
+
+#endif // IRCCONNECTIONPOOL_H
@@ -0,0 +1,88 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IRCCONNECTIONPOOL_P_H
+#define IRCCONNECTIONPOOL_P_H
+
+#include "ircconnectionpool.h"
+#include <QAtomicInt>
+#include <QVector>
+#include <QThread>
+#include <QMutex>
+#include <QHash>
+
+IRC_BEGIN_NAMESPACE
+
+class IrcConnectionPoolWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit IrcConnectionPoolWorker(QObject* parent = nullptr) : QObject(parent) { }
+
+public Q_SLOTS:
+    void relocate(QObject* object, QThread* thread) { object->moveToThread(thread); }
+};
+
+class IrcConnectionPoolPrivate : public QObject
+{
+    Q_OBJECT
+    Q_DECLARE_PUBLIC(IrcConnectionPool)
+
+public:
+    IrcConnectionPoolPrivate();
+
+    static IrcConnectionPoolPrivate* get(IrcConnectionPool* pool)
+    {
+        return pool->d_func();
+    }
+
+    void startThreads();
+    int leastLoaded() const;
+
+public Q_SLOTS:
+    void receiveMessage(IrcMessage* message);
+    void deliverMessage(IrcMessage* message);
+    void connectionDestroyed(QObject* connection);
+
+public:
+    IrcConnectionPool* q_ptr = nullptr;
+    int threadCount;
+    QAtomicInt receivers;
+    mutable QMutex mutex;
+    QVector<QThread*> threads;
+    QVector<IrcConnectionPoolWorker*> workers;
+    QVector<int> loads;
+    QHash<IrcConnection*, int> assignments;
+    QList<IrcConnection*> connections;
+    QList<IrcMessage*> pending;
+};
+
+IRC_END_NAMESPACE
+
+#endif // IRCCONNECTIONPOOL_P_H
@@ -45,6 +45,10 @@ class IRC_UTIL_EXPORT IrcLagTimer : public QObject
     Q_PROPERTY(qint64 lag READ lag NOTIFY lagChanged)
     Q_PROPERTY(int interval READ interval WRITE setInterval)
     Q_PROPERTY(IrcConnection* connection READ connection WRITE setConnection)
+    Q_PROPERTY(int maximumProbes READ maximumProbes WRITE setMaximumProbes)
+    Q_PROPERTY(int pendingProbes READ pendingProbes)
+    Q_PROPERTY(int lostProbes READ lostProbes)
+    Q_PROPERTY(int window READ window WRITE setWindow)
 
 public:
     explicit IrcLagTimer(QObject* parent = nullptr);
@@ -58,6 +62,18 @@ public:
     int interval() const;
     void setInterval(int seconds);
 
+    int maximumProbes() const;
+    void setMaximumProbes(int probes);
+
+    int pendingProbes() const;
+    int lostProbes() const;
+
+    int window() const;
+    void setWindow(int samples);
+
+    Q_INVOKABLE QList<qint64> roundTripTimes() const;
+    Q_INVOKABLE qint64 percentile(int percent) const;
+
 Q_SIGNALS:
     void lagChanged(qint64 lag);
 
@@ -31,7 +31,9 @@
 
 #include "irclagtimer.h"
 #include "ircfilter.h"
-#include <QTimer>
+#include "irctimer_p.h"
+#include <QList>
+#include <QMap>
 
 IRC_BEGIN_NAMESPACE
 
@@ -56,12 +58,21 @@ public:
     void updateTimer();
     void updateLag(qint64 value);
 
+    void resetProbes();
+    void loseProbe(quint32 token);
+    void addRoundTrip(qint64 rtt);
+
     IrcLagTimer* q_ptr = nullptr;
     IrcConnection* connection = nullptr;
-    QTimer timer;
+    IrcTimer timer;
     int interval;
-    int pendingPings = 0;
     qint64 lag = -1;
+    int maximumProbes = 3;
+    int lostProbes = 0;
+    int window = 100;
+    QMap<quint32, qint64> probes;
+    QList<quint32> lost;
+    QList<qint64> roundTrips;
 };
 
 IRC_END_NAMESPACE
@@ -32,6 +32,7 @@
 #include "irccommandparser.h"
 #include "irccommandqueue.h"
 #include "irccompleter.h"
+#include "ircconnectionpool.h"
 #include "irclagtimer.h"
 #include "ircpalette.h"
 #include "irctextformat.h"
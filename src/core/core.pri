@@ -10,42 +10,61 @@ DEPENDPATH += $$PWD $$INCDIR
 INCLUDEPATH += $$PWD $$INCDIR
 
 CONV_HEADERS  = $$INCDIR/Irc
+CONV_HEADERS += $$INCDIR/IrcClock
 CONV_HEADERS += $$INCDIR/IrcCommand
 CONV_HEADERS += $$INCDIR/IrcCommandFilter
 CONV_HEADERS += $$INCDIR/IrcConnection
+CONV_HEADERS += $$INCDIR/IrcConnectionStatistics
 CONV_HEADERS += $$INCDIR/IrcCore
 CONV_HEADERS += $$INCDIR/IrcGlobal
 CONV_HEADERS += $$INCDIR/IrcMessage
 CONV_HEADERS += $$INCDIR/IrcMessageFilter
 CONV_HEADERS += $$INCDIR/IrcNetwork
 CONV_HEADERS += $$INCDIR/IrcProtocol
+CONV_HEADERS += $$INCDIR/IrcReconnectPolicy
+CONV_HEADERS += $$INCDIR/IrcTrace
+CONV_HEADERS += $$INCDIR/IrcTrafficRecorder
+CONV_HEADERS += $$INCDIR/IrcTrafficReplay
 
 PUB_HEADERS  = $$INCDIR/irc.h
+PUB_HEADERS += $$INCDIR/ircclock.h
 PUB_HEADERS += $$INCDIR/irccommand.h
 PUB_HEADERS += $$INCDIR/ircconnection.h
+PUB_HEADERS += $$INCDIR/ircconnectionstatistics.h
 PUB_HEADERS += $$INCDIR/irccore.h
 PUB_HEADERS += $$INCDIR/ircfilter.h
 PUB_HEADERS += $$INCDIR/ircglobal.h
 PUB_HEADERS += $$INCDIR/ircmessage.h
 PUB_HEADERS += $$INCDIR/ircnetwork.h
 PUB_HEADERS += $$INCDIR/ircprotocol.h
+PUB_HEADERS += $$INCDIR/ircreconnectpolicy.h
+PUB_HEADERS += $$INCDIR/irctrace.h
+PUB_HEADERS += $$INCDIR/irctraffic.h
 
 PRIV_HEADERS  = $$INCDIR/irccommand_p.h
 PRIV_HEADERS += $$INCDIR/ircconnection_p.h
+PRIV_HEADERS += $$INCDIR/ircconnectionstatistics_p.h
 PRIV_HEADERS += $$INCDIR/irccore_p.h
 PRIV_HEADERS += $$INCDIR/ircdebug_p.h
+PRIV_HEADERS += $$INCDIR/ircmemory_p.h
 PRIV_HEADERS += $$INCDIR/ircmessage_p.h
 PRIV_HEADERS += $$INCDIR/ircmessagecomposer_p.h
 PRIV_HEADERS += $$INCDIR/ircmessagedecoder_p.h
 PRIV_HEADERS += $$INCDIR/ircnetwork_p.h
+PRIV_HEADERS += $$INCDIR/irctimer_p.h
+PRIV_HEADERS += $$INCDIR/irctrace_p.h
+PRIV_HEADERS += $$INCDIR/irctraffic_p.h
 
 HEADERS += $$PUB_HEADERS
 HEADERS += $$PRIV_HEADERS
 
 SOURCES += $$PWD/irc.cpp
+SOURCES += $$PWD/ircclock.cpp
 SOURCES += $$PWD/irccommand.cpp
 SOURCES += $$PWD/ircconnection.cpp
+SOURCES += $$PWD/ircconnectionstatistics.cpp
 SOURCES += $$PWD/irccore.cpp
+SOURCES += $$PWD/ircdebug.cpp
 SOURCES += $$PWD/ircfilter.cpp
 SOURCES += $$PWD/ircmessage.cpp
 SOURCES += $$PWD/ircmessage_p.cpp
@@ -53,6 +72,9 @@ SOURCES += $$PWD/ircmessagecomposer.cpp
 SOURCES += $$PWD/ircmessagedecoder.cpp
 SOURCES += $$PWD/ircnetwork.cpp
 SOURCES += $$PWD/ircprotocol.cpp
+SOURCES += $$PWD/ircreconnectpolicy.cpp
+SOURCES += $$PWD/irctrace.cpp
+SOURCES += $$PWD/irctraffic.cpp
 
 include(pkg.pri)
 
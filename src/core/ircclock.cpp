@@ -0,0 +1,400 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ircclock.h"
+#include "irctimer_p.h"
+#include <QElapsedTimer>
+#include <QList>
+#include <limits>
+
+IRC_BEGIN_NAMESPACE
+
+/*!
+    \file ircclock.h
+    \brief \#include &lt;IrcClock&gt;
+ */
+
+/*!
+    \since 3.8
+    \class IrcClock ircclock.h IrcClock
+    \ingroup core
+    \brief Provides the time and drives the timers of connections.
+
+    The reconnect, server race, lag measurement, command queue and buffer
+    model timers run on the \ref IrcConnection::clock "clock" of their
+    connection. By default, that is the real time system() clock.
+
+    A virtual time clock does not move by itself. Instead, advance() moves
+    it forward, firing all timers that are due on the way, in order. This
+    allows simulating minutes of flood control or a reconnect storm in
+    milliseconds, deterministically.
+
+    \code
+    IrcClock* clock = new IrcClock(IrcClock::VirtualTime, connection);
+    connection->setClock(clock);
+    connection->setReconnectDelay(30);
+    // ...
+    clock->advance(30 * 1000); // reconnects now
+    \endcode
+
+    \note The clock of a connection should be set before the connection is opened.
+    Timers that are already running keep the clock they were started with.
+ */
+
+/*!
+    \enum IrcClock::Mode
+    This enum describes the clock modes.
+ */
+
+/*!
+    \var IrcClock::RealTime
+    \brief The clock follows the real time.
+ */
+
+/*!
+    \var IrcClock::VirtualTime
+    \brief The clock only moves when advanced.
+ */
+
+#ifndef IRC_DOXYGEN
+class IrcClockPrivate
+{
+public:
+    IrcTimer* nextTimer(qint64 limit) const;
+    void fire(IrcTimer* timer);
+
+    IrcClock::Mode mode = IrcClock::RealTime;
+    QElapsedTimer clock;
+    qint64 epoch = 0;
+    qint64 now = 0;
+    quint64 sequence = 0;
+    QList<IrcTimer*> timers;
+};
+
+IrcTimer* IrcClockPrivate::nextTimer(qint64 limit) const
+{
+    IrcTimer* next = nullptr;
+    foreach (IrcTimer* timer, timers) {
+        if (timer->deadline <= limit && (!next || timer->deadline < next->deadline
+                || (timer->deadline == next->deadline && timer->sequence < next->sequence)))
+            next = timer;
+    }
+    return next;
+}
+
+void IrcClockPrivate::fire(IrcTimer* timer)
+{
+    now = qMax(now, timer->deadline);
+    if (timer->single) {
+        timer->active = false;
+        timers.removeOne(timer);
+    } else {
+        // a zero interval would fire forever without moving the clock
+        timer->deadline = now + qMax(1, timer->msecs);
+        timer->sequence = ++sequence;
+    }
+
+    QPointer<IrcTimer> guard(timer);
+    emit timer->timeout();
+    if (guard && guard->autoDelete && !guard->active)
+        guard->deleteLater();
+}
+
+Q_GLOBAL_STATIC(IrcClock, irc_system_clock)
+#endif // IRC_DOXYGEN
+
+/*!
+    Constructs a new real time clock with \a parent.
+ */
+IrcClock::IrcClock(QObject* parent) : QObject(parent), d_ptr(new IrcClockPrivate)
+{
+    Q_D(IrcClock);
+    d->clock.start();
+    d->epoch = QDateTime::currentMSecsSinceEpoch();
+}
+
+/*!
+    Constructs a new clock with \a mode and \a parent.
+
+    A virtual time clock starts at the current date and time, and
+    elapsed() at zero.
+ */
+IrcClock::IrcClock(Mode mode, QObject* parent) : QObject(parent), d_ptr(new IrcClockPrivate)
+{
+    Q_D(IrcClock);
+    d->mode = mode;
+    d->clock.start();
+    d->epoch = QDateTime::currentMSecsSinceEpoch();
+}
+
+/*!
+    Destructs the clock. The timers that run on a virtual time clock are stopped.
+ */
+IrcClock::~IrcClock()
+{
+    Q_D(IrcClock);
+    foreach (IrcTimer* timer, d->timers)
+        timer->active = false;
+    d->timers.clear();
+}
+
+/*!
+    Returns the process-wide real time clock.
+ */
+IrcClock* IrcClock::system()
+{
+    return irc_system_clock();
+}
+
+/*!
+    This property holds the mode of the clock.
+
+    \par Access function:
+    \li \ref IrcClock::Mode "Mode" <b>mode</b>() const
+ */
+IrcClock::Mode IrcClock::mode() const
+{
+    Q_D(const IrcClock);
+    return d->mode;
+}
+
+/*!
+    This property holds the monotonic time in milliseconds since the clock was created.
+
+    \par Access function:
+    \li qint64 <b>elapsed</b>() const
+ */
+qint64 IrcClock::elapsed() const
+{
+    Q_D(const IrcClock);
+    if (d->mode == VirtualTime)
+        return d->now;
+    return d->clock.elapsed();
+}
+
+/*!
+    Returns the current date and time in milliseconds since the epoch.
+
+    \sa QDateTime::currentMSecsSinceEpoch()
+ */
+qint64 IrcClock::currentMSecsSinceEpoch() const
+{
+    Q_D(const IrcClock);
+    if (d->mode == VirtualTime)
+        return d->epoch + d->now;
+    return QDateTime::currentMSecsSinceEpoch();
+}
+
+/*!
+    Returns the current date and time.
+
+    \sa QDateTime::currentDateTime()
+ */
+QDateTime IrcClock::currentDateTime() const
+{
+    Q_D(const IrcClock);
+    if (d->mode == VirtualTime)
+        return QDateTime::fromMSecsSinceEpoch(d->epoch + d->now);
+    return QDateTime::currentDateTime();
+}
+
+/*!
+    This property holds the number of timers waiting for a virtual time clock.
+
+    The value is always \c 0 for a real time clock.
+
+    \par Access function:
+    \li int <b>pendingTimers</b>() const
+ */
+int IrcClock::pendingTimers() const
+{
+    Q_D(const IrcClock);
+    return d->timers.count();
+}
+
+/*!
+    Moves a virtual time clock forward by \a msecs milliseconds.
+
+    The timers that become due are fired in order of their deadlines,
+    and the clock shows the deadline of each timer when it fires. Timers
+    started or restarted by the fired timers are fired, too, if they become
+    due within \a msecs.
+
+    \sa advanceToNextTimer()
+ */
+void IrcClock::advance(qint64 msecs)
+{
+    Q_D(IrcClock);
+    if (d->mode != VirtualTime) {
+        qWarning("IrcClock::advance(): a real time clock cannot be advanced");
+        return;
+    }
+    const qint64 target = d->now + qMax(0ll, msecs);
+    while (IrcTimer* timer = d->nextTimer(target))
+        d->fire(timer);
+    d->now = target;
+}
+
+/*!
+    Moves a virtual time clock forward to the next timer, and fires it.
+
+    Returns \c false if there are no pending timers.
+
+    \sa advance()
+ */
+bool IrcClock::advanceToNextTimer()
+{
+    Q_D(IrcClock);
+    if (d->mode != VirtualTime) {
+        qWarning("IrcClock::advanceToNextTimer(): a real time clock cannot be advanced");
+        return false;
+    }
+    IrcTimer* timer = d->nextTimer(std::numeric_limits<qint64>::max());
+    if (!timer)
+        return false;
+    d->fire(timer);
+    return true;
+}
+
+#ifndef IRC_DOXYGEN
+IrcTimer::IrcTimer(QObject* parent) : QObject(parent)
+{
+    timer.setParent(this);
+    connect(&timer, SIGNAL(timeout()), this, SIGNAL(timeout()));
+}
+
+IrcTimer::~IrcTimer()
+{
+    stop();
+}
+
+IrcClock* IrcTimer::clock() const
+{
+    return source;
+}
+
+void IrcTimer::setClock(IrcClock* clock)
+{
+    if (source != clock) {
+        const bool restart = isActive();
+        stop();
+        source = clock;
+        if (restart)
+            start();
+    }
+}
+
+int IrcTimer::interval() const
+{
+    return msecs;
+}
+
+void IrcTimer::setInterval(int interval)
+{
+    msecs = interval;
+    if (isActive())
+        start();
+}
+
+bool IrcTimer::isSingleShot() const
+{
+    return single;
+}
+
+void IrcTimer::setSingleShot(bool singleShot)
+{
+    single = singleShot;
+    timer.setSingleShot(singleShot);
+}
+
+bool IrcTimer::isActive() const
+{
+    return isVirtual() ? active : timer.isActive();
+}
+
+int IrcTimer::remainingTime() const
+{
+    if (isVirtual())
+        return active ? int(qMax(0ll, deadline - source->elapsed())) : -1;
+    return timer.remainingTime();
+}
+
+void IrcTimer::singleShot(IrcClock* clock, int msecs, QObject* receiver, const char* member)
+{
+    if (!clock || clock->mode() == IrcClock::RealTime) {
+        QTimer::singleShot(msecs, receiver, member);
+        return;
+    }
+    IrcTimer* timer = new IrcTimer(receiver);
+    timer->autoDelete = true;
+    timer->setClock(clock);
+    timer->setSingleShot(true);
+    connect(timer, SIGNAL(timeout()), receiver, member);
+    timer->start(msecs);
+}
+
+void IrcTimer::start()
+{
+    stop();
+    if (isVirtual()) {
+        IrcClockPrivate* d = source->d_func();
+        deadline = d->now + qMax(0, msecs);
+        sequence = ++d->sequence;
+        active = true;
+        d->timers.append(this);
+    } else {
+        timer.start(msecs);
+    }
+}
+
+void IrcTimer::start(int interval)
+{
+    msecs = interval;
+    start();
+}
+
+void IrcTimer::stop()
+{
+    timer.stop();
+    if (active) {
+        active = false;
+        if (source)
+            source->d_func()->timers.removeOne(this);
+    }
+}
+
+bool IrcTimer::isVirtual() const
+{
+    return source && source->mode() == IrcClock::VirtualTime;
+}
+#endif // IRC_DOXYGEN
+
+#include "moc_ircclock.cpp"
+#include "moc_irctimer_p.cpp"
+
+IRC_END_NAMESPACE
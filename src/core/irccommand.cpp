@@ -29,6 +29,7 @@
 #include "irccommand.h"
 #include "irccommand_p.h"
 #include "ircconnection.h"
+#include "ircnetwork_p.h"
 #include "ircmessage.h"
 #include "irccore_p.h"
 #include <QTextCodec>
@@ -899,6 +900,128 @@ IrcCommand* IrcCommand::createWhowas(const QString& user, int count)
     return IrcCommandPrivate::createCommand(Whowas, QStringList() << user << QString::number(count));
 }
 
+#ifndef IRC_DOXYGEN
+static const int IRC_MAX_LINE_BYTES = 512; // including "\r\n"
+
+static IrcCommand* irc_create_packed(IrcCommand::Type type, const QStringList& targets, const QStringList& keys, const QStringList& arguments)
+{
+    switch (type) {
+    case IrcCommand::Join:      return IrcCommand::createJoin(targets, keys);
+    case IrcCommand::Part:      return IrcCommand::createPart(targets, arguments.value(0));
+    case IrcCommand::Names:     return IrcCommand::createNames(targets);
+    case IrcCommand::Monitor:   return IrcCommand::createMonitor(arguments.value(0), targets);
+    case IrcCommand::Who:       return IrcCommand::createWho(targets.join(QLatin1String(",")));
+    case IrcCommand::Message:   return IrcCommand::createMessage(targets.join(QLatin1String(",")), arguments.value(0));
+    case IrcCommand::Notice:    return IrcCommand::createNotice(targets.join(QLatin1String(",")), arguments.value(0));
+    default:                    return IrcCommandPrivate::createCommand(type, QStringList() << targets.value(0) << arguments);
+    }
+}
+
+static int irc_target_limit(IrcCommand::Type type, IrcNetwork* network)
+{
+    // 0 = unlimited, apart from the line length
+    QString command;
+    int limit = 0;
+    switch (type) {
+    case IrcCommand::Join:      command = QStringLiteral("JOIN"); break;
+    case IrcCommand::Part:      command = QStringLiteral("PART"); break;
+    case IrcCommand::Names:     command = QStringLiteral("NAMES"); break;
+    case IrcCommand::Monitor:   command = QStringLiteral("MONITOR"); break;
+    // multiple targets are not allowed unless advertised via TARGMAX
+    case IrcCommand::Who:       command = QStringLiteral("WHO"); limit = 1; break;
+    case IrcCommand::Message:   command = QStringLiteral("PRIVMSG"); limit = 1; break;
+    case IrcCommand::Notice:    command = QStringLiteral("NOTICE"); limit = 1; break;
+    default:                    return 1;
+    }
+    if (network) {
+        IrcNetworkPrivate* priv = IrcNetworkPrivate::get(network);
+        if (priv->targetLimits.contains(command))
+            limit = priv->targetLimits.value(command);
+    }
+    return limit;
+}
+#endif // IRC_DOXYGEN
+
+/*!
+    \since 3.8
+
+    Creates the minimal amount of commands with \a type that address all \a targets.
+
+    The targets are packed into comma-separated lists so that each command fits
+    into the 512 bytes (UTF-8 encoded, including the trailing CR-LF) allowed by
+    the IRC protocol, and does not exceed the amount of targets the \a network
+    announces via \c TARGMAX (see IrcNetwork::targetLimit()).
+
+    The meaning of \a arguments depends on the command type:
+    \li IrcCommand::Join - the keys of the respective \a targets (channels).
+        Channels with keys are joined before channels without keys, because
+        the \c JOIN command does not allow channels without keys to precede
+        channels with keys.
+    \li IrcCommand::Part - the part reason (optional).
+    \li IrcCommand::Monitor - the monitor sub-command (\c + or \c -).
+    \li IrcCommand::Message and IrcCommand::Notice - the message.
+
+    IrcCommand::Names is packed without arguments. IrcCommand::Who, IrcCommand::Message
+    and IrcCommand::Notice are only packed if the \a network explicitly allows
+    multiple targets. Any other command type results in a separate command for each target.
+
+    \code
+    QList<IrcCommand*> joins = IrcCommand::createPacked(IrcCommand::Join, channels, keys, connection->network());
+    foreach (IrcCommand* join, joins)
+        connection->sendCommand(join);
+    \endcode
+ */
+QList<IrcCommand*> IrcCommand::createPacked(Type type, const QStringList& targets, const QStringList& arguments, IrcNetwork* network)
+{
+    QStringList ordered = targets;
+    QStringList keys;
+    if (type == Join) {
+        // JOIN #a,#b key works, whereas JOIN #a,#b ,key does not
+        QStringList unkeyed;
+        ordered.clear();
+        for (int i = 0; i < targets.count(); ++i) {
+            const QString key = arguments.value(i);
+            if (key.isEmpty()) {
+                unkeyed += targets.at(i);
+            } else {
+                ordered += targets.at(i);
+                keys += key;
+            }
+        }
+        ordered += unkeyed;
+    }
+
+    const int limit = irc_target_limit(type, network);
+    int overhead = 0;
+    if (limit != 1) {
+        QScopedPointer<IrcCommand> empty(irc_create_packed(type, QStringList(QString()), QStringList(), arguments));
+        overhead = empty->toString().toUtf8().size() + 2;
+    }
+
+    QList<IrcCommand*> commands;
+    QStringList batch, batchKeys;
+    int bytes = overhead;
+    for (int i = 0; i < ordered.count(); ++i) {
+        const QString& target = ordered.at(i);
+        const QString key = keys.value(i);
+        // a key is preceded by either a comma or the space separating keys from channels
+        const int length = target.toUtf8().size() + (key.isEmpty() ? 0 : key.toUtf8().size() + 1);
+        if (!batch.isEmpty() && ((limit > 0 && batch.count() >= limit) || bytes + 1 + length > IRC_MAX_LINE_BYTES)) {
+            commands += irc_create_packed(type, batch, batchKeys, arguments);
+            batch.clear();
+            batchKeys.clear();
+            bytes = overhead;
+        }
+        bytes += (batch.isEmpty() ? 0 : 1) + length;
+        batch += target;
+        if (!key.isEmpty())
+            batchKeys += key;
+    }
+    if (!batch.isEmpty())
+        commands += irc_create_packed(type, batch, batchKeys, arguments);
+    return commands;
+}
+
 #ifndef QT_NO_DEBUG_STREAM
 QDebug operator<<(QDebug debug, IrcCommand::Type type)
 {
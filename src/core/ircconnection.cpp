@@ -28,13 +28,17 @@
 
 #include "ircconnection.h"
 #include "ircconnection_p.h"
+#include "ircconnectionstatistics_p.h"
+#include "irctrace_p.h"
 #include "ircnetwork_p.h"
 #include "irccommand_p.h"
 #include "ircprotocol.h"
+#include "ircreconnectpolicy.h"
 #include "ircnetwork.h"
 #include "irccommand.h"
 #include "ircmessage.h"
 #include "ircdebug_p.h"
+#include "ircmemory_p.h"
 #include "ircfilter.h"
 #include "irccore_p.h"
 #include "irc.h"
@@ -46,9 +50,11 @@
 #include <QMetaObject>
 #include <QMetaMethod>
 #include <QMetaEnum>
+#include <QThread>
 #ifndef QT_NO_SSL
 #include <QSslSocket>
 #include <QSslError>
+#include <QSslConfiguration>
 #endif // QT_NO_SSL
 #include <QDataStream>
 #include <QVariantMap>
@@ -250,6 +256,55 @@ IRC_BEGIN_NAMESPACE
 extern bool irc_is_supported_encoding(const QByteArray& encoding); // ircmessagedecoder.cpp
 
 #ifndef IRC_DOXYGEN
+// an intrusive multi-producer single-consumer queue: any thread may
+// enqueue, and only the thread of the connection dequeues. the consumer
+// may see the queue empty while an enqueue is still in progress, which
+// is fine because the producer schedules another drain once it is done.
+IrcOutboundQueue::IrcOutboundQueue() : head(&stub), tail(&stub)
+{
+}
+
+IrcOutboundQueue::~IrcOutboundQueue()
+{
+    while (IrcOutboundNode* node = dequeue()) {
+        delete node->command;
+        delete node;
+    }
+}
+
+void IrcOutboundQueue::enqueue(IrcOutboundNode* node)
+{
+    node->next.storeRelease(nullptr);
+    IrcOutboundNode* prev = head.fetchAndStoreOrdered(node);
+    prev->next.storeRelease(node);
+}
+
+IrcOutboundNode* IrcOutboundQueue::dequeue()
+{
+    IrcOutboundNode* node = tail;
+    IrcOutboundNode* next = node->next.loadAcquire();
+    if (node == &stub) {
+        if (!next)
+            return nullptr;
+        tail = next;
+        node = next;
+        next = next->next.loadAcquire();
+    }
+    if (next) {
+        tail = next;
+        return node;
+    }
+    if (node != head.loadAcquire())
+        return nullptr;
+    enqueue(&stub);
+    next = node->next.loadAcquire();
+    if (next) {
+        tail = next;
+        return node;
+    }
+    return nullptr;
+}
+
 IrcConnectionPrivate::IrcConnectionPrivate() :
     encoding("ISO-8859-15"),
     host(),
@@ -263,9 +318,15 @@ void IrcConnectionPrivate::init(IrcConnection* connection)
 {
     q_ptr = connection;
     network = IrcNetworkPrivate::create(connection);
+    statistics = new IrcConnectionStatistics(connection);
     connection->setSocket(new QTcpSocket(connection));
     connection->setProtocol(new IrcProtocol(connection));
+    // parented so that the timers follow the connection to another thread
+    reconnecter.setParent(connection);
     QObject::connect(&reconnecter, SIGNAL(timeout()), connection, SLOT(_irc_reconnect()));
+    racer.setParent(connection);
+    racer.setSingleShot(true);
+    QObject::connect(&racer, SIGNAL(timeout()), connection, SLOT(_irc_raceNext()));
 }
 
 void IrcConnectionPrivate::_irc_connected()
@@ -274,8 +335,10 @@ void IrcConnectionPrivate::_irc_connected()
     closed = false;
     pendingOpen = false;
     emit q->connecting();
-    if (q->isSecure())
+    if (q->isSecure()) {
+        resumeSession();
         QMetaObject::invokeMethod(socket, "startClientEncryption");
+    }
     protocol->open();
 }
 
@@ -321,6 +384,38 @@ void IrcConnectionPrivate::_irc_sslErrors()
     emit q->secureError();
 }
 
+void IrcConnectionPrivate::_irc_sessionTicket()
+{
+#ifndef QT_NO_SSL
+    QSslSocket* ssl = qobject_cast<QSslSocket*>(socket);
+    if (ssl && sessionResumption) {
+        const QByteArray ticket = ssl->sslConfiguration().sessionTicket();
+        if (!ticket.isEmpty())
+            sessionTickets.insert(QString("%1 %2").arg(host).arg(port), ticket);
+    }
+#endif // !QT_NO_SSL
+}
+
+void IrcConnectionPrivate::resumeSession()
+{
+#ifndef QT_NO_SSL
+    QSslSocket* ssl = qobject_cast<QSslSocket*>(socket);
+    if (!ssl || !sessionResumption)
+        return;
+
+    // offer the ticket of the previous session to get an abbreviated handshake
+    QSslConfiguration config = ssl->sslConfiguration();
+    config.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+    const QByteArray ticket = sessionTickets.value(QString("%1 %2").arg(host).arg(port));
+    config.setSessionTicket(ticket);
+    ssl->setSslConfiguration(config);
+    if (ticket.isEmpty())
+        ++sessionCacheMisses;
+    else
+        ++sessionCacheHits;
+#endif // !QT_NO_SSL
+}
+
 void IrcConnectionPrivate::_irc_state(QAbstractSocket::SocketState state)
 {
     Q_Q(IrcConnection);
@@ -361,6 +456,26 @@ void IrcConnectionPrivate::_irc_filterDestroyed(QObject* filter)
 {
     messageFilters.removeAll(filter);
     commandFilters.removeAll(filter);
+
+    // the profile is keyed by the address, which may be reused
+    IrcConnectionStatisticsPrivate* stats = IrcConnectionStatisticsPrivate::get(statistics);
+    stats->removeFilterProfile(filter, false);
+    stats->removeFilterProfile(filter, true);
+}
+
+void IrcConnectionPrivate::_irc_drainOutbound()
+{
+    Q_Q(IrcConnection);
+    // reset before draining, so that anything enqueued
+    // from now on schedules another drain
+    outboundScheduled.fetchAndStoreOrdered(0);
+    while (IrcOutboundNode* node = outbound.dequeue()) {
+        if (node->command)
+            q->sendCommand(node->command);
+        else
+            q->sendData(node->data);
+        delete node;
+    }
 }
 
 static bool parseServer(const QString& server, QString* host, int* port, bool* ssl)
@@ -380,29 +495,188 @@ void IrcConnectionPrivate::open()
     Q_Q(IrcConnection);
     if (q->isActive()) {
         pendingOpen = true;
+    } else if (raceCount > 1 && servers.count() > 1) {
+        closed = false;
+        startRace();
     } else {
         closed = false;
+        QString server;
         if (!servers.isEmpty()) {
             QString h; int p; bool s;
-            QString server = servers.value((++currentServer) % servers.count());
+            if (reconnectPolicy)
+                currentServer = qMax(0, servers.indexOf(reconnectPolicy->rankServers(servers).value(0)));
+            else
+                ++currentServer;
+            server = servers.value(currentServer % servers.count());
             if (!parseServer(server, &h, &p, &s))
                 qWarning() << "IrcConnection::servers: malformed line" << server;
             q->setHost(h);
             q->setPort(p);
             q->setSecure(s);
+        } else {
+            server = QString("%1 %2%3").arg(host, q->isSecure() ? "+" : "").arg(port);
         }
+        attemptedServers = QStringList(server);
+        attemptStart = q->clock()->elapsed();
         socket->connectToHost(host, port);
         setConnectionCount(connectionCount + 1);
     }
 }
 
+void IrcConnectionPrivate::startRace()
+{
+    Q_Q(IrcConnection);
+    abortRace();
+    attemptedServers.clear();
+    attemptStart = q->clock()->elapsed();
+    const QStringList ranked = reconnectPolicy ? reconnectPolicy->rankServers(servers) : QStringList();
+    const int count = qMin(raceCount, servers.count());
+    for (int i = 0; i < count; ++i) {
+        IrcServerRacer contender;
+        if (reconnectPolicy)
+            contender.server = qMax(0, servers.indexOf(ranked.value(i)));
+        else
+            contender.server = (++currentServer) % servers.count();
+        attemptedServers += servers.value(contender.server);
+        const QString server = servers.value(contender.server);
+        if (!parseServer(server, &contender.host, &contender.port, &contender.secure))
+            qWarning() << "IrcConnection::servers: malformed line" << server;
+        racers += contender;
+    }
+    setStatus(IrcConnection::Connecting);
+    setConnectionCount(connectionCount + 1);
+    _irc_raceNext();
+}
+
+void IrcConnectionPrivate::abortRace()
+{
+    Q_Q(IrcConnection);
+    racer.stop();
+    foreach (const IrcServerRacer& contender, racers) {
+        if (contender.socket) {
+            contender.socket->disconnect(q);
+            contender.socket->abort();
+            contender.socket->deleteLater();
+        }
+    }
+    racers.clear();
+}
+
+void IrcConnectionPrivate::_irc_raceNext()
+{
+    Q_Q(IrcConnection);
+    // the contenders are started one after another, staggered by the race interval
+    for (int i = 0; i < racers.count(); ++i) {
+        IrcServerRacer& contender = racers[i];
+        if (contender.socket)
+            continue;
+
+#ifndef QT_NO_SSL
+        if (contender.secure) {
+            QSslSocket* ssl = new QSslSocket(q);
+            QSslSocket* current = qobject_cast<QSslSocket*>(socket);
+            if (current)
+                ssl->setSslConfiguration(current->sslConfiguration());
+            ssl->setPeerVerifyMode(QSslSocket::QueryPeer);
+            contender.socket = ssl;
+        }
+#endif // !QT_NO_SSL
+        if (!contender.socket)
+            contender.socket = new QTcpSocket(q);
+        contender.socket->setProxy(socket->proxy());
+        QObject::connect(contender.socket, SIGNAL(connected()), q, SLOT(_irc_raceConnected()));
+        QObject::connect(contender.socket, SIGNAL(error(QAbstractSocket::SocketError)), q, SLOT(_irc_raceError()), Qt::QueuedConnection);
+        contender.socket->connectToHost(contender.host, contender.port);
+
+        if (i < racers.count() - 1)
+            racer.start(raceInterval);
+        break;
+    }
+}
+
+void IrcConnectionPrivate::_irc_raceConnected()
+{
+    Q_Q(IrcConnection);
+    int winner = -1;
+    for (int i = 0; winner == -1 && i < racers.count(); ++i) {
+        if (racers.at(i).socket && racers.at(i).socket->state() == QAbstractSocket::ConnectedState)
+            winner = i;
+    }
+    if (winner == -1)
+        return;
+
+    // keep the first one to connect, and abort the rest
+    const IrcServerRacer contender = racers.takeAt(winner);
+    contender.socket->disconnect(q);
+    abortRace();
+
+    currentServer = contender.server;
+    attemptedServers = QStringList(servers.value(contender.server));
+    q->setHost(contender.host);
+    q->setPort(contender.port);
+    const bool secure = q->isSecure();
+    q->setSocket(contender.socket);
+    if (q->isSecure() != secure)
+        emit q->secureChanged(q->isSecure());
+
+    _irc_state(QAbstractSocket::ConnectedState);
+    _irc_connected();
+}
+
+void IrcConnectionPrivate::_irc_raceError()
+{
+    if (racers.isEmpty())
+        return;
+
+    QAbstractSocket::SocketError error = QAbstractSocket::UnknownSocketError;
+    bool pending = false;
+    foreach (const IrcServerRacer& contender, racers) {
+        if (!contender.socket)
+            pending = true;
+        else if (contender.socket->state() != QAbstractSocket::UnconnectedState)
+            return; // still connecting
+        else
+            error = contender.socket->error();
+    }
+
+    if (pending) {
+        // everything started so far has failed, no point in waiting for the next one
+        racer.stop();
+        _irc_raceNext();
+    } else {
+        abortRace();
+        _irc_error(error);
+    }
+}
+
 void IrcConnectionPrivate::reconnect()
 {
-    if (enabled && (status != IrcConnection::Closed || !closed || pendingOpen) && !reconnecter.isActive() && reconnecter.interval() > 0) {
-        pendingOpen = false;
-        reconnecter.start();
-        setStatus(IrcConnection::Waiting);
+    // the servers of an attempt that never got connected have failed
+    if (reconnectPolicy) {
+        foreach (const QString& server, attemptedServers)
+            reconnectPolicy->serverFailed(server);
     }
+    attemptedServers.clear();
+
+    if (enabled && (status != IrcConnection::Closed || !closed || pendingOpen) && !reconnecter.isActive()) {
+        int delay = reconnectDelay * 1000;
+        if (reconnectPolicy)
+            delay = reconnectPolicy->reconnectDelay(reconnectAttempts++);
+        if (reconnectPolicy ? delay >= 0 : delay > 0) {
+            IrcConnectionStatisticsPrivate::get(statistics)->reconnectCount.fetchAndAddRelaxed(1);
+            pendingOpen = false;
+            reconnecter.start(delay);
+            setStatus(IrcConnection::Waiting);
+        }
+    }
+}
+
+void IrcConnectionPrivate::post(IrcOutboundNode* node)
+{
+    Q_Q(IrcConnection);
+    outbound.enqueue(node);
+    if (outboundScheduled.testAndSetOrdered(0, 1))
+        QMetaObject::invokeMethod(q, "_irc_drainOutbound", Qt::QueuedConnection);
 }
 
 void IrcConnectionPrivate::setConnectionCount(int count)
@@ -432,6 +706,12 @@ void IrcConnectionPrivate::setStatus(IrcConnection::Status value)
         emit q->statusChanged(value);
 
         if (!wasConnected && q->isConnected()) {
+            reconnectAttempts = 0;
+            if (reconnectPolicy) {
+                foreach (const QString& server, attemptedServers)
+                    reconnectPolicy->serverSucceeded(server, q->clock()->elapsed() - attemptStart);
+            }
+            attemptedServers.clear();
             emit q->connected();
             foreach (const QByteArray& data, pendingData)
                 q->sendRaw(data);
@@ -469,14 +749,26 @@ bool IrcConnectionPrivate::receiveMessage(IrcMessage* msg)
         replies.insert(code);
     }
 
+    IrcConnectionStatisticsPrivate* stats = IrcConnectionStatisticsPrivate::get(statistics);
+    stats->countMessage(msg->type());
+
     bool filtered = false;
-    for (int i = messageFilters.count() - 1; !filtered && i >= 0; --i) {
-        IrcMessageFilter* filter = qobject_cast<IrcMessageFilter*>(messageFilters.at(i));
-        if (filter)
-            filtered |= filter->messageFilter(msg);
+    if (!messageFilters.isEmpty()) {
+        IrcStatisticsTimer timer(stats, IrcConnectionStatistics::FilterTime);
+        for (int i = messageFilters.count() - 1; !filtered && i >= 0; --i) {
+            IrcMessageFilter* filter = qobject_cast<IrcMessageFilter*>(messageFilters.at(i));
+            if (filter) {
+                IRC_TRACE_SCOPE("filter", messageFilters.at(i)->metaObject()->className());
+                IrcFilterProfiler profiler(stats, messageFilters.at(i), false, msg->type());
+                const bool swallowed = filter->messageFilter(msg);
+                profiler.finish(swallowed);
+                filtered |= swallowed;
+            }
+        }
     }
 
     if (!filtered) {
+        IrcStatisticsTimer timer(stats, IrcConnectionStatistics::DispatchTime);
         emit q->messageReceived(msg);
 
         switch (msg->type()) {
@@ -637,6 +929,18 @@ IrcConnection* IrcConnection::clone(QObject *parent) const
     connection->setReconnectDelay(reconnectDelay());
     connection->setSecure(isSecure());
     connection->setSaslMechanism(saslMechanism());
+    connection->setReadLineLimit(readLineLimit());
+    connection->setReadTimeLimit(readTimeLimit());
+    connection->setReadHighWatermark(readHighWatermark());
+    connection->setReadLowWatermark(readLowWatermark());
+    connection->setRaceCount(raceCount());
+    connection->setRaceInterval(raceInterval());
+    connection->setReconnectPolicy(reconnectPolicy());
+    connection->setSessionResumptionEnabled(isSessionResumptionEnabled());
+    IrcConnectionPrivate::get(connection)->sessionTickets = d->sessionTickets;
+    connection->setOptimisticHandshakeEnabled(isOptimisticHandshakeEnabled());
+    IrcConnectionPrivate::get(connection)->capabilityCache = d->capabilityCache;
+    connection->setClock(d->clock);
     return connection;
 }
 
@@ -1099,16 +1403,16 @@ void IrcConnection::setDisabled(bool disabled)
 int IrcConnection::reconnectDelay() const
 {
     Q_D(const IrcConnection);
-    return d->reconnecter.interval() / 1000;
+    return d->reconnectDelay;
 }
 
 void IrcConnection::setReconnectDelay(int seconds)
 {
     Q_D(IrcConnection);
-    const int interval = qMax(0, seconds) * 1000;
-    if (d->reconnecter.interval() != interval) {
-        d->reconnecter.setInterval(interval);
-        emit reconnectDelayChanged(interval);
+    seconds = qMax(0, seconds);
+    if (d->reconnectDelay != seconds) {
+        d->reconnectDelay = seconds;
+        emit reconnectDelayChanged(seconds * 1000);
     }
 }
 
@@ -1159,13 +1463,21 @@ void IrcConnection::setSocket(QAbstractSocket* socket)
 
         d->socket = socket;
         if (socket) {
+            if (d->readHighWatermark > 0)
+                socket->setReadBufferSize(d->readHighWatermark);
             connect(socket, SIGNAL(connected()), this, SLOT(_irc_connected()));
             connect(socket, SIGNAL(disconnected()), this, SLOT(_irc_disconnected()));
             connect(socket, SIGNAL(readyRead()), this, SLOT(_irc_readData()));
             connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(_irc_error(QAbstractSocket::SocketError)));
             connect(socket, SIGNAL(stateChanged(QAbstractSocket::SocketState)), this, SLOT(_irc_state(QAbstractSocket::SocketState)));
-            if (isSecure())
+            if (isSecure()) {
                 connect(socket, SIGNAL(sslErrors(QList<QSslError>)), this, SLOT(_irc_sslErrors()));
+                connect(socket, SIGNAL(encrypted()), this, SLOT(_irc_sessionTicket()));
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+                // TLS 1.3 servers send the tickets after the handshake
+                connect(socket, SIGNAL(newSessionTicketReceived()), this, SLOT(_irc_sessionTicket()));
+#endif
+            }
         }
     }
 }
@@ -1330,6 +1642,20 @@ IrcNetwork* IrcConnection::network() const
     return d->network;
 }
 
+/*!
+    \since 3.8
+
+    This property holds the runtime statistics of the connection.
+
+    \par Access function:
+    \li IrcConnectionStatistics* <b>statistics</b>() const
+ */
+IrcConnectionStatistics* IrcConnection::statistics() const
+{
+    Q_D(const IrcConnection);
+    return d->statistics;
+}
+
 /*!
     Opens a connection to the server.
 
@@ -1389,6 +1715,7 @@ void IrcConnection::open()
 void IrcConnection::close()
 {
     Q_D(IrcConnection);
+    d->abortRace();
     if (d->socket) {
         d->closed = true;
         d->pendingOpen = false;
@@ -1437,12 +1764,36 @@ void IrcConnection::quit(const QString& reason)
     sent. Thus, the command must have been allocated on the heap and
     it is not safe to access the command after it has been sent.
 
+    Since 3.8, this method is thread-safe. When called from another
+    thread, the \a command is moved to the thread of the connection and
+    queued. The queue is drained by the thread of the connection on the
+    next turn of its event loop, and the commands from each thread are
+    sent in the order they were queued. In that case the \a command must
+    not have a parent and must belong to the calling thread, and the method
+    returns \c true once the command has been queued.
+
     \sa sendData()
  */
 bool IrcConnection::sendCommand(IrcCommand* command)
 {
     Q_D(IrcConnection);
+    IRC_TRACE_SCOPE("core", "sendCommand");
     bool res = false;
+    if (command && QThread::currentThread() != thread()) {
+        if (command->parent()) {
+            qWarning("IrcConnection::sendCommand(): cannot send a command with a parent from another thread");
+            return false;
+        }
+        if (command->thread() != QThread::currentThread()) {
+            qWarning("IrcConnection::sendCommand(): cannot send a command that belongs to another thread");
+            return false;
+        }
+        IrcOutboundNode* node = new IrcOutboundNode;
+        command->moveToThread(thread());
+        node->command = command;
+        d->post(node);
+        return true;
+    }
     if (command) {
         bool filtered = false;
         IrcCommandPrivate::get(command)->connection = this;
@@ -1450,9 +1801,12 @@ bool IrcConnection::sendCommand(IrcCommand* command)
             QObject* filter = d->commandFilters.at(i);
             IrcCommandFilter* commandFilter = qobject_cast<IrcCommandFilter*>(filter);
             if (commandFilter && !d->activeCommandFilters.contains(filter)) {
+                IrcFilterProfiler profiler(IrcConnectionStatisticsPrivate::get(d->statistics), filter, true, command->type());
                 d->activeCommandFilters.push(filter);
-                filtered |= commandFilter->commandFilter(command);
+                const bool swallowed = commandFilter->commandFilter(command);
                 d->activeCommandFilters.pop();
+                profiler.finish(swallowed);
+                filtered |= swallowed;
             }
         }
         if (filtered) {
@@ -1471,11 +1825,21 @@ bool IrcConnection::sendCommand(IrcCommand* command)
 /*!
     Sends raw \a data to the server.
 
+    Since 3.8, this method is thread-safe. When called from another
+    thread, the \a data is queued and sent by the thread of the
+    connection, and the method returns \c true.
+
     \sa sendCommand()
  */
 bool IrcConnection::sendData(const QByteArray& data)
 {
     Q_D(IrcConnection);
+    if (QThread::currentThread() != thread()) {
+        IrcOutboundNode* node = new IrcOutboundNode;
+        node->data = data;
+        d->post(node);
+        return true;
+    }
     if (d->socket) {
         if (isActive()) {
             const QByteArray cmd = data.left(5).toUpper();
@@ -1489,7 +1853,12 @@ bool IrcConnection::sendData(const QByteArray& data)
                     d->setConnectionCount(0);
                 }
             }
-            return d->protocol->write(data);
+            if (!d->protocol->write(data))
+                return false;
+            IrcConnectionStatisticsPrivate* stats = IrcConnectionStatisticsPrivate::get(d->statistics);
+            stats->add(stats->bytesSent, data.size() + 2); // "\r\n"
+            stats->add(stats->linesSent);
+            return true;
         } else {
             d->pendingData += data;
         }
@@ -1545,6 +1914,7 @@ void IrcConnection::removeMessageFilter(QObject* filter)
     IrcMessageFilter* msgFilter = qobject_cast<IrcMessageFilter*>(filter);
     if (msgFilter) {
         d->messageFilters.removeAll(filter);
+        IrcConnectionStatisticsPrivate::get(d->statistics)->removeFilterProfile(filter, false);
         disconnect(filter, SIGNAL(destroyed(QObject*)), this, SLOT(_irc_filterDestroyed(QObject*)));
     }
 }
@@ -1587,6 +1957,7 @@ void IrcConnection::removeCommandFilter(QObject* filter)
     IrcCommandFilter* cmdFilter = qobject_cast<IrcCommandFilter*>(filter);
     if (cmdFilter) {
         d->commandFilters.removeAll(filter);
+        IrcConnectionStatisticsPrivate::get(d->statistics)->removeFilterProfile(filter, true);
         disconnect(filter, SIGNAL(destroyed(QObject*)), this, SLOT(_irc_filterDestroyed(QObject*)));
     }
 }
@@ -1618,6 +1989,16 @@ QByteArray IrcConnection::saveState(int version) const
     args.insert("reconnectDelay", reconnectDelay());
     args.insert("secure", isSecure());
     args.insert("saslMechanism", d->saslMechanism);
+    args.insert("sessionResumption", d->sessionResumption);
+    QVariantMap tickets;
+    for (QHash<QString, QByteArray>::const_iterator it = d->sessionTickets.constBegin(); it != d->sessionTickets.constEnd(); ++it)
+        tickets.insert(it.key(), it.value());
+    args.insert("sessionTickets", tickets);
+    args.insert("optimisticHandshake", d->optimisticHandshake);
+    QVariantMap capabilities;
+    for (QHash<QString, QStringList>::const_iterator it = d->capabilityCache.constBegin(); it != d->capabilityCache.constEnd(); ++it)
+        capabilities.insert(it.key(), it.value());
+    args.insert("capabilityCache", capabilities);
 
     QByteArray state;
     QDataStream out(&state, QIODevice::WriteOnly);
@@ -1663,6 +2044,14 @@ bool IrcConnection::restoreState(const QByteArray& state, int version)
     setReconnectDelay(args.value("reconnectDelay", reconnectDelay()).toInt());
     setSecure(args.value("secure", isSecure()).toBool());
     setSaslMechanism(args.value("saslMechanism", d->saslMechanism).toString());
+    setSessionResumptionEnabled(args.value("sessionResumption", d->sessionResumption).toBool());
+    const QVariantMap tickets = args.value("sessionTickets").toMap();
+    for (QVariantMap::const_iterator it = tickets.constBegin(); it != tickets.constEnd(); ++it)
+        d->sessionTickets.insert(it.key(), it.value().toByteArray());
+    setOptimisticHandshakeEnabled(args.value("optimisticHandshake", d->optimisticHandshake).toBool());
+    const QVariantMap capabilities = args.value("capabilityCache").toMap();
+    for (QVariantMap::const_iterator it = capabilities.constBegin(); it != capabilities.constEnd(); ++it)
+        d->capabilityCache.insert(it.key(), it.value().toStringList());
     return true;
 }
 
@@ -1728,6 +2117,478 @@ void IrcConnection::setProtocol(IrcProtocol* proto)
     }
 }
 
+/*!
+    \since 3.8
+
+    This property holds the maximum amount of lines processed at once.
+
+    When a large burst of data is received at once, for example when a
+    bouncer plays back its buffers, processing all of it in one go blocks
+    the event loop. When the limit is reached, the rest of the received
+    lines are processed on the next turn of the event loop, letting timers,
+    lag measurement and the UI keep up in the meanwhile.
+
+    The default value is \c 0 (unlimited).
+
+    \par Access functions:
+    \li int <b>readLineLimit</b>() const
+    \li void <b>setReadLineLimit</b>(int lines)
+
+    \sa readTimeLimit
+ */
+int IrcConnection::readLineLimit() const
+{
+    Q_D(const IrcConnection);
+    return d->readLineLimit;
+}
+
+void IrcConnection::setReadLineLimit(int lines)
+{
+    Q_D(IrcConnection);
+    d->readLineLimit = qMax(0, lines);
+}
+
+/*!
+    \since 3.8
+
+    This property holds the maximum time in microseconds spent processing received lines at once.
+
+    When the limit is exceeded, the rest of the received lines are
+    processed on the next turn of the event loop.
+
+    The default value is \c 0 (unlimited).
+
+    \par Access functions:
+    \li int <b>readTimeLimit</b>() const
+    \li void <b>setReadTimeLimit</b>(int usecs)
+
+    \sa readLineLimit
+ */
+int IrcConnection::readTimeLimit() const
+{
+    Q_D(const IrcConnection);
+    return d->readTimeLimit;
+}
+
+void IrcConnection::setReadTimeLimit(int usecs)
+{
+    Q_D(IrcConnection);
+    d->readTimeLimit = qMax(0, usecs);
+}
+
+/*!
+    \since 3.8
+
+    This property holds the amount of buffered input in bytes above which
+    the connection stops reading from the socket.
+
+    When messages are received faster than they can be processed, for
+    example when readLineLimit or readTimeLimit are in use, received data
+    is no longer drained from the socket once the high watermark has been
+    reached. The read buffer size of the \ref socket is limited to the
+    same amount, so that TCP flow control pushes back on the server.
+    Reading is resumed once the buffered input has dropped to the
+    \ref readLowWatermark "low watermark".
+
+    The default value is \c 0 (unlimited).
+
+    \par Access functions:
+    \li int <b>readHighWatermark</b>() const
+    \li void <b>setReadHighWatermark</b>(int bytes)
+
+    \sa readLowWatermark, bufferedBytes
+ */
+int IrcConnection::readHighWatermark() const
+{
+    Q_D(const IrcConnection);
+    return d->readHighWatermark;
+}
+
+void IrcConnection::setReadHighWatermark(int bytes)
+{
+    Q_D(IrcConnection);
+    bytes = qMax(0, bytes);
+    if (d->readHighWatermark != bytes) {
+        d->readHighWatermark = bytes;
+        if (d->socket)
+            d->socket->setReadBufferSize(bytes);
+    }
+}
+
+/*!
+    \since 3.8
+
+    This property holds the amount of buffered input in bytes at or below
+    which the connection resumes reading from the socket.
+
+    The low watermark has no effect unless \ref readHighWatermark is set.
+
+    The default value is \c 0, meaning that reading is resumed once all
+    buffered input has been processed.
+
+    \par Access functions:
+    \li int <b>readLowWatermark</b>() const
+    \li void <b>setReadLowWatermark</b>(int bytes)
+
+    \sa readHighWatermark, bufferedBytes
+ */
+int IrcConnection::readLowWatermark() const
+{
+    Q_D(const IrcConnection);
+    return d->readLowWatermark;
+}
+
+void IrcConnection::setReadLowWatermark(int bytes)
+{
+    Q_D(IrcConnection);
+    d->readLowWatermark = qMax(0, bytes);
+}
+
+/*!
+    \since 3.8
+
+    This property holds the amount of received bytes that have not been processed yet.
+
+    The amount includes both the data buffered by the \ref protocol
+    and the data still waiting in the \ref socket.
+
+    \par Access functions:
+    \li qint64 <b>bufferedBytes</b>() const
+
+    \sa readHighWatermark, readLowWatermark
+ */
+qint64 IrcConnection::bufferedBytes() const
+{
+    Q_D(const IrcConnection);
+    qint64 bytes = 0;
+    if (d->protocol)
+        bytes += d->protocol->bufferedBytes();
+    if (d->socket)
+        bytes += d->socket->bytesAvailable();
+    return bytes;
+}
+
+/*!
+    \since 3.8
+
+    Returns the approximate number of heap bytes held by the connection.
+
+    The number includes the settings and user data of the connection,
+    the \ref network info, the \ref statistics, the session and capability
+    caches, the data waiting to be sent or processed, and the \ref protocol
+    with its pending message batches and messages being composed.
+    Buffers and channels are accounted for separately, see
+    IrcBufferModel::memoryUsage().
+
+    The number is an estimate. It does not include the allocator
+    overhead, and data that is implicitly shared between several
+    holders is counted for each one of them.
+
+    \note This function must be called in the thread of the connection.
+
+    \sa IrcProtocol::memoryUsage()
+ */
+qint64 IrcConnection::memoryUsage() const
+{
+    Q_D(const IrcConnection);
+    qint64 bytes = IrcMemory::ObjectSize + sizeof(IrcConnectionPrivate);
+    bytes += IrcMemory::of(d->encoding) + IrcMemory::of(d->host) + IrcMemory::of(d->servers);
+    bytes += IrcMemory::of(d->userName) + IrcMemory::of(d->nickName) + IrcMemory::of(d->realName);
+    bytes += IrcMemory::of(d->password) + IrcMemory::of(d->nickNames) + IrcMemory::of(d->displayName);
+    bytes += IrcMemory::of(d->userData) + IrcMemory::of(d->attemptedServers) + IrcMemory::of(d->saslMechanism);
+    bytes += IrcMemory::of(d->ctcpReplies) + IrcMemory::of(d->pendingData) + IrcMemory::of(d->replies);
+    bytes += IrcMemory::of(d->commandFilters) + IrcMemory::of(d->messageFilters);
+    bytes += IrcMemory::of(d->sessionTickets) + IrcMemory::of(d->capabilityCache);
+
+    if (d->network) {
+        const IrcNetworkPrivate* network = IrcNetworkPrivate::get(d->network);
+        bytes += IrcMemory::ObjectSize + sizeof(IrcNetworkPrivate) + IrcMemory::of(network->name);
+        bytes += IrcMemory::of(network->modes) + IrcMemory::of(network->prefixes) + IrcMemory::of(network->channelTypes);
+        bytes += IrcMemory::of(network->channelModes) + IrcMemory::of(network->statusPrefixes);
+        bytes += IrcMemory::of(network->numericLimits) + IrcMemory::of(network->modeLimits);
+        bytes += IrcMemory::of(network->channelLimits) + IrcMemory::of(network->targetLimits);
+        bytes += IrcMemory::of(network->availableCaps) + IrcMemory::of(network->requestedCaps) + IrcMemory::of(network->activeCaps);
+    }
+
+    if (d->statistics) {
+        IrcConnectionStatisticsPrivate* stats = IrcConnectionStatisticsPrivate::get(d->statistics);
+        bytes += IrcMemory::ObjectSize + sizeof(IrcConnectionStatisticsPrivate);
+        QMutexLocker locker(&stats->filterMutex);
+        bytes += stats->filterProfiles.count() * qint64(3 * sizeof(void*) + sizeof(IrcFilterProfileKey) + sizeof(IrcFilterProfile));
+        foreach (const IrcFilterProfile& profile, stats->filterProfiles)
+            bytes += IrcMemory::of(profile.filter);
+    }
+
+    if (d->socket) {
+        // the socket, and its read and write buffers
+        bytes += 2 * IrcMemory::ObjectSize;
+        bytes += d->socket->bytesAvailable() + d->socket->bytesToWrite();
+    }
+
+    if (d->protocol)
+        bytes += d->protocol->memoryUsage();
+    return bytes;
+}
+
+/*!
+    \since 3.8
+
+    This property holds the number of servers connected to in parallel.
+
+    When the value is greater than \c 1, opening the connection races
+    connects to that many next entries in \ref servers at once, each
+    started \ref raceInterval "a moment" after the previous one. The
+    first server to accept the connection is kept, and the rest are
+    aborted. That way, the time it takes to connect or reconnect after an
+    outage is the time of the fastest server, instead of the sum of the
+    timeouts of the unreachable ones.
+
+    \note The winning server replaces the \ref socket of the connection.
+    The proxy and SSL configuration of the current socket are applied to
+    the contenders.
+
+    The default value is \c 1 (no racing).
+
+    \par Access functions:
+    \li int <b>raceCount</b>() const
+    \li void <b>setRaceCount</b>(int count)
+
+    \sa servers, raceInterval
+ */
+int IrcConnection::raceCount() const
+{
+    Q_D(const IrcConnection);
+    return d->raceCount;
+}
+
+void IrcConnection::setRaceCount(int count)
+{
+    Q_D(IrcConnection);
+    d->raceCount = qMax(1, count);
+}
+
+/*!
+    \since 3.8
+
+    This property holds the delay in milliseconds between starting the racing connects.
+
+    If all the connects started so far fail, the next one is started right away.
+
+    The default value is \c 250 milliseconds.
+
+    \par Access functions:
+    \li int <b>raceInterval</b>() const
+    \li void <b>setRaceInterval</b>(int msecs)
+
+    \sa raceCount
+ */
+int IrcConnection::raceInterval() const
+{
+    Q_D(const IrcConnection);
+    return d->raceInterval;
+}
+
+void IrcConnection::setRaceInterval(int msecs)
+{
+    Q_D(IrcConnection);
+    d->raceInterval = qMax(0, msecs);
+}
+
+/*!
+    \since 3.8
+
+    This property holds the reconnect policy.
+
+    When set, the policy decides the delay of each reconnect attempt
+    instead of the fixed \ref reconnectDelay, and the order in which the
+    \ref servers are tried. The connection reports the outcome of each
+    attempt to the policy. The connection does not take ownership of the
+    policy, and the same policy may be shared by several connections.
+
+    The default value is \c nullptr (fixed delay, round-robin servers).
+
+    \par Access functions:
+    \li \ref IrcReconnectPolicy* <b>reconnectPolicy</b>() const
+    \li void <b>setReconnectPolicy</b>(\ref IrcReconnectPolicy* policy)
+
+    \sa reconnectDelay, servers
+ */
+IrcReconnectPolicy* IrcConnection::reconnectPolicy() const
+{
+    Q_D(const IrcConnection);
+    return d->reconnectPolicy;
+}
+
+void IrcConnection::setReconnectPolicy(IrcReconnectPolicy* policy)
+{
+    Q_D(IrcConnection);
+    d->reconnectPolicy = policy;
+}
+
+/*!
+    \since 3.8
+
+    This property holds whether TLS sessions are resumed on reconnect.
+
+    When enabled, the TLS session ticket received from a \ref secure
+    server is cached per host and port, and offered to the server when
+    connecting to it again. If the server accepts the ticket, the full
+    handshake is replaced by an abbreviated one, which saves CPU on both
+    ends when reconnecting after a network blip.
+
+    The cached tickets are included in saveState(). Notice that a session
+    ticket is a secret, so the saved state must be stored accordingly.
+
+    The default value is \c false.
+
+    \par Access functions:
+    \li bool <b>isSessionResumptionEnabled</b>() const
+    \li void <b>setSessionResumptionEnabled</b>(bool enabled)
+
+    \sa sessionCacheHits, sessionCacheMisses, clearSessionCache()
+ */
+bool IrcConnection::isSessionResumptionEnabled() const
+{
+    Q_D(const IrcConnection);
+    return d->sessionResumption;
+}
+
+void IrcConnection::setSessionResumptionEnabled(bool enabled)
+{
+    Q_D(IrcConnection);
+    d->sessionResumption = enabled;
+}
+
+/*!
+    \since 3.8
+
+    This property holds the number of secure connection attempts
+    that offered a cached TLS session ticket.
+
+    Whether the session was actually resumed is up to the server.
+
+    \par Access function:
+    \li int <b>sessionCacheHits</b>() const
+
+    \sa sessionResumptionEnabled, sessionCacheMisses
+ */
+int IrcConnection::sessionCacheHits() const
+{
+    Q_D(const IrcConnection);
+    return d->sessionCacheHits;
+}
+
+/*!
+    \since 3.8
+
+    This property holds the number of secure connection attempts
+    that had no cached TLS session ticket to offer.
+
+    \par Access function:
+    \li int <b>sessionCacheMisses</b>() const
+
+    \sa sessionResumptionEnabled, sessionCacheHits
+ */
+int IrcConnection::sessionCacheMisses() const
+{
+    Q_D(const IrcConnection);
+    return d->sessionCacheMisses;
+}
+
+/*!
+    \since 3.8
+
+    Clears the cached TLS session tickets and resets the hit and miss counters.
+
+    \sa sessionResumptionEnabled
+ */
+void IrcConnection::clearSessionCache()
+{
+    Q_D(IrcConnection);
+    d->sessionTickets.clear();
+    d->sessionCacheHits = 0;
+    d->sessionCacheMisses = 0;
+}
+
+/*!
+    \since 3.8
+
+    This property holds whether the registration handshake is pipelined.
+
+    The regular handshake takes several round trips: the capabilities are
+    requested after the server has listed them, SASL authentication starts
+    after the server has acknowledged the capabilities, and so on.
+
+    When enabled, the capabilities that each server advertised the last
+    time are remembered. When connecting to the same server again, the
+    capability request, SASL authentication, \c NICK, \c USER and
+    <tt>CAP END</tt> are sent at once, without waiting for the replies.
+    If the server rejects the request because its capabilities have
+    changed, the connection falls back to the regular handshake.
+
+    The remembered capabilities are included in saveState().
+
+    The default value is \c false.
+
+    \par Access functions:
+    \li bool <b>isOptimisticHandshakeEnabled</b>() const
+    \li void <b>setOptimisticHandshakeEnabled</b>(bool enabled)
+
+    \sa IrcNetwork::requestedCapabilities
+ */
+bool IrcConnection::isOptimisticHandshakeEnabled() const
+{
+    Q_D(const IrcConnection);
+    return d->optimisticHandshake;
+}
+
+void IrcConnection::setOptimisticHandshakeEnabled(bool enabled)
+{
+    Q_D(IrcConnection);
+    d->optimisticHandshake = enabled;
+}
+
+/*!
+    \since 3.8
+
+    This property holds the clock that drives the timers of the connection.
+
+    The reconnect and server race timers of the connection run on the clock,
+    as do the timers of IrcLagTimer, IrcCommandQueue and IrcBufferModel that
+    are attached to the connection. A \ref IrcClock::VirtualTime "virtual time"
+    clock lets simulations and benchmarks run them faster than real time.
+
+    The clock should be set before the connection is opened. The connection
+    does not take ownership of the clock.
+
+    The default value is IrcClock::system(). Setting \c nullptr restores the default.
+
+    \par Access functions:
+    \li \ref IrcClock* <b>clock</b>() const
+    \li void <b>setClock</b>(\ref IrcClock* clock)
+
+    \par Notifier signal:
+    \li void <b>clockChanged</b>(\ref IrcClock* clock)
+ */
+IrcClock* IrcConnection::clock() const
+{
+    Q_D(const IrcConnection);
+    return d->clock ? d->clock.data() : IrcClock::system();
+}
+
+void IrcConnection::setClock(IrcClock* clock)
+{
+    Q_D(IrcConnection);
+    if (clock == IrcClock::system())
+        clock = nullptr;
+    if (d->clock != clock) {
+        d->clock = clock;
+        d->reconnecter.setClock(clock);
+        d->racer.setClock(clock);
+        emit clockChanged(this->clock());
+    }
+}
+
 #ifndef QT_NO_DEBUG_STREAM
 QDebug operator<<(QDebug debug, IrcConnection::Status status)
 {
@@ -0,0 +1,511 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ircconnectionstatistics.h"
+#include "ircconnectionstatistics_p.h"
+#include "ircconnection.h"
+#include "irccommand.h"
+#include <QMutexLocker>
+#include <QMetaEnum>
+#include <QtAlgorithms>
+#include <algorithm>
+
+IRC_BEGIN_NAMESPACE
+
+/*!
+    \file ircconnectionstatistics.h
+    \brief \#include &lt;IrcConnectionStatistics&gt;
+ */
+
+/*!
+    \since 3.8
+    \class IrcConnectionStatistics ircconnectionstatistics.h IrcConnectionStatistics
+    \ingroup core
+    \brief Provides runtime statistics of an IRC connection.
+
+    IrcConnectionStatistics counts the traffic of a connection, the messages
+    it has received by type, and measures how long it takes to parse, decode,
+    filter and dispatch the received messages. The counters are cheap enough
+    to be kept enabled in production, and may be read from any thread.
+
+    The statistics of a connection are available via IrcConnection::statistics().
+    The snapshot() method returns all counters in a QVariantMap, suitable for
+    exporting to a metrics collector.
+
+    \code
+    QVariantMap stats = connection->statistics()->snapshot();
+    qDebug() << stats.value("bytesReceived") << stats.value("messages");
+    \endcode
+
+    \sa IrcConnection::statistics
+ */
+
+/*!
+    \enum IrcConnectionStatistics::Timing
+    This enum describes the measured processing stages of received messages,
+    and the round trip time to the server.
+ */
+
+/*!
+    \var IrcConnectionStatistics::ParseTime
+    \brief Parsing a received line into an IrcMessage.
+ */
+
+/*!
+    \var IrcConnectionStatistics::DecodeTime
+    \brief Decoding the prefix, command, parameters and tags of a message to text.
+ */
+
+/*!
+    \var IrcConnectionStatistics::FilterTime
+    \brief Passing a message through the installed message filters.
+ */
+
+/*!
+    \var IrcConnectionStatistics::DispatchTime
+    \brief Emitting the message signals, including the time spent in connected models and other receivers.
+ */
+
+/*!
+    \var IrcConnectionStatistics::RoundTripTime
+    \brief The time from sending a lag probe to receiving its reply, as measured by IrcLagTimer.
+ */
+
+#ifndef IRC_DOXYGEN
+void IrcStatisticsHistogram::record(qint64 nsecs)
+{
+    const qint64 usecs = qMax<qint64>(0, nsecs) / 1000;
+    int bucket = 0;
+    if (usecs > 0)
+        bucket = qMin<int>(BucketCount - 1, 32 - qCountLeadingZeroBits(quint32(qMin<qint64>(usecs, 0xffffffff))));
+    count.fetchAndAddRelaxed(1);
+    total.fetchAndAddRelaxed(nsecs);
+    buckets[bucket].fetchAndAddRelaxed(1);
+}
+
+void IrcStatisticsHistogram::reset()
+{
+    IrcPrivate::storeRelaxed(count, 0);
+    IrcPrivate::storeRelaxed(total, 0);
+    for (int i = 0; i < BucketCount; ++i)
+        IrcPrivate::storeRelaxed(buckets[i], 0);
+}
+
+void IrcConnectionStatisticsPrivate::setCommandQueueDepth(int depth)
+{
+    IrcPrivate::storeRelaxed(commandQueueDepth, depth);
+}
+
+void IrcConnectionStatisticsPrivate::setLag(qint64 msecs)
+{
+    IrcPrivate::storeRelaxed(lag, msecs);
+}
+
+void IrcConnectionStatisticsPrivate::addRoundTripTime(qint64 msecs)
+{
+    timings[IrcConnectionStatistics::RoundTripTime].record(msecs * 1000000);
+}
+
+void IrcConnectionStatisticsPrivate::profileFilter(QObject* filter, const char* className, const QString& objectName, bool command, int type, qint64 nsecs, bool filtered)
+{
+    const IrcFilterProfileKey key = { filter, command, type };
+    QMutexLocker locker(&filterMutex);
+    QMap<IrcFilterProfileKey, IrcFilterProfile>::iterator it = filterProfiles.find(key);
+    if (it == filterProfiles.end()) {
+        IrcFilterProfile profile;
+        profile.filter = QString::fromLatin1(className);
+        if (!objectName.isEmpty())
+            profile.filter += QLatin1Char('(') + objectName + QLatin1Char(')');
+        profile.command = command;
+        profile.type = type;
+        it = filterProfiles.insert(key, profile);
+    }
+    ++it->invocations;
+    if (filtered)
+        ++it->filtered;
+    it->total += nsecs;
+    it->max = qMax(it->max, nsecs);
+}
+
+void IrcConnectionStatisticsPrivate::removeFilterProfile(QObject* filter, bool command)
+{
+    QMutexLocker locker(&filterMutex);
+    QMap<IrcFilterProfileKey, IrcFilterProfile>::iterator it = filterProfiles.begin();
+    while (it != filterProfiles.end()) {
+        if (it.key().filter == filter && it.key().command == command)
+            it = filterProfiles.erase(it);
+        else
+            ++it;
+    }
+}
+
+static bool irc_filter_profile_greater(const IrcFilterProfile& a, const IrcFilterProfile& b)
+{
+    return a.total > b.total;
+}
+
+static const char* const irc_timing_names[] = { "parseTime", "decodeTime", "filterTime", "dispatchTime", "roundTripTime" };
+#endif // IRC_DOXYGEN
+
+/*!
+    \internal
+    Constructs new statistics for IRC \a connection.
+ */
+IrcConnectionStatistics::IrcConnectionStatistics(IrcConnection* connection) : QObject(connection), d_ptr(new IrcConnectionStatisticsPrivate)
+{
+    Q_D(IrcConnectionStatistics);
+    d->q_ptr = this;
+    d->connection = connection;
+}
+
+/*!
+    \internal
+    Destructs the statistics.
+ */
+IrcConnectionStatistics::~IrcConnectionStatistics()
+{
+}
+
+/*!
+    This property holds the connection.
+
+    \par Access function:
+    \li \ref IrcConnection* <b>connection</b>() const
+ */
+IrcConnection* IrcConnectionStatistics::connection() const
+{
+    Q_D(const IrcConnectionStatistics);
+    return d->connection;
+}
+
+/*!
+    This property holds the number of bytes read from the socket.
+
+    \par Access function:
+    \li qint64 <b>bytesReceived</b>() const
+ */
+qint64 IrcConnectionStatistics::bytesReceived() const
+{
+    Q_D(const IrcConnectionStatistics);
+    return IrcPrivate::loadRelaxed(d->bytesReceived);
+}
+
+/*!
+    This property holds the number of bytes written to the socket.
+
+    \par Access function:
+    \li qint64 <b>bytesSent</b>() const
+ */
+qint64 IrcConnectionStatistics::bytesSent() const
+{
+    Q_D(const IrcConnectionStatistics);
+    return IrcPrivate::loadRelaxed(d->bytesSent);
+}
+
+/*!
+    This property holds the number of received lines.
+
+    \par Access function:
+    \li qint64 <b>linesReceived</b>() const
+ */
+qint64 IrcConnectionStatistics::linesReceived() const
+{
+    Q_D(const IrcConnectionStatistics);
+    return IrcPrivate::loadRelaxed(d->linesReceived);
+}
+
+/*!
+    This property holds the number of sent lines.
+
+    \par Access function:
+    \li qint64 <b>linesSent</b>() const
+ */
+qint64 IrcConnectionStatistics::linesSent() const
+{
+    Q_D(const IrcConnectionStatistics);
+    return IrcPrivate::loadRelaxed(d->linesSent);
+}
+
+/*!
+    Returns the number of received messages of \a type.
+
+    Messages composed of several lines, such as IrcNamesMessage,
+    are counted once in addition to the lines they are composed of.
+ */
+qint64 IrcConnectionStatistics::messageCount(IrcMessage::Type type) const
+{
+    Q_D(const IrcConnectionStatistics);
+    if (type < IrcMessage::Unknown || type > IrcMessage::Batch)
+        return 0;
+    return IrcPrivate::loadRelaxed(d->messages[type]);
+}
+
+/*!
+    Returns the number of measurements of \a timing.
+ */
+qint64 IrcConnectionStatistics::timingCount(IrcConnectionStatistics::Timing timing) const
+{
+    Q_D(const IrcConnectionStatistics);
+    if (timing < ParseTime || timing > RoundTripTime)
+        return 0;
+    return IrcPrivate::loadRelaxed(d->timings[timing].count);
+}
+
+/*!
+    Returns the total time of \a timing in nanoseconds.
+ */
+qint64 IrcConnectionStatistics::timingTotal(IrcConnectionStatistics::Timing timing) const
+{
+    Q_D(const IrcConnectionStatistics);
+    if (timing < ParseTime || timing > RoundTripTime)
+        return 0;
+    return IrcPrivate::loadRelaxed(d->timings[timing].total);
+}
+
+/*!
+    Returns the histogram of \a timing.
+
+    The histogram has histogramBuckets() buckets. The bucket \c N counts
+    the measurements that took less than 2<sup>N</sup> microseconds, but
+    at least 2<sup>N-1</sup> microseconds. The last bucket also counts all
+    measurements that took longer.
+ */
+QList<qint64> IrcConnectionStatistics::timingHistogram(IrcConnectionStatistics::Timing timing) const
+{
+    Q_D(const IrcConnectionStatistics);
+    QList<qint64> histogram;
+    if (timing >= ParseTime && timing <= RoundTripTime) {
+        for (int i = 0; i < IrcStatisticsHistogram::BucketCount; ++i)
+            histogram += IrcPrivate::loadRelaxed(d->timings[timing].buckets[i]);
+    }
+    return histogram;
+}
+
+/*!
+    Returns the number of buckets in the timing histograms.
+
+    \sa timingHistogram()
+ */
+int IrcConnectionStatistics::histogramBuckets()
+{
+    return IrcStatisticsHistogram::BucketCount;
+}
+
+/*!
+    This property holds the number of received bytes waiting to be processed.
+
+    \par Access function:
+    \li qint64 <b>bufferedBytes</b>() const
+
+    \sa IrcConnection::bufferedBytes
+ */
+qint64 IrcConnectionStatistics::bufferedBytes() const
+{
+    Q_D(const IrcConnectionStatistics);
+    return IrcPrivate::loadRelaxed(d->bufferedBytes);
+}
+
+/*!
+    This property holds the number of commands waiting in a command queue.
+
+    The depth is updated by IrcCommandQueue.
+
+    \par Access function:
+    \li int <b>commandQueueDepth</b>() const
+ */
+int IrcConnectionStatistics::commandQueueDepth() const
+{
+    Q_D(const IrcConnectionStatistics);
+    return IrcPrivate::loadRelaxed(d->commandQueueDepth);
+}
+
+/*!
+    This property holds the number of scheduled reconnects.
+
+    \par Access function:
+    \li int <b>reconnectCount</b>() const
+ */
+int IrcConnectionStatistics::reconnectCount() const
+{
+    Q_D(const IrcConnectionStatistics);
+    return IrcPrivate::loadRelaxed(d->reconnectCount);
+}
+
+/*!
+    This property holds the lag in milliseconds, or \c -1 if unknown.
+
+    The lag is updated by IrcLagTimer.
+
+    \par Access function:
+    \li qint64 <b>lag</b>() const
+ */
+qint64 IrcConnectionStatistics::lag() const
+{
+    Q_D(const IrcConnectionStatistics);
+    return IrcPrivate::loadRelaxed(d->lag);
+}
+
+/*!
+    This property holds whether the time spent in each installed filter is measured.
+
+    The filter profile shows which message or command filter slows down the
+    connection. Profiling takes a lock for every filter invocation, so it is
+    disabled by default.
+
+    \par Access functions:
+    \li bool <b>isFilterProfilingEnabled</b>() const
+    \li void <b>setFilterProfilingEnabled</b>(bool enabled)
+
+    \sa filterProfile()
+ */
+bool IrcConnectionStatistics::isFilterProfilingEnabled() const
+{
+    Q_D(const IrcConnectionStatistics);
+    return IrcPrivate::loadRelaxed(d->filterProfiling);
+}
+
+void IrcConnectionStatistics::setFilterProfilingEnabled(bool enabled)
+{
+    Q_D(IrcConnectionStatistics);
+    IrcPrivate::storeRelaxed(d->filterProfiling, enabled);
+}
+
+/*!
+    Returns the filter profile, sorted by the total time spent, most expensive first.
+
+    Each entry is a map of:
+    \li \c "filter" - the class name of the filter, followed by its object name in parentheses, if any,
+    \li \c "kind" - \c "message" for message filters, \c "command" for command filters,
+    \li \c "type" - the IrcMessage::Type or IrcCommand::Type name,
+    \li \c "invocations" - the number of times the filter was called,
+    \li \c "filtered" - the number of times the filter swallowed the message or command,
+    \li \c "total" - the total time spent in the filter in nanoseconds, and
+    \li \c "max" - the longest single invocation in nanoseconds.
+
+    \sa filterProfilingEnabled
+ */
+QVariantList IrcConnectionStatistics::filterProfile() const
+{
+    Q_D(const IrcConnectionStatistics);
+    QList<IrcFilterProfile> profiles;
+    {
+        QMutexLocker locker(&d->filterMutex);
+        profiles = d->filterProfiles.values();
+    }
+    std::sort(profiles.begin(), profiles.end(), irc_filter_profile_greater);
+
+    const QMetaEnum messageTypes = IrcMessage::staticMetaObject.enumerator(IrcMessage::staticMetaObject.indexOfEnumerator("Type"));
+    const QMetaEnum commandTypes = IrcCommand::staticMetaObject.enumerator(IrcCommand::staticMetaObject.indexOfEnumerator("Type"));
+
+    QVariantList list;
+    foreach (const IrcFilterProfile& profile, profiles) {
+        QVariantMap entry;
+        entry.insert("filter", profile.filter);
+        entry.insert("kind", QString::fromLatin1(profile.command ? "command" : "message"));
+        entry.insert("type", QString::fromLatin1((profile.command ? commandTypes : messageTypes).valueToKey(profile.type)));
+        entry.insert("invocations", profile.invocations);
+        entry.insert("filtered", profile.filtered);
+        entry.insert("total", profile.total);
+        entry.insert("max", profile.max);
+        list += entry;
+    }
+    return list;
+}
+
+/*!
+    Returns a snapshot of all statistics.
+
+    The keys of the map are the names of the properties, \c "messages" for
+    the message counts by IrcMessage::Type name, and \c "parseTime",
+    \c "decodeTime", \c "filterTime", \c "dispatchTime" and \c "roundTripTime"
+    for the timings.
+    Each timing is a map of \c "count", \c "total" (nanoseconds) and
+    \c "histogram" (see timingHistogram()). The \c "filters" key holds
+    the filterProfile().
+
+    The counters are read independently of each other, so a snapshot taken
+    while the connection is busy is not necessarily consistent as a whole.
+ */
+QVariantMap IrcConnectionStatistics::snapshot() const
+{
+    Q_D(const IrcConnectionStatistics);
+    QVariantMap map;
+    map.insert("bytesReceived", bytesReceived());
+    map.insert("bytesSent", bytesSent());
+    map.insert("linesReceived", linesReceived());
+    map.insert("linesSent", linesSent());
+    map.insert("bufferedBytes", bufferedBytes());
+    map.insert("commandQueueDepth", commandQueueDepth());
+    map.insert("reconnectCount", reconnectCount());
+    map.insert("lag", lag());
+
+    QVariantMap messages;
+    const QMetaEnum types = IrcMessage::staticMetaObject.enumerator(IrcMessage::staticMetaObject.indexOfEnumerator("Type"));
+    for (int i = IrcMessage::Unknown; i <= IrcMessage::Batch; ++i)
+        messages.insert(QString::fromLatin1(types.valueToKey(i)), IrcPrivate::loadRelaxed(d->messages[i]));
+    map.insert("messages", messages);
+
+    for (int t = ParseTime; t <= RoundTripTime; ++t) {
+        QVariantList histogram;
+        foreach (qint64 count, timingHistogram(static_cast<Timing>(t)))
+            histogram += count;
+        QVariantMap timing;
+        timing.insert("count", timingCount(static_cast<Timing>(t)));
+        timing.insert("total", timingTotal(static_cast<Timing>(t)));
+        timing.insert("histogram", histogram);
+        map.insert(QString::fromLatin1(irc_timing_names[t]), timing);
+    }
+    map.insert("filters", filterProfile());
+    return map;
+}
+
+/*!
+    Resets the counters, timings and the filter profile.
+
+    The current buffer and queue depths and the lag are left intact.
+ */
+void IrcConnectionStatistics::reset()
+{
+    Q_D(IrcConnectionStatistics);
+    IrcPrivate::storeRelaxed(d->bytesReceived, 0);
+    IrcPrivate::storeRelaxed(d->bytesSent, 0);
+    IrcPrivate::storeRelaxed(d->linesReceived, 0);
+    IrcPrivate::storeRelaxed(d->linesSent, 0);
+    IrcPrivate::storeRelaxed(d->reconnectCount, 0);
+    for (int i = IrcMessage::Unknown; i <= IrcMessage::Batch; ++i)
+        IrcPrivate::storeRelaxed(d->messages[i], 0);
+    for (int t = ParseTime; t <= RoundTripTime; ++t)
+        d->timings[t].reset();
+
+    QMutexLocker locker(&d->filterMutex);
+    d->filterProfiles.clear();
+}
+
+#include "moc_ircconnectionstatistics.cpp"
+
+IRC_END_NAMESPACE
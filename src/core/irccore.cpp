@@ -55,11 +55,21 @@ namespace IrcCore {
         qRegisterMetaType<Irc::SortMethod>("Irc::SortMethod");
         qRegisterMetaType<Irc::Code>("Irc::Code");
 
+        qRegisterMetaType<IrcClock*>("IrcClock*");
+        qRegisterMetaType<IrcClock::Mode>("IrcClock::Mode");
+
         qRegisterMetaType<IrcConnection*>("IrcConnection*");
         qRegisterMetaType<IrcConnection::Status>("IrcConnection::Status");
+        qRegisterMetaType<IrcConnectionStatistics*>("IrcConnectionStatistics*");
 
         qRegisterMetaType<IrcNetwork*>("IrcNetwork*");
 
+        qRegisterMetaType<IrcReconnectPolicy*>("IrcReconnectPolicy*");
+
+        qRegisterMetaType<IrcTrafficRecorder*>("IrcTrafficRecorder*");
+        qRegisterMetaType<IrcTrafficReplay*>("IrcTrafficReplay*");
+        qRegisterMetaType<IrcTrafficReplay::Pace>("IrcTrafficReplay::Pace");
+
         qRegisterMetaType<IrcCommand*>("IrcCommand*");
         qRegisterMetaType<IrcCommand::Type>("IrcCommand::Type");
 
@@ -0,0 +1,401 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ircdebug_p.h"
+#include <QCoreApplication>
+#include <QAtomicInteger>
+#include <QMutexLocker>
+#include <QDateTime>
+#include <QThread>
+#include <QMutex>
+#include <QFile>
+#include <QHash>
+#include <climits>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+#include <QRegularExpression>
+#else
+#include <QRegExp>
+#endif
+
+IRC_BEGIN_NAMESPACE
+
+#ifndef IRC_DOXYGEN
+QBasicAtomicInt IrcDebug::maxLevel = Q_BASIC_ATOMIC_INITIALIZER(INT_MAX);
+
+static const char* irc_debug_marker(int level)
+{
+    switch (level) {
+        case IrcDebug::Error: return "!!";
+        case IrcDebug::Status: return "??";
+        case IrcDebug::Write: return "->";
+        case IrcDebug::Read: return "<-";
+        default: return "";
+    }
+}
+
+class IrcDebugSink : public QThread
+{
+public:
+    IrcDebugSink(const QString& pattern, int capacity);
+    ~IrcDebugSink();
+
+    void post(qint64 stamp, int level, const QString& name, const QString& line);
+    void flush();
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    int drain();
+    QFile* file(const QString& name);
+
+    struct Entry
+    {
+        QAtomicInteger<quint64> sequence;
+        qint64 stamp = 0;
+        int level = 0;
+        QString name;
+        QString line;
+    };
+
+    const QString pattern;
+    const int capacity;
+    Entry* entries;
+    QAtomicInteger<quint64> head;
+    QAtomicInteger<quint64> written;
+    QAtomicInt dropped;
+    QAtomicInt stopping;
+
+    // owned by the writer thread
+    quint64 tail;
+    QHash<QString, QFile*> files;
+    qint64 second;
+    QByteArray timestamp;
+};
+
+IrcDebugSink::IrcDebugSink(const QString& pattern, int capacity)
+    : pattern(pattern), capacity(capacity), entries(new Entry[capacity]), tail(0), second(-1)
+{
+    for (int i = 0; i < capacity; ++i)
+        IrcPrivate::storeRelaxed(entries[i].sequence, i);
+}
+
+IrcDebugSink::~IrcDebugSink()
+{
+    stop();
+    qDeleteAll(files);
+    delete [] entries;
+}
+
+void IrcDebugSink::post(qint64 stamp, int level, const QString& name, const QString& line)
+{
+    // a bounded multi-producer queue: each slot carries a sequence number
+    // that tells whether it is free for the position being claimed
+    quint64 pos = IrcPrivate::loadRelaxed(head);
+    Entry* entry = nullptr;
+    forever {
+        entry = &entries[pos % capacity];
+        const qint64 diff = qint64(entry->sequence.loadAcquire()) - qint64(pos);
+        if (diff == 0) {
+            if (head.testAndSetRelaxed(pos, pos + 1, pos))
+                break;
+        } else if (diff < 0) {
+            // full: drop the line rather than block the connection
+            dropped.ref();
+            return;
+        } else {
+            pos = IrcPrivate::loadRelaxed(head);
+        }
+    }
+    entry->stamp = stamp;
+    entry->level = level;
+    entry->name = name;
+    entry->line = line;
+    entry->sequence.storeRelease(pos + 1);
+}
+
+void IrcDebugSink::flush()
+{
+    const quint64 target = head.loadAcquire();
+    while (isRunning() && written.loadAcquire() < target)
+        QThread::msleep(1);
+}
+
+void IrcDebugSink::stop()
+{
+    stopping.storeRelease(1);
+    wait();
+}
+
+void IrcDebugSink::run()
+{
+    forever {
+        if (drain() == 0) {
+            if (stopping.loadAcquire())
+                break;
+            QThread::msleep(10);
+        }
+    }
+}
+
+int IrcDebugSink::drain()
+{
+    int count = 0;
+    forever {
+        Entry& entry = entries[tail % capacity];
+        if (entry.sequence.loadAcquire() != tail + 1)
+            break;
+
+        // formatting the timestamp is the expensive part, so reuse it within the same second
+        if (entry.stamp / 1000 != second) {
+            second = entry.stamp / 1000;
+            timestamp = QDateTime::fromMSecsSinceEpoch(second * 1000).toString(Qt::ISODate).toUtf8();
+        }
+
+        QFile* out = file(entry.name);
+        if (out) {
+            QByteArray data = "[" + timestamp + " " + entry.name.toUtf8() + "] ";
+            data += irc_debug_marker(entry.level);
+            data += ' ';
+            data += entry.line.toUtf8();
+            data += '\n';
+            out->write(data);
+        }
+        entry.name.clear();
+        entry.line.clear();
+        entry.sequence.storeRelease(tail + capacity);
+        ++tail;
+        ++count;
+    }
+
+    const int lost = dropped.fetchAndStoreRelaxed(0);
+    if (lost > 0) {
+        QFile* out = file(QString());
+        if (out)
+            out->write("[" + timestamp + "] !! " + QByteArray::number(lost) + " lines dropped\n");
+    }
+
+    if (count > 0 || lost > 0) {
+        foreach (QFile* out, files)
+            out->flush();
+        written.storeRelease(tail);
+    }
+    return count;
+}
+
+QFile* IrcDebugSink::file(const QString& name)
+{
+    // "%1" in the file name routes each connection to its own file
+    QString key;
+    if (pattern.contains(QLatin1String("%1"))) {
+        key = name.isEmpty() ? QStringLiteral("communi") : name;
+        for (int i = 0; i < key.length(); ++i) {
+            const QChar c = key.at(i);
+            if (!c.isLetterOrNumber() && c != QLatin1Char('.') && c != QLatin1Char('-') && c != QLatin1Char('_'))
+                key[i] = QLatin1Char('_');
+        }
+    }
+
+    QFile* out = files.value(key);
+    if (!out) {
+        out = new QFile(key.isEmpty() ? pattern : QString(pattern).arg(key));
+        if (!out->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+            qWarning("IrcDebug: cannot open %s: %s", qPrintable(out->fileName()), qPrintable(out->errorString()));
+            delete out;
+            out = nullptr;
+        }
+        files.insert(key, out);
+    }
+    return out;
+}
+
+struct IrcDebugConfig
+{
+    IrcDebugConfig() : sink(nullptr) { }
+    ~IrcDebugConfig() { delete sink; }
+
+    void init();
+    bool matches(const QString& name) const;
+
+    QMutex mutex;
+    QAtomicInt initialized;
+    QString filter;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    QRegularExpression regexp;
+#else
+    QRegExp regexp;
+#endif
+    IrcDebugSink* sink;
+};
+
+Q_GLOBAL_STATIC(IrcDebugConfig, irc_debug_config)
+
+static void irc_debug_shutdown()
+{
+    IrcDebugConfig* config = irc_debug_config();
+    if (config && config->sink)
+        config->sink->stop();
+}
+
+void IrcDebugConfig::init()
+{
+    if (initialized.loadAcquire())
+        return;
+
+    QMutexLocker locker(&mutex);
+    if (IrcPrivate::loadRelaxed(initialized))
+        return;
+
+    int level = IrcDebug::None;
+
+    QByteArray lenv = qgetenv("IRC_DEBUG_LEVEL").toLower();
+    if (!lenv.isEmpty()) {
+        bool ok = false;
+        int number = lenv.toInt(&ok);
+        if (ok) {
+            level = number;
+        } else if (lenv == "none") {
+            level = IrcDebug::None;
+        } else if (lenv == "error") {
+            level = IrcDebug::Error;
+        } else if (lenv == "status") {
+            level = IrcDebug::Status;
+        } else if (lenv == "write") {
+            level = IrcDebug::Write;
+        } else if (lenv == "read") {
+            level = IrcDebug::Read;
+        } else {
+            qWarning("Unknown IRC_DEBUG_LEVEL value '%s'", lenv.data());
+            qWarning("Available values: 0-4, none, error, status, write, read.");
+        }
+    }
+
+    QByteArray denv = qgetenv("IRC_DEBUG");
+    if (!denv.isEmpty()) {
+        bool ok = false;
+        int number = denv.toInt(&ok);
+        if (ok) {
+            if (number == 0)
+                level = IrcDebug::None;
+            else if (lenv.isEmpty())
+                level = IrcDebug::Read;
+        }
+    }
+
+    filter = QString::fromUtf8(qgetenv("IRC_DEBUG_NAME"));
+    if (!filter.isEmpty()) {
+        if (lenv.isEmpty() && denv.isEmpty())
+            level = IrcDebug::Read;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+        regexp = QRegularExpression(QRegularExpression::wildcardToRegularExpression(filter),
+                                    QRegularExpression::CaseInsensitiveOption);
+#else
+        regexp = QRegExp(filter, Qt::CaseInsensitive, QRegExp::Wildcard);
+#endif
+    }
+
+    const QString file = QString::fromLocal8Bit(qgetenv("IRC_DEBUG_FILE"));
+    if (!file.isEmpty()) {
+        if (lenv.isEmpty() && denv.isEmpty() && filter.isEmpty())
+            level = IrcDebug::Read;
+        if (level > IrcDebug::None) {
+            sink = new IrcDebugSink(file, 16 * 1024);
+            sink->start(QThread::LowPriority);
+            qAddPostRoutine(irc_debug_shutdown);
+        }
+    }
+
+    IrcPrivate::storeRelaxed(IrcDebug::maxLevel, level);
+    initialized.storeRelease(1);
+}
+
+bool IrcDebugConfig::matches(const QString& name) const
+{
+    if (filter.isEmpty())
+        return true;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    return regexp.match(name).hasMatch();
+#else
+    return regexp.exactMatch(name);
+#endif
+}
+
+IrcDebug::IrcDebug(IrcConnection* c, Level l) : level(l), enabled(false), stamp(0)
+#ifndef QT_NO_DEBUG_STREAM
+  , debug(&str)
+#endif // QT_NO_DEBUG_STREAM
+{
+#ifndef QT_NO_DEBUG_STREAM
+    IrcDebugConfig* config = irc_debug_config();
+    config->init();
+    if (l > IrcPrivate::loadRelaxed(maxLevel))
+        return;
+
+    name = c->displayName();
+    enabled = config->matches(name);
+    if (enabled) {
+        if (config->sink) {
+            // the sink formats the prefix in the writer thread
+            stamp = QDateTime::currentMSecsSinceEpoch();
+        } else {
+            const QString time = QDateTime::currentDateTime().toString(Qt::ISODate);
+            debug << qPrintable("[" + time + " " + name + "]");
+            debug << irc_debug_marker(l);
+        }
+    }
+#else
+    Q_UNUSED(c);
+#endif // QT_NO_DEBUG_STREAM
+}
+
+IrcDebug::~IrcDebug()
+{
+#ifndef QT_NO_DEBUG_STREAM
+    if (enabled) {
+        IrcDebugSink* sink = irc_debug_config()->sink;
+        if (sink)
+            sink->post(stamp, level, name, str.trimmed());
+        else
+            qDebug() << qPrintable(str);
+    }
+#endif // QT_NO_DEBUG_STREAM
+}
+
+/*
+    Blocks until the asynchronous sink has written the lines posted so far.
+ */
+void IrcDebug::flush()
+{
+    IrcDebugConfig* config = irc_debug_config();
+    if (config->sink)
+        config->sink->flush();
+}
+#endif // IRC_DOXYGEN
+
+IRC_END_NAMESPACE
@@ -34,6 +34,7 @@
 #include "ircnetwork_p.h"
 #include "irccommand.h"
 #include "irccore_p.h"
+#include "irctrace_p.h"
 #include "irc.h"
 #include <QMetaEnum>
 #include <QVariant>
@@ -623,7 +624,7 @@ void IrcMessage::setTimeStamp(const QDateTime& timeStamp)
 QByteArray IrcMessage::encoding() const
 {
     Q_D(const IrcMessage);
-    return d->encoding;
+    return d->body->encoding;
 }
 
 void IrcMessage::setEncoding(const QByteArray& encoding)
@@ -633,7 +634,7 @@ void IrcMessage::setEncoding(const QByteArray& encoding)
         qWarning() << "IrcMessage::setEncoding(): unsupported encoding" << encoding;
         return;
     }
-    d->encoding = encoding;
+    d->body->encoding = encoding;
     d->invalidate();
 }
 
@@ -693,10 +694,11 @@ void IrcMessage::setTag(const QString& name, const QVariant& value)
  */
 IrcMessage* IrcMessage::fromData(const QByteArray& data, IrcConnection* connection)
 {
+    IRC_TRACE_SCOPE("core", "fromData");
     IrcMessageData md = IrcMessageData::fromData(data);
     IrcMessage* message = irc_create_message(md.command, connection);
     Q_ASSERT(message);
-    message->d_ptr->data = md;
+    message->d_ptr->body->data = md;
     QByteArray tag = md.tags.value("time");
     if (!tag.isEmpty()) {
         QDateTime ts = QDateTime::fromString(QString::fromUtf8(tag), Qt::ISODate);
@@ -723,6 +725,13 @@ IrcMessage* IrcMessage::fromParameters(const QString& prefix, const QString& com
     \since 3.5
 
     Clones the message.
+
+    The clone is cheap: the raw data and the decoded content of the message
+    are implicitly shared between the message and its clones. A message
+    makes its own copy of the shared content only when it is modified, for
+    example via setPrefix(), setParameters() or setEncoding().
+
+    Batch messages clone their batch contents the same way.
  */
 IrcMessage* IrcMessage::clone(QObject* parent) const
 {
@@ -732,18 +741,11 @@ IrcMessage* IrcMessage::clone(QObject* parent) const
         msg->setParent(parent);
         IrcMessagePrivate* p = IrcMessagePrivate::get(msg);
         p->timeStamp = d->timeStamp;
-        p->encoding = d->encoding;
         p->flags = d->flags;
-        p->data = d->data;
+        d->decodeAll();
+        p->body = d->body;
         foreach (IrcMessage* bm, d->batch)
             p->batch += bm->clone(msg);
-        p->m_nick = d->m_nick;
-        p->m_ident = d->m_ident;
-        p->m_host = d->m_host;
-        p->m_prefix = d->m_prefix;
-        p->m_command = d->m_command;
-        p->m_params = d->m_params;
-        p->m_tags = d->m_tags;
     }
     return msg;
 }
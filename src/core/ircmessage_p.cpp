@@ -28,79 +28,103 @@
 
 #include "ircmessage_p.h"
 #include "ircmessagedecoder_p.h"
+#include "ircconnectionstatistics_p.h"
+#include "ircmemory_p.h"
+#include "irctrace_p.h"
+#include "ircconnection.h"
 
 IRC_BEGIN_NAMESPACE
 
 #ifndef IRC_DOXYGEN
+static IrcConnectionStatisticsPrivate* irc_statistics(IrcConnection* connection)
+{
+    return connection ? IrcConnectionStatisticsPrivate::get(connection->statistics()) : nullptr;
+}
+
 IrcMessagePrivate::IrcMessagePrivate() :
-     timeStamp(QDateTime::currentDateTime()), encoding("ISO-8859-15")
+     timeStamp(QDateTime::currentDateTime()), body(new IrcMessageBody)
 {
 }
 
 QString IrcMessagePrivate::prefix() const
 {
-    if (!m_prefix.isExplicit() && m_prefix.isNull() && !data.prefix.isNull()) {
-        if (data.prefix.startsWith(':')) {
-            if (data.prefix.length() > 1)
-                m_prefix = decode(data.prefix.mid(1), encoding);
+    if (!body->m_prefix.isExplicit() && body->m_prefix.isNull() && !body->data.prefix.isNull()) {
+        if (body->data.prefix.startsWith(':')) {
+            if (body->data.prefix.length() > 1) {
+                IrcStatisticsTimer timer(irc_statistics(connection), IrcConnectionStatistics::DecodeTime);
+                IRC_TRACE_SCOPE("core", "decode");
+                body->m_prefix = decode(body->data.prefix.mid(1), body->encoding);
+            }
         } else {
             // empty (not null)
-            m_prefix = QString("");
+            body->m_prefix = QString("");
         }
     }
-    return m_prefix.value();
+    return body->m_prefix.value();
 }
 
 void IrcMessagePrivate::setPrefix(const QString& prefix)
 {
-    m_prefix.setValue(prefix);
-    m_nick.clear();
-    m_ident.clear();
-    m_host.clear();
+    body->m_prefix.setValue(prefix);
+    body->m_nick.clear();
+    body->m_ident.clear();
+    body->m_host.clear();
+    body->m_parsed = false;
+}
+
+void IrcMessagePrivate::parseNickIdentHost() const
+{
+    // ident and host stay null for server prefixes, so remember that the prefix was parsed
+    if (!body->m_parsed) {
+        parsePrefix(prefix(), &body->m_nick, &body->m_ident, &body->m_host);
+        body->m_parsed = true;
+    }
 }
 
 QString IrcMessagePrivate::nick() const
 {
-    if (m_nick.isNull())
-        parsePrefix(prefix(), &m_nick, &m_ident, &m_host);
-    return m_nick;
+    parseNickIdentHost();
+    return body->m_nick;
 }
 
 QString IrcMessagePrivate::ident() const
 {
-    if (m_ident.isNull())
-        parsePrefix(prefix(), &m_nick, &m_ident, &m_host);
-    return m_ident;
+    parseNickIdentHost();
+    return body->m_ident;
 }
 
 QString IrcMessagePrivate::host() const
 {
-    if (m_host.isNull())
-        parsePrefix(prefix(), &m_nick, &m_ident, &m_host);
-    return m_host;
+    parseNickIdentHost();
+    return body->m_host;
 }
 
 QString IrcMessagePrivate::command() const
 {
-    if (!m_command.isExplicit() && m_command.isNull() && !data.command.isNull())
-        m_command = decode(data.command, encoding);
-    return m_command.value();
+    if (!body->m_command.isExplicit() && body->m_command.isNull() && !body->data.command.isNull()) {
+        IrcStatisticsTimer timer(irc_statistics(connection), IrcConnectionStatistics::DecodeTime);
+        IRC_TRACE_SCOPE("core", "decode");
+        body->m_command = decode(body->data.command, body->encoding);
+    }
+    return body->m_command.value();
 }
 
 void IrcMessagePrivate::setCommand(const QString& command)
 {
-    m_command.setValue(command);
+    body->m_command.setValue(command);
 }
 
 QStringList IrcMessagePrivate::params() const
 {
-    if (!m_params.isExplicit() && m_params.isNull() && !data.params.isEmpty()) {
+    if (!body->m_params.isExplicit() && body->m_params.isNull() && !body->data.params.isEmpty()) {
+        IrcStatisticsTimer timer(irc_statistics(connection), IrcConnectionStatistics::DecodeTime);
+        IRC_TRACE_SCOPE("core", "decode");
         QStringList params;
-        foreach (const QByteArray& param, data.params)
-            params += decode(param, encoding);
-        m_params = params;
+        foreach (const QByteArray& param, body->data.params)
+            params += decode(param, body->encoding);
+        body->m_params = params;
     }
-    return m_params.value();
+    return body->m_params.value();
 }
 
 QString IrcMessagePrivate::param(int index) const
@@ -110,29 +134,31 @@ QString IrcMessagePrivate::param(int index) const
 
 void IrcMessagePrivate::setParams(const QStringList& params)
 {
-    m_params.setValue(params);
+    body->m_params.setValue(params);
 }
 
 QVariantMap IrcMessagePrivate::tags() const
 {
-    if (!m_tags.isExplicit() && m_tags.isNull() && !data.tags.isEmpty()) {
+    if (!body->m_tags.isExplicit() && body->m_tags.isNull() && !body->data.tags.isEmpty()) {
+        IrcStatisticsTimer timer(irc_statistics(connection), IrcConnectionStatistics::DecodeTime);
+        IRC_TRACE_SCOPE("core", "decode");
         QVariantMap tags;
         QMap<QByteArray, QByteArray>::const_iterator it;
-        for (it = data.tags.constBegin(); it != data.tags.constEnd(); ++it)
-            tags.insert(decode(it.key(), encoding), decode(it.value(), encoding));
-        m_tags = tags;
+        for (it = body->data.tags.constBegin(); it != body->data.tags.constEnd(); ++it)
+            tags.insert(decode(it.key(), body->encoding), decode(it.value(), body->encoding));
+        body->m_tags = tags;
     }
-    return m_tags.value();
+    return body->m_tags.value();
 }
 
 void IrcMessagePrivate::setTags(const QVariantMap& tags)
 {
-    m_tags.setValue(tags);
+    body->m_tags.setValue(tags);
 }
 
 QByteArray IrcMessagePrivate::content() const
 {
-    if (m_prefix.isExplicit() || m_command.isExplicit() || m_params.isExplicit() || m_tags.isExplicit()) {
+    if (body->m_prefix.isExplicit() || body->m_command.isExplicit() || body->m_params.isExplicit() || body->m_tags.isExplicit()) {
         QByteArray data;
 
         // format <tags>
@@ -161,19 +187,44 @@ QByteArray IrcMessagePrivate::content() const
         return data;
     }
 
-    return data.content;
+    return body->data.content;
+}
+
+void IrcMessagePrivate::decodeAll() const
+{
+    // fills the caches up front, so that clones sharing the body only read it
+    parseNickIdentHost();
+    command();
+    params();
+    tags();
 }
 
 void IrcMessagePrivate::invalidate()
 {
-    m_nick.clear();
-    m_ident.clear();
-    m_host.clear();
-
-    m_prefix.clear();
-    m_command.clear();
-    m_params.clear();
-    m_tags.clear();
+    body->m_nick.clear();
+    body->m_ident.clear();
+    body->m_host.clear();
+    body->m_parsed = false;
+
+    body->m_prefix.clear();
+    body->m_command.clear();
+    body->m_params.clear();
+    body->m_tags.clear();
+}
+
+qint64 IrcMessagePrivate::memoryUsage() const
+{
+    qint64 bytes = IrcMemory::ObjectSize + sizeof(IrcMessagePrivate) + sizeof(IrcMessageBody);
+    bytes += IrcMemory::of(body->encoding);
+    bytes += IrcMemory::of(body->data.content) + IrcMemory::of(body->data.prefix) + IrcMemory::of(body->data.command);
+    bytes += IrcMemory::of(body->data.params) + IrcMemory::of(body->data.tags);
+    bytes += IrcMemory::of(body->m_nick) + IrcMemory::of(body->m_ident) + IrcMemory::of(body->m_host);
+    bytes += IrcMemory::of(body->m_prefix.value()) + IrcMemory::of(body->m_command.value());
+    bytes += IrcMemory::of(body->m_params.value()) + IrcMemory::of(body->m_tags.value());
+    bytes += IrcMemory::of(batch);
+    foreach (IrcMessage* message, batch)
+        bytes += IrcMessagePrivate::get(message)->memoryUsage();
+    return bytes;
 }
 
 IrcMessageData IrcMessageData::fromData(const QByteArray& data)
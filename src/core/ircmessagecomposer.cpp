@@ -28,7 +28,10 @@
 
 #include "ircmessagecomposer_p.h"
 #include "ircmessage.h"
+#include "ircmessage_p.h"
+#include "ircmemory_p.h"
 #include "irccore_p.h"
+#include "irctrace_p.h"
 #include "irc.h"
 
 IRC_BEGIN_NAMESPACE
@@ -75,6 +78,7 @@ bool IrcMessageComposer::isComposed(int code)
 
 void IrcMessageComposer::composeMessage(IrcNumericMessage* message)
 {
+    IRC_TRACE_SCOPE("core", "compose");
     switch (message->code()) {
     case Irc::RPL_MOTDSTART:
         d.messages.push(new IrcMotdMessage(d.connection));
@@ -233,6 +237,14 @@ void IrcMessageComposer::composeMessage(IrcNumericMessage* message)
     }
 }
 
+qint64 IrcMessageComposer::memoryUsage() const
+{
+    qint64 bytes = IrcMemory::ObjectSize + d.messages.capacity() * qint64(sizeof(IrcMessage*));
+    foreach (IrcMessage* message, d.messages)
+        bytes += IrcMessagePrivate::get(message)->memoryUsage();
+    return bytes;
+}
+
 void IrcMessageComposer::finishCompose(IrcMessage* message)
 {
     if (!d.messages.isEmpty()) {
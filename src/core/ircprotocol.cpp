@@ -28,14 +28,20 @@
 
 #include "ircprotocol.h"
 #include "ircconnection_p.h"
+#include "ircconnectionstatistics_p.h"
+#include "irctrace_p.h"
+#include "irctraffic_p.h"
 #include "ircmessagecomposer_p.h"
 #include "ircnetwork_p.h"
 #include "ircconnection.h"
 #include "ircmessage_p.h"
+#include "ircmemory_p.h"
 #include "irccommand.h"
 #include "ircdebug_p.h"
 #include "irccore_p.h"
 #include "irc.h"
+#include <QElapsedTimer>
+#include <QTimer>
 #include <QDebug>
 
 IRC_BEGIN_NAMESPACE
@@ -55,6 +61,9 @@ IRC_BEGIN_NAMESPACE
  */
 
 #ifndef IRC_DOXYGEN
+static const int IRC_READ_BUFFER_SIZE = 4096;
+static const int IRC_READ_BUFFER_LIMIT = 64 * 1024; // released once drained
+
 class IrcProtocolPrivate
 {
     Q_DECLARE_PUBLIC(IrcProtocol)
@@ -63,9 +72,15 @@ public:
     IrcProtocolPrivate();
 
     void authenticate(bool secure);
+    void sendRegistration();
+    bool pipelineHandshake();
+    QString serverKey() const;
+    QSet<QString> capabilitiesToRequest(const QSet<QString>& availableCaps) const;
+    void requestCapabilities(const QSet<QString>& availableCaps);
 
-    void readLines(const QByteArray& delimiter);
+    void readSocket();
     void processLine(const QByteArray& line);
+    void answerPings();
 
     bool batchMessage(IrcMessage* msg);
     bool handleBatchMessage(IrcBatchMessage* msg);
@@ -76,16 +91,24 @@ public:
 
     void _irc_pauseHandshake();
     void _irc_resumeHandshake();
+    void _irc_readLines();
 
     IrcProtocol* q_ptr = nullptr;
     IrcConnection* connection = nullptr;
     IrcMessageComposer* composer = nullptr;
+    IrcConnectionStatisticsPrivate* statistics = nullptr;
     QHash<QString, IrcBatchMessage*> batches;
     QHash<QString, QString> info;
     QByteArray buffer;
+    int offset = 0;
+    int scanned = 0;
+    int pongs = 0;
+    bool yielded = false;
+    bool throttled = false;
     int currentNick = -1;
     bool resumed = false;
     bool authed = false;
+    bool pipelined = false;
     bool motd = false;
 };
 
@@ -107,32 +130,152 @@ void IrcProtocolPrivate::authenticate(bool secure)
     }
 }
 
-void IrcProtocolPrivate::readLines(const QByteArray& delimiter)
+void IrcProtocolPrivate::sendRegistration()
 {
-    int i = -1;
-    while ((i = buffer.indexOf(delimiter)) != -1) {
-        QByteArray line = buffer.left(i).trimmed();
-        buffer = buffer.mid(i + delimiter.length());
-        if (!line.isEmpty())
-            processLine(line);
+    QString nick = connection->nickName();
+    if (nick.isEmpty())
+        nick = connection->nickNames().value(0);
+
+    connection->sendRaw(QString("NICK %1").arg(nick));
+    connection->sendRaw(QString("USER %1 hostname servername :%2").arg(connection->userName(), connection->realName()));
+}
+
+bool IrcProtocolPrivate::pipelineHandshake()
+{
+    if (!connection->isOptimisticHandshakeEnabled() || connection->network()->skipCapabilityValidation())
+        return false;
+
+    const QStringList cachedCaps = IrcConnectionPrivate::get(connection)->capabilityCache.value(serverKey());
+    if (cachedCaps.isEmpty())
+        return false;
+
+    // assume that the server still advertises the same capabilities as
+    // last time, and send the whole handshake without waiting for replies
+    QMetaObject::invokeMethod(connection->network(), "requestingCapabilities");
+    const QSet<QString> requestedCaps = capabilitiesToRequest(IrcPrivate::listToSet(cachedCaps));
+    const bool sasl = requestedCaps.contains(QLatin1String("sasl")) && !connection->password().isEmpty();
+
+    pipelined = true;
+    resumed = false;
+    authed = false;
+
+    connection->sendData("CAP LS 302");
+    if (!requestedCaps.isEmpty())
+        connection->sendRaw("CAP REQ :" + QStringList(IrcPrivate::setToList(requestedCaps)).join(" "));
+    if (sasl) {
+        connection->sendRaw("AUTHENTICATE " + connection->saslMechanism());
+        authenticate(true);
+    } else {
+        authenticate(false);
+    }
+    sendRegistration();
+
+    // with SASL, CAP END waits for the ACK so that a NAK can still fall back
+    if (!sasl) {
+        connection->sendData("CAP END");
+        resumed = true;
+    }
+    return true;
+}
+
+QString IrcProtocolPrivate::serverKey() const
+{
+    return QString("%1 %2").arg(connection->host()).arg(connection->port());
+}
+
+QSet<QString> IrcProtocolPrivate::capabilitiesToRequest(const QSet<QString>& availableCaps) const
+{
+    QSet<QString> requestedCaps;
+    QSet<QString> activeCaps = IrcPrivate::listToSet(connection->network()->activeCapabilities());
+    foreach (const QString& cap, connection->network()->requestedCapabilities()) {
+        if (availableCaps.contains(cap) && !activeCaps.contains(cap))
+            requestedCaps += cap;
     }
+    if (!connection->saslMechanism().isEmpty()) {
+        foreach (const QString& cap, availableCaps) {
+            QStringList capParts = cap.split('=');
+            if (capParts.length() == 2) {
+                QString capName = capParts[0];
+                if (capName.compare(QLatin1String("sasl"), Qt::CaseInsensitive) == 0) {
+                    // The server has advertised supporting SASL with a list of supported SASL Mechanisms, ensure our supported SASL Mechanism is part of that list before accepting the SASL capability
+                    QStringList serverSaslMethods = capParts[1].split(',');
+                    if (serverSaslMethods.contains(connection->saslMechanism())) {
+                        requestedCaps += QLatin1String("sasl");
+                    }
+                }
+            } else if (cap.compare(QLatin1String("sasl"), Qt::CaseInsensitive) == 0) {
+                requestedCaps += QLatin1String("sasl");
+            }
+        }
+    }
+    return requestedCaps;
+}
+
+void IrcProtocolPrivate::requestCapabilities(const QSet<QString>& availableCaps)
+{
+    Q_Q(IrcProtocol);
+    const QSet<QString> requestedCaps = capabilitiesToRequest(availableCaps);
+    if (!requestedCaps.isEmpty())
+        connection->sendRaw("CAP REQ :" + QStringList(IrcPrivate::setToList(requestedCaps)).join(" "));
+    else
+        QMetaObject::invokeMethod(q, "_irc_resumeHandshake", Qt::QueuedConnection);
+}
+
+void IrcProtocolPrivate::readSocket()
+{
+    Q_Q(IrcProtocol);
+    QAbstractSocket* socket = q->socket();
+    qint64 bytes = socket->bytesAvailable();
+    const int watermark = connection->readHighWatermark();
+    if (watermark > 0) {
+        qint64 room = watermark - (buffer.size() - offset);
+        // a single line longer than the watermark must not stall reading
+        if (room <= 0 && buffer.indexOf('\n', offset) == -1)
+            room = watermark;
+        bytes = qMin(bytes, room);
+    }
+
+    if (bytes > 0) {
+        // read directly into the spare capacity of the buffer, which
+        // grows geometrically and is kept around between the reads
+        const int size = buffer.size();
+        if (size + bytes > buffer.capacity())
+            buffer.reserve(qMax<qint64>(qMax<qint64>(buffer.capacity() * 2, IRC_READ_BUFFER_SIZE), size + bytes));
+        buffer.resize(size + bytes);
+        const qint64 received = qMax<qint64>(0, socket->read(buffer.data() + size, bytes));
+        buffer.resize(size + received);
+        IrcTrafficRecorder* recorder = IrcConnectionPrivate::get(connection)->recorder;
+        if (recorder)
+            IrcTrafficRecorderPrivate::get(recorder)->record(buffer.constData() + size, received);
+        statistics->add(statistics->bytesReceived, received);
+        IrcPrivate::storeRelaxed(statistics->bufferedBytes, buffer.size() - offset);
+    }
+
+    // the rest is left in the socket until the buffer has been drained
+    throttled = watermark > 0 && socket->bytesAvailable() > 0;
 }
 
 void IrcProtocolPrivate::processLine(const QByteArray& line)
 {
     Q_Q(IrcProtocol);
     ircDebug(connection, IrcDebug::Read) << line;
+    statistics->add(statistics->linesReceived);
 
     if (line.startsWith("AUTHENTICATE") && !connection->saslMechanism().isEmpty()) {
         const QList<QByteArray> args = line.split(' ');
-        if (args.count() == 2 && args.at(1) == "+")
+        // the credentials of an optimistic handshake have already been sent
+        if (args.count() == 2 && args.at(1) == "+" && !pipelined)
             authenticate(true);
         if (!connection->isConnected())
             QMetaObject::invokeMethod(q, "_irc_resumeHandshake", Qt::QueuedConnection);
         return;
     }
 
-    IrcMessage* msg = IrcMessage::fromData(line, connection);
+    IrcMessage* msg = nullptr;
+    {
+        IrcStatisticsTimer timer(statistics, IrcConnectionStatistics::ParseTime);
+        msg = IrcMessage::fromData(line, connection);
+    }
     if (msg) {
         msg->setEncoding(connection->encoding());
 
@@ -155,7 +298,11 @@ void IrcProtocolPrivate::processLine(const QByteArray& line)
             handleNumericMessage(static_cast<IrcNumericMessage*>(msg));
             break;
         case IrcMessage::Ping:
-            connection->sendRaw("PONG " + static_cast<IrcPingMessage*>(msg)->argument());
+            // a bare PING in a backlog has already been answered by answerPings()
+            if (pongs > 0 && line.startsWith("PING "))
+                --pongs;
+            else
+                connection->sendRaw("PONG " + static_cast<IrcPingMessage*>(msg)->argument());
             break;
         case IrcMessage::Private:
             handlePrivateMessage(static_cast<IrcPrivateMessage*>(msg));
@@ -205,6 +352,8 @@ void IrcProtocolPrivate::handleNumericMessage(IrcNumericMessage* msg)
     switch (msg->code()) {
     case Irc::RPL_WELCOME:
         motd = false;
+        // the optimistic handshake is over, later NAKs are for runtime requests
+        pipelined = false;
         q->setNickName(msg->parameters().value(0));
         q->setStatus(IrcConnection::Connected);
         break;
@@ -297,45 +446,27 @@ void IrcProtocolPrivate::handleCapabilityMessage(IrcCapabilityMessage* msg)
         q->setAvailableCapabilities(availableCaps);
 
         if (!connected && msg->parameter(2) != "*") {
-            QMetaObject::invokeMethod(connection->network(), "requestingCapabilities");
-            QSet<QString> requestedCaps;
-            QSet<QString> activeCaps = IrcPrivate::listToSet(connection->network()->activeCapabilities());
-            foreach (const QString& cap, connection->network()->requestedCapabilities()) {
-                if (availableCaps.contains(cap) && !activeCaps.contains(cap))
-                    requestedCaps += cap;
-            }
-            const QStringList params = msg->parameters();
-            if (params.value(params.count() - 1) != QLatin1String("*")) {
-                if (!connection->saslMechanism().isEmpty()) {
-                    foreach (const QString& cap, availableCaps) {
-                        QStringList capParts = cap.split('=');
-                        if (capParts.length() == 2) {
-                            QString capName = capParts[0];
-                            if (capName.compare(QLatin1String("sasl"), Qt::CaseInsensitive) == 0) {
-                                // The server has advertised supporting SASL with a list of supported SASL Mechanisms, ensure our supported SASL Mechanism is part of that list before accepting the SASL capability
-                                QStringList serverSaslMethods = capParts[1].split(',');
-                                if (serverSaslMethods.contains(connection->saslMechanism())) {
-                                    requestedCaps += QLatin1String("sasl");
-                                }
-                            }
-                        } else if (cap.compare(QLatin1String("sasl"), Qt::CaseInsensitive) == 0) {
-                            requestedCaps += QLatin1String("sasl");
-                        }
-                    }
-                }
+            // remembered for the optimistic handshake of the next connect
+            IrcConnectionPrivate::get(connection)->capabilityCache.insert(serverKey(), IrcPrivate::setToList(availableCaps));
+            // an optimistic handshake has already requested the capabilities
+            if (!pipelined) {
+                QMetaObject::invokeMethod(connection->network(), "requestingCapabilities");
+                requestCapabilities(availableCaps);
             }
-            if (!requestedCaps.isEmpty())
-                connection->sendRaw("CAP REQ :" + QStringList(IrcPrivate::setToList(requestedCaps)).join(" "));
-            else
-                QMetaObject::invokeMethod(q, "_irc_resumeHandshake", Qt::QueuedConnection);
         }
+    } else if (subCommand == "NAK" && pipelined && !connected) {
+        // the cached capabilities were stale; fall back to requesting
+        // the capabilities that the server advertised this time
+        pipelined = false;
+        authed = false;
+        requestCapabilities(IrcPrivate::listToSet(connection->network()->availableCapabilities()));
     } else if (subCommand == "ACK" || subCommand == "NAK") {
         bool auth = false;
         if (subCommand == "ACK") {
             QSet<QString> activeCaps = IrcPrivate::listToSet(connection->network()->activeCapabilities());
             foreach (const QString& cap, msg->capabilities()) {
                 handleCapability(&activeCaps, cap);
-                if (cap == "sasl" && !connection->saslMechanism().isEmpty() && !connection->password().isEmpty())
+                if (cap == "sasl" && !pipelined && !connection->saslMechanism().isEmpty() && !connection->password().isEmpty())
                     auth = connection->sendRaw("AUTHENTICATE " + connection->saslMechanism());
             }
             q->setActiveCapabilities(activeCaps);
@@ -369,6 +500,91 @@ void IrcProtocolPrivate::handleCapabilityMessage(IrcCapabilityMessage* msg)
     }
 }
 
+void IrcProtocolPrivate::answerPings()
+{
+    // answer bare PINGs queued behind a backlog of unprocessed lines right
+    // away, so that the server does not time out while the backlog is being
+    // processed. the PING messages themselves are still delivered in order.
+    int i = -1;
+    int from = qMax(scanned, offset);
+    while ((i = buffer.indexOf('\n', from)) != -1) {
+        const char* data = buffer.constData() + from;
+        while (data < buffer.constData() + i && (*data == ' ' || *data == '\t' || *data == '\r'))
+            ++data;
+        if (qstrncmp(data, "PING ", 5) == 0) {
+            const QByteArray line = buffer.mid(from, i - from).trimmed();
+            if (line.startsWith("PING ")) {
+                connection->sendData("PONG" + line.mid(4));
+                ++pongs;
+            }
+        }
+        from = i + 1;
+    }
+    scanned = from;
+}
+
+void IrcProtocolPrivate::_irc_readLines()
+{
+    Q_Q(IrcProtocol);
+    IRC_TRACE_SCOPE("core", "readLines");
+    yielded = false;
+
+    const int lineLimit = connection->readLineLimit();
+    const qint64 timeLimit = connection->readTimeLimit() * 1000ll;
+    QElapsedTimer timer;
+    if (timeLimit > 0)
+        timer.start();
+
+    int lines = 0;
+    int i = -1;
+    // lines are terminated by CR-LF as specified in RFC 1459, but fall back to plain LF
+    while ((i = buffer.indexOf('\n', offset)) != -1) {
+        QByteArray line = buffer.mid(offset, i - offset).trimmed();
+        offset = i + 1;
+        if (!line.isEmpty()) {
+            processLine(line);
+            if ((lineLimit > 0 && ++lines >= lineLimit) || (timeLimit > 0 && timer.nsecsElapsed() >= timeLimit)) {
+                if (buffer.indexOf('\n', offset) != -1) {
+                    // yield to the event loop, and continue where left off
+                    yielded = true;
+                    QTimer::singleShot(0, q, SLOT(_irc_readLines()));
+                    answerPings();
+                    break;
+                }
+            }
+        }
+    }
+
+    // the remaining bytes are shifted to the front only once
+    // the bulk of the buffer has been processed
+    if (offset >= buffer.size()) {
+        // keep the capacity for the next read, unless a large burst blew it up
+        if (buffer.capacity() > IRC_READ_BUFFER_LIMIT)
+            buffer.clear();
+        else
+            buffer.resize(0);
+        offset = 0;
+        scanned = 0;
+    } else if (!yielded || offset > buffer.size() / 2) {
+        buffer.remove(0, offset);
+        scanned = qMax(0, scanned - offset);
+        offset = 0;
+    }
+
+    IrcPrivate::storeRelaxed(statistics->bufferedBytes, buffer.size() - offset);
+
+    // resume reading once the buffer has been drained below the low watermark
+    if (throttled && (!yielded || buffer.size() - offset <= connection->readLowWatermark())) {
+        readSocket();
+        if (yielded) {
+            answerPings();
+        } else {
+            yielded = true;
+            QTimer::singleShot(0, q, SLOT(_irc_readLines()));
+        }
+    }
+}
+
 void IrcProtocolPrivate::_irc_pauseHandshake()
 {
     if (connection->network()->skipCapabilityValidation()) {
@@ -403,6 +619,7 @@ IrcProtocol::IrcProtocol(IrcConnection* connection) : QObject(connection), d_ptr
     d->q_ptr = this;
     d->connection = connection;
     d->composer = new IrcMessageComposer(connection);
+    d->statistics = IrcConnectionStatisticsPrivate::get(connection->statistics());
     connect(d->composer, SIGNAL(messageComposed(IrcMessage*)), this, SLOT(receiveMessage(IrcMessage*)));
 }
 
@@ -447,21 +664,30 @@ QAbstractSocket* IrcProtocol::socket() const
 
     Furthermore, it sends a <tt>CAP LS</tt> command as specified in
     <a href="http://tools.ietf.org/html/draft-mitchell-irc-capabilities-01">IRC Client Capabilities Extension</a>.
+
+    When the \ref IrcConnection::optimisticHandshakeEnabled "optimistic handshake"
+    is enabled and the capabilities of the server are known from a previous connect,
+    the capability requests, SASL authentication and <tt>CAP END</tt> are sent
+    right away, without waiting for the replies of the server.
  */
 void IrcProtocol::open()
 {
     Q_D(IrcProtocol);
+    d->buffer.clear();
+    d->offset = 0;
+    d->scanned = 0;
+    d->pongs = 0;
+    d->throttled = false;
+    d->pipelined = false;
+    if (d->pipelineHandshake())
+        return;
+
     d->_irc_pauseHandshake();
 
     if (d->connection->saslMechanism().isEmpty() && !d->connection->password().isEmpty())
         d->authenticate(false);
 
-    QString nick = d->connection->nickName();
-    if (nick.isEmpty())
-        nick = d->connection->nickNames().value(0);
-
-    d->connection->sendRaw(QString("NICK %1").arg(nick));
-    d->connection->sendRaw(QString("USER %1 hostname servername :%2").arg(d->connection->userName(), d->connection->realName()));
+    d->sendRegistration();
 }
 
 /*!
@@ -478,17 +704,22 @@ void IrcProtocol::close()
 
     The default implementation reads lines as specified in
     <a href="http://tools.ietf.org/html/rfc1459">RFC 1459</a>.
+    While a large burst is being processed in time slices, PINGs
+    queued behind the backlog are answered immediately.
 
-    \sa socket
+    \sa socket, IrcConnection::readLineLimit, IrcConnection::readTimeLimit, IrcConnection::readHighWatermark
  */
 void IrcProtocol::read()
 {
     Q_D(IrcProtocol);
-    d->buffer += socket()->readAll();
-    // try reading RFC compliant message lines first
-    d->readLines("\r\n");
-    // fall back to RFC incompliant lines...
-    d->readLines("\n");
+    IRC_TRACE_SCOPE("core", "read");
+    d->readSocket();
+    // a continuation is already pending if the previous
+    // burst exceeded IrcConnection::readLineLimit/readTimeLimit
+    if (!d->yielded)
+        d->_irc_readLines();
+    else
+        d->answerPings();
 }
 
 /*!
@@ -504,6 +735,41 @@ bool IrcProtocol::write(const QByteArray& data)
     return socket()->write(data + QByteArray("\r\n")) != -1;
 }
 
+/*!
+    \since 3.8
+
+    Returns the amount of received bytes that have been read from the
+    \ref socket, but have not been processed yet.
+
+    \sa IrcConnection::bufferedBytes
+ */
+int IrcProtocol::bufferedBytes() const
+{
+    Q_D(const IrcProtocol);
+    return d->buffer.size() - d->offset;
+}
+
+/*!
+    \since 3.8
+
+    Returns the approximate number of heap bytes held by the protocol:
+    the read buffer, the pending message batches, the messages being
+    composed and the server info.
+
+    \sa IrcConnection::memoryUsage()
+ */
+qint64 IrcProtocol::memoryUsage() const
+{
+    Q_D(const IrcProtocol);
+    qint64 bytes = IrcMemory::ObjectSize + sizeof(IrcProtocolPrivate);
+    bytes += IrcMemory::of(d->buffer) + IrcMemory::of(d->info) + IrcMemory::of(d->batches);
+    foreach (IrcBatchMessage* batch, d->batches)
+        bytes += IrcMessagePrivate::get(batch)->memoryUsage();
+    if (d->composer)
+        bytes += d->composer->memoryUsage();
+    return bytes;
+}
+
 /*!
     This method should be called by the protocol implementation
     to make the underlying IRC connection receive a \a message.
@@ -0,0 +1,325 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ircreconnectpolicy.h"
+#include <QElapsedTimer>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+#include <QRandomGenerator>
+#endif
+#include <QMutexLocker>
+#include <QMutex>
+#include <QHash>
+#include <algorithm>
+#include <limits>
+
+IRC_BEGIN_NAMESPACE
+
+/*!
+    \file ircreconnectpolicy.h
+    \brief \#include &lt;IrcReconnectPolicy&gt;
+ */
+
+/*!
+    \since 3.8
+    \class IrcReconnectPolicy ircreconnectpolicy.h IrcReconnectPolicy
+    \ingroup core
+    \brief Decides when and where to reconnect.
+
+    By default, IrcConnection reconnects after a fixed \ref IrcConnection::reconnectDelay
+    "delay", and cycles through its \ref IrcConnection::servers "servers" one by one.
+    When many connections lose their server at once, they all come back in lockstep.
+
+    IrcReconnectPolicy implements exponential backoff with full jitter: the delay
+    of each attempt is random between zero and an exponentially growing ceiling,
+    capped by \ref maximumDelay. In addition, the process-wide \ref globalRate
+    "reconnect rate" spaces out the reconnects of all connections in the process.
+
+    The policy also keeps track of the health of the servers it is told about.
+    The servers are tried in order of consecutive failures and connect latency,
+    and round-robin among equally healthy servers.
+
+    The same policy may be shared by several connections, also by connections
+    living in different threads, such as the ones in an IrcConnectionPool.
+    The methods of the policy are thread-safe.
+
+    The behavior can be customized by reimplementing the virtual methods.
+
+    \code
+    IrcReconnectPolicy* policy = new IrcReconnectPolicy(connection);
+    policy->setMaximumDelay(2 * 60 * 1000);
+    connection->setReconnectPolicy(policy);
+    \endcode
+
+    \sa IrcConnection::reconnectPolicy
+ */
+
+#ifndef IRC_DOXYGEN
+struct IrcServerHealth
+{
+    int failures = 0;
+    qint64 latency = -1;
+};
+
+class IrcReconnectPolicyPrivate
+{
+public:
+    // the policy may be shared by connections in different threads
+    mutable QMutex mutex;
+    int minimumDelay = 1000;
+    int maximumDelay = 5 * 60 * 1000;
+    QString lastServer;
+    QHash<QString, IrcServerHealth> health;
+};
+
+struct IrcReconnectLimiter
+{
+    IrcReconnectLimiter() { clock.start(); }
+
+    QMutex mutex;
+    QElapsedTimer clock;
+    qreal rate = 0;
+    qint64 next = 0;
+};
+
+Q_GLOBAL_STATIC(IrcReconnectLimiter, irc_reconnect_limiter)
+
+struct IrcServerHealthLessThan
+{
+    IrcServerHealthLessThan(const QHash<QString, IrcServerHealth>& health) : health(health) { }
+
+    bool operator()(const QString& s1, const QString& s2) const
+    {
+        const IrcServerHealth h1 = health.value(s1);
+        const IrcServerHealth h2 = health.value(s2);
+        if (h1.failures != h2.failures)
+            return h1.failures < h2.failures;
+        // servers with a known latency go first
+        if (h1.latency < 0 || h2.latency < 0)
+            return h1.latency >= 0 && h2.latency < 0;
+        return h1.latency < h2.latency;
+    }
+
+    const QHash<QString, IrcServerHealth>& health;
+};
+#endif // IRC_DOXYGEN
+
+/*!
+    Constructs a new reconnect policy with \a parent.
+ */
+IrcReconnectPolicy::IrcReconnectPolicy(QObject* parent) : QObject(parent), d_ptr(new IrcReconnectPolicyPrivate)
+{
+}
+
+/*!
+    Destructs the reconnect policy.
+ */
+IrcReconnectPolicy::~IrcReconnectPolicy()
+{
+}
+
+/*!
+    This property holds the ceiling of the first reconnect delay in milliseconds.
+
+    The ceiling doubles for each consecutive attempt.
+
+    The default value is \c 1000 milliseconds.
+
+    \par Access functions:
+    \li int <b>minimumDelay</b>() const
+    \li void <b>setMinimumDelay</b>(int msecs)
+ */
+int IrcReconnectPolicy::minimumDelay() const
+{
+    Q_D(const IrcReconnectPolicy);
+    QMutexLocker locker(&d->mutex);
+    return d->minimumDelay;
+}
+
+void IrcReconnectPolicy::setMinimumDelay(int msecs)
+{
+    Q_D(IrcReconnectPolicy);
+    QMutexLocker locker(&d->mutex);
+    d->minimumDelay = qMax(0, msecs);
+}
+
+/*!
+    This property holds the maximum reconnect delay in milliseconds.
+
+    The default value is \c 300000 milliseconds (5 minutes).
+
+    \par Access functions:
+    \li int <b>maximumDelay</b>() const
+    \li void <b>setMaximumDelay</b>(int msecs)
+ */
+int IrcReconnectPolicy::maximumDelay() const
+{
+    Q_D(const IrcReconnectPolicy);
+    QMutexLocker locker(&d->mutex);
+    return d->maximumDelay;
+}
+
+void IrcReconnectPolicy::setMaximumDelay(int msecs)
+{
+    Q_D(IrcReconnectPolicy);
+    QMutexLocker locker(&d->mutex);
+    d->maximumDelay = qMax(0, msecs);
+}
+
+/*!
+    Returns the number of consecutive failures of \a server.
+ */
+int IrcReconnectPolicy::failures(const QString& server) const
+{
+    Q_D(const IrcReconnectPolicy);
+    QMutexLocker locker(&d->mutex);
+    return d->health.value(server).failures;
+}
+
+/*!
+    Returns the average connect latency of \a server in milliseconds,
+    or \c -1 if the server has not been successfully connected to.
+ */
+qint64 IrcReconnectPolicy::latency(const QString& server) const
+{
+    Q_D(const IrcReconnectPolicy);
+    QMutexLocker locker(&d->mutex);
+    return d->health.value(server).latency;
+}
+
+/*!
+    This property holds the maximum number of reconnects per second in the whole process.
+
+    The limit is shared by all reconnect policies, in all threads. Reconnects
+    exceeding the rate are delayed, so that a network outage does not make all
+    connections reconnect at once.
+
+    The default value is \c 0 (unlimited).
+
+    \par Access functions:
+    \li static qreal <b>globalRate</b>()
+    \li static void <b>setGlobalRate</b>(qreal rate)
+ */
+qreal IrcReconnectPolicy::globalRate()
+{
+    IrcReconnectLimiter* limiter = irc_reconnect_limiter();
+    QMutexLocker locker(&limiter->mutex);
+    return limiter->rate;
+}
+
+void IrcReconnectPolicy::setGlobalRate(qreal rate)
+{
+    IrcReconnectLimiter* limiter = irc_reconnect_limiter();
+    QMutexLocker locker(&limiter->mutex);
+    limiter->rate = qMax<qreal>(0, rate);
+}
+
+/*!
+    Returns the delay in milliseconds before the reconnect \a attempt.
+
+    The \a attempt is \c 0 for the first reconnect after the connection
+    was lost, and grows until the connection has been re-established.
+    A negative value disables reconnecting.
+
+    The default implementation returns a random delay between zero and
+    \ref minimumDelay * 2<sup>attempt</sup>, capped by \ref maximumDelay,
+    and further delayed as necessary to honor the \ref globalRate.
+ */
+int IrcReconnectPolicy::reconnectDelay(int attempt)
+{
+    Q_D(IrcReconnectPolicy);
+    QMutexLocker policyLocker(&d->mutex);
+    const qint64 ceiling = qMin<qint64>(d->maximumDelay, qint64(d->minimumDelay) << qBound(0, attempt, 30));
+    policyLocker.unlock();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+    qint64 delay = QRandomGenerator::global()->bounded(int(ceiling) + 1);
+#else
+    // RAND_MAX may be as small as 32767, so scale instead of taking a modulo
+    qint64 delay = qint64(qrand()) * (ceiling + 1) / (qint64(RAND_MAX) + 1);
+#endif
+
+    // reserve the next free slot of the process-wide reconnect rate
+    IrcReconnectLimiter* limiter = irc_reconnect_limiter();
+    QMutexLocker locker(&limiter->mutex);
+    if (limiter->rate > 0) {
+        const qint64 now = limiter->clock.elapsed();
+        const qint64 slot = qMax(now + delay, limiter->next);
+        limiter->next = slot + qint64(1000 / limiter->rate);
+        delay = slot - now;
+    }
+    return int(qMin<qint64>(delay, std::numeric_limits<int>::max()));
+}
+
+/*!
+    Returns \a servers in the order they should be tried.
+
+    The default implementation orders the servers by the number of consecutive
+    failures, and then by the average connect latency. Equally healthy servers
+    are tried round-robin, starting after the one that was tried last.
+ */
+QStringList IrcReconnectPolicy::rankServers(const QStringList& servers)
+{
+    Q_D(IrcReconnectPolicy);
+    QMutexLocker locker(&d->mutex);
+    QStringList ranked;
+    const int last = servers.indexOf(d->lastServer);
+    for (int i = 1; i <= servers.count(); ++i)
+        ranked += servers.at((last + i) % servers.count());
+    std::stable_sort(ranked.begin(), ranked.end(), IrcServerHealthLessThan(d->health));
+    return ranked;
+}
+
+/*!
+    This method is called when a connection to \a server has been established.
+
+    The \a latency is the time in milliseconds it took to connect and register.
+ */
+void IrcReconnectPolicy::serverSucceeded(const QString& server, qint64 latency)
+{
+    Q_D(IrcReconnectPolicy);
+    QMutexLocker locker(&d->mutex);
+    IrcServerHealth& health = d->health[server];
+    health.failures = 0;
+    // exponentially weighted moving average
+    health.latency = health.latency < 0 ? latency : (3 * health.latency + latency) / 4;
+    d->lastServer = server;
+}
+
+/*!
+    This method is called when connecting to \a server has failed.
+ */
+void IrcReconnectPolicy::serverFailed(const QString& server)
+{
+    Q_D(IrcReconnectPolicy);
+    QMutexLocker locker(&d->mutex);
+    ++d->health[server].failures;
+    d->lastServer = server;
+}
+
+#include "moc_ircreconnectpolicy.cpp"
+
+IRC_END_NAMESPACE
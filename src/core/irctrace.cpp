@@ -0,0 +1,299 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "irctrace.h"
+#include "irctrace_p.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+#include <QMutexLocker>
+#include <QThread>
+#include <QMutex>
+#include <QFile>
+#include <QHash>
+
+IRC_BEGIN_NAMESPACE
+
+/*!
+    \file irctrace.h
+    \brief \#include &lt;IrcTrace&gt;
+ */
+
+/*!
+    \since 3.8
+    \class IrcTrace irctrace.h IrcTrace
+    \ingroup core
+    \brief Records trace events of the message processing stages.
+
+    Communi has tracepoints at the key stages of the message processing:
+    reading and framing lines, parsing and decoding messages, message
+    filters, the message composer, the buffer models and sending commands.
+
+    The tracepoints are compiled in only when Communi is configured with
+    <tt>-config tracing</tt>. Otherwise they compile to nothing, and
+    isSupported() returns \c false.
+
+    When enabled, each tracepoint records a complete event into a global
+    ring buffer, without taking locks. The recorded events can be exported
+    in the Chrome trace event format, which can be viewed in Perfetto
+    (https://ui.perfetto.dev) or in \c chrome://tracing.
+
+    \code
+    IrcTrace::setEnabled(true);
+    // ...
+    IrcTrace::save("communi.json");
+    \endcode
+ */
+
+#if defined(IRC_TRACE) && !defined(IRC_DOXYGEN)
+struct IrcTraceEvent
+{
+    QAtomicInteger<quint64> sequence;
+    const char* category = nullptr;
+    const char* name = nullptr;
+    qint64 start = 0;
+    qint64 duration = 0;
+    Qt::HANDLE thread = nullptr;
+};
+
+struct IrcTraceBuffer
+{
+    IrcTraceBuffer() { clock.start(); }
+    ~IrcTraceBuffer() { delete [] events; }
+
+    QMutex mutex;
+    QElapsedTimer clock;
+    QAtomicInt enabled;
+    QAtomicInteger<quint64> next;
+    IrcTraceEvent* events = nullptr;
+    int capacity = 64 * 1024;
+};
+
+Q_GLOBAL_STATIC(IrcTraceBuffer, irc_trace_buffer)
+
+IrcTraceScope::IrcTraceScope(const char* category, const char* name) : category(category), name(name), start(-1)
+{
+    IrcTraceBuffer* buffer = irc_trace_buffer();
+    if (buffer->enabled.loadAcquire())
+        start = buffer->clock.nsecsElapsed();
+}
+
+IrcTraceScope::~IrcTraceScope()
+{
+    if (start < 0)
+        return;
+
+    // claim the next slot of the ring buffer; the slot is marked busy
+    // while being written, so that a concurrent export can skip it
+    IrcTraceBuffer* buffer = irc_trace_buffer();
+    const quint64 index = buffer->next.fetchAndAddRelaxed(1);
+    IrcTraceEvent& event = buffer->events[index % buffer->capacity];
+    event.sequence.storeRelease(0);
+    event.category = category;
+    event.name = name;
+    event.start = start;
+    event.duration = buffer->clock.nsecsElapsed() - start;
+    event.thread = QThread::currentThreadId();
+    event.sequence.storeRelease(index + 1);
+}
+#endif // IRC_TRACE && !IRC_DOXYGEN
+
+/*!
+    Returns \c true if Communi was built with tracepoints.
+ */
+bool IrcTrace::isSupported()
+{
+#ifdef IRC_TRACE
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*!
+    Returns \c true if the tracepoints are recording.
+ */
+bool IrcTrace::isEnabled()
+{
+#ifdef IRC_TRACE
+    return irc_trace_buffer()->enabled.loadAcquire();
+#else
+    return false;
+#endif
+}
+
+/*!
+    Sets the tracepoints \a enabled.
+
+    The ring buffer is allocated when the tracepoints are enabled for the
+    first time. Disabling the tracepoints keeps the recorded events.
+ */
+void IrcTrace::setEnabled(bool enabled)
+{
+#ifdef IRC_TRACE
+    IrcTraceBuffer* buffer = irc_trace_buffer();
+    QMutexLocker locker(&buffer->mutex);
+    if (enabled && !buffer->events)
+        buffer->events = new IrcTraceEvent[buffer->capacity];
+    buffer->enabled.storeRelease(enabled);
+#else
+    if (enabled)
+        qWarning("IrcTrace::setEnabled(): Communi was built without tracing support");
+#endif
+}
+
+/*!
+    Returns the number of events the ring buffer holds.
+
+    When the ring buffer is full, the oldest events are overwritten.
+    The default capacity is \c 65536 events.
+ */
+int IrcTrace::capacity()
+{
+#ifdef IRC_TRACE
+    IrcTraceBuffer* buffer = irc_trace_buffer();
+    QMutexLocker locker(&buffer->mutex);
+    return buffer->capacity;
+#else
+    return 0;
+#endif
+}
+
+/*!
+    Sets the number of \a events the ring buffer holds.
+
+    The capacity can only be changed before the tracepoints have been enabled
+    for the first time, because the tracepoints write to the ring buffer
+    without locking.
+ */
+void IrcTrace::setCapacity(int events)
+{
+#ifdef IRC_TRACE
+    IrcTraceBuffer* buffer = irc_trace_buffer();
+    QMutexLocker locker(&buffer->mutex);
+    if (buffer->events) {
+        qWarning("IrcTrace::setCapacity(): cannot change the capacity after tracing has been enabled");
+        return;
+    }
+    buffer->capacity = qMax(1, events);
+#else
+    Q_UNUSED(events);
+#endif
+}
+
+/*!
+    Discards the recorded events.
+ */
+void IrcTrace::clear()
+{
+#ifdef IRC_TRACE
+    IrcTraceBuffer* buffer = irc_trace_buffer();
+    QMutexLocker locker(&buffer->mutex);
+    if (buffer->events) {
+        for (int i = 0; i < buffer->capacity; ++i)
+            buffer->events[i].sequence.storeRelease(0);
+    }
+#endif
+}
+
+/*!
+    Returns the recorded events in the Chrome trace event format.
+
+    The events are sorted by the time they finished. Events that are
+    being written during the export are skipped.
+ */
+QByteArray IrcTrace::toJson()
+{
+    QByteArray json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+#ifdef IRC_TRACE
+    IrcTraceBuffer* buffer = irc_trace_buffer();
+    QMutexLocker locker(&buffer->mutex);
+    if (buffer->events) {
+        const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+        QHash<Qt::HANDLE, int> threads;
+        const quint64 next = buffer->next.loadAcquire();
+        const quint64 count = qMin<quint64>(next, buffer->capacity);
+        bool first = true;
+        for (quint64 index = next - count; index < next; ++index) {
+            IrcTraceEvent& event = buffer->events[index % buffer->capacity];
+            if (event.sequence.loadAcquire() != index + 1)
+                continue;
+            const char* category = event.category;
+            const char* name = event.name;
+            const qint64 start = event.start;
+            const qint64 duration = event.duration;
+            const Qt::HANDLE thread = event.thread;
+            if (event.sequence.loadAcquire() != index + 1)
+                continue;
+
+            // small thread ids are easier to read in the viewers
+            int tid = threads.value(thread, -1);
+            if (tid == -1) {
+                tid = threads.count() + 1;
+                threads.insert(thread, tid);
+            }
+
+            if (!first)
+                json += ',';
+            first = false;
+            json += "\n{\"cat\":\"";
+            json += category;
+            json += "\",\"name\":\"";
+            json += name;
+            json += "\",\"ph\":\"X\",\"ts\":";
+            json += QByteArray::number(start / 1000.0, 'f', 3);
+            json += ",\"dur\":";
+            json += QByteArray::number(duration / 1000.0, 'f', 3);
+            json += ",\"pid\":";
+            json += pid;
+            json += ",\"tid\":";
+            json += QByteArray::number(tid);
+            json += '}';
+        }
+    }
+#endif
+    json += "\n]}\n";
+    return json;
+}
+
+/*!
+    Saves the recorded events to \a fileName in the Chrome trace event format.
+
+    Returns \c true on success.
+
+    \sa toJson()
+ */
+bool IrcTrace::save(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    return file.write(toJson()) != -1;
+}
+
+IRC_END_NAMESPACE
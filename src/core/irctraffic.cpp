@@ -0,0 +1,700 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "irctraffic.h"
+#include "irctraffic_p.h"
+#include "ircconnection.h"
+#include "ircconnection_p.h"
+#include "ircprotocol.h"
+#include <QDateTime>
+#include <QTcpSocket>
+#include <QtEndian>
+#include <QTimer>
+#include <QDebug>
+
+IRC_BEGIN_NAMESPACE
+
+/*!
+    \file irctraffic.h
+    \brief \#include &lt;IrcTrafficRecorder&gt; and \#include &lt;IrcTrafficReplay&gt;
+ */
+
+/*!
+    \since 3.8
+    \class IrcTrafficRecorder irctraffic.h IrcTrafficRecorder
+    \ingroup core
+    \brief Records the traffic received by a connection.
+
+    IrcTrafficRecorder writes the exact bytes a connection receives from
+    the server into a capture file, with the time they were received.
+    The capture can be fed back with IrcTrafficReplay to reproduce a problem,
+    or to benchmark the message processing without a network.
+
+    \code
+    IrcTrafficRecorder* recorder = new IrcTrafficRecorder(connection);
+    recorder->setConnection(connection);
+    recorder->setFileName("libera.capture");
+    recorder->start();
+    \endcode
+
+    The capture file consists of a 16-byte header (the magic \c "ICAP",
+    the format version and the start time in milliseconds since the epoch)
+    followed by one record per socket read: the time since the start
+    in nanoseconds, the number of bytes and the bytes themselves.
+    The numbers are stored in little endian.
+
+    \note Only the received bytes are recorded. The sent commands are not.
+
+    \sa IrcTrafficReplay
+ */
+
+/*!
+    \fn void IrcTrafficRecorder::activeChanged(bool active)
+
+    This signal is emitted when the recording is started or stopped.
+ */
+
+/*!
+    \since 3.8
+    \class IrcTrafficReplay irctraffic.h IrcTrafficReplay
+    \ingroup core
+    \brief Replays recorded traffic through a connection.
+
+    IrcTrafficReplay feeds a capture file recorded by IrcTrafficRecorder
+    to a connection, through a fake socket that never touches the network.
+    The received lines pass through the same protocol, filters, composer
+    and models as they would on a live connection, which makes the replay
+    useful for reproducing performance problems and for deterministic
+    benchmarks of the whole pipeline.
+
+    The connection must be set up as if it was opened normally, including
+    a \ref IrcConnection::host "host", but it must not be active. When
+    started, the replay replaces the \ref IrcConnection::socket "socket"
+    of the connection and opens it. The commands the connection sends are
+    discarded.
+
+    \code
+    IrcTrafficReplay* replay = new IrcTrafficReplay(connection);
+    replay->setConnection(connection);
+    replay->setFileName("libera.capture");
+    replay->setPace(IrcTrafficReplay::MaximumPace);
+    connect(replay, SIGNAL(finished()), app, SLOT(quit()));
+    replay->start();
+    \endcode
+
+    \sa IrcTrafficRecorder
+ */
+
+/*!
+    \enum IrcTrafficReplay::Pace
+    This enum describes the pace of a replay.
+ */
+
+/*!
+    \var IrcTrafficReplay::OriginalPace
+    \brief The records are delivered at the pace they were recorded.
+ */
+
+/*!
+    \var IrcTrafficReplay::MaximumPace
+    \brief The records are delivered as fast as the connection consumes them.
+ */
+
+/*!
+    \fn void IrcTrafficReplay::activeChanged(bool active)
+
+    This signal is emitted when the replay is started or stopped.
+ */
+
+/*!
+    \fn void IrcTrafficReplay::finished()
+
+    This signal is emitted when the connection has processed all records.
+ */
+
+#ifndef IRC_DOXYGEN
+static const char irc_capture_magic[4] = { 'I', 'C', 'A', 'P' };
+static const quint32 irc_capture_version = 1;
+static const int irc_capture_header_size = 16;
+static const int irc_capture_record_size = 12;
+static const int irc_replay_batch_size = 64 * 1024;
+
+void IrcTrafficRecorderPrivate::record(const char* data, qint64 size)
+{
+    if (!file.isOpen() || size <= 0)
+        return;
+
+    uchar header[irc_capture_record_size];
+    qToLittleEndian<qint64>(clock.nsecsElapsed(), header);
+    qToLittleEndian<quint32>(quint32(size), header + 8);
+    file.write(reinterpret_cast<const char*>(header), irc_capture_record_size);
+    file.write(data, size);
+    ++records;
+    bytes += size;
+}
+
+class IrcReplaySocket : public QTcpSocket
+{
+public:
+    explicit IrcReplaySocket(QObject* parent) : QTcpSocket(parent), offset(0) { }
+
+    using QAbstractSocket::connectToHost;
+
+    void connectToHost(const QString& hostName, quint16 port, OpenMode openMode, NetworkLayerProtocol protocol) override
+    {
+        Q_UNUSED(hostName);
+        Q_UNUSED(port);
+        Q_UNUSED(openMode);
+        Q_UNUSED(protocol);
+        setSocketState(ConnectingState);
+        emit stateChanged(ConnectingState);
+    }
+
+    void disconnectFromHost() override
+    {
+        if (state() == UnconnectedState)
+            return;
+        buffer.clear();
+        offset = 0;
+        setOpenMode(NotOpen);
+        setSocketState(UnconnectedState);
+        emit stateChanged(UnconnectedState);
+        emit disconnected();
+    }
+
+    qint64 bytesAvailable() const override
+    {
+        return buffer.size() - offset + QIODevice::bytesAvailable();
+    }
+
+    void establish()
+    {
+        setOpenMode(ReadWrite | Unbuffered);
+        setSocketState(ConnectedState);
+        emit stateChanged(ConnectedState);
+        emit connected();
+    }
+
+    void feed(const char* data, qint64 size)
+    {
+        if (offset > 0 && offset == buffer.size()) {
+            buffer.resize(0);
+            offset = 0;
+        }
+        buffer.append(data, size);
+    }
+
+protected:
+    qint64 readData(char* data, qint64 maxlen) override
+    {
+        const qint64 count = qMin<qint64>(maxlen, buffer.size() - offset);
+        memcpy(data, buffer.constData() + offset, count);
+        offset += count;
+        return count;
+    }
+
+    qint64 writeData(const char* data, qint64 len) override
+    {
+        Q_UNUSED(data);
+        return len;
+    }
+
+private:
+    QByteArray buffer;
+    int offset;
+};
+
+class IrcTrafficReplayPrivate
+{
+    Q_DECLARE_PUBLIC(IrcTrafficReplay)
+
+public:
+    void _irc_connected();
+    void _irc_deliver();
+
+    bool open();
+    void close();
+    void finish();
+
+    IrcTrafficReplay* q_ptr = nullptr;
+    QPointer<IrcConnection> connection;
+    QPointer<IrcReplaySocket> socket;
+    QString fileName;
+    IrcTrafficReplay::Pace pace = IrcTrafficReplay::OriginalPace;
+    bool active = false;
+    QFile file;
+    const uchar* data = nullptr;
+    qint64 size = 0;
+    qint64 offset = 0;
+    qint64 records = 0;
+    qint64 position = 0;
+    qint64 origin = 0;
+    QElapsedTimer clock;
+    QTimer timer;
+};
+
+bool IrcTrafficReplayPrivate::open()
+{
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "IrcTrafficReplay::start(): cannot open" << fileName << file.errorString();
+        return false;
+    }
+    size = file.size();
+    data = size > 0 ? file.map(0, size) : nullptr;
+    if (!data || size < irc_capture_header_size || memcmp(data, irc_capture_magic, 4) != 0
+            || qFromLittleEndian<quint32>(data + 4) != irc_capture_version) {
+        qWarning() << "IrcTrafficReplay::start(): not a capture file" << fileName;
+        close();
+        return false;
+    }
+
+    // count the records, and leave out a truncated one at the end
+    records = 0;
+    origin = -1;
+    qint64 pos = irc_capture_header_size;
+    while (pos + irc_capture_record_size <= size) {
+        const qint64 length = qFromLittleEndian<quint32>(data + pos + 8);
+        if (pos + irc_capture_record_size + length > size)
+            break;
+        if (origin == -1)
+            origin = qFromLittleEndian<qint64>(data + pos);
+        pos += irc_capture_record_size + length;
+        ++records;
+    }
+    if (pos < size)
+        qWarning() << "IrcTrafficReplay::start(): ignoring a truncated record at the end of" << fileName;
+    size = pos;
+    offset = irc_capture_header_size;
+    position = 0;
+    return true;
+}
+
+void IrcTrafficReplayPrivate::close()
+{
+    timer.stop();
+    if (data)
+        file.unmap(const_cast<uchar*>(data));
+    data = nullptr;
+    file.close();
+}
+
+void IrcTrafficReplayPrivate::_irc_connected()
+{
+    if (!active || !socket)
+        return;
+    socket->establish();
+    clock.start();
+    _irc_deliver();
+}
+
+void IrcTrafficReplayPrivate::_irc_deliver()
+{
+    Q_Q(IrcTrafficReplay);
+    if (!active)
+        return;
+    if (!socket || socket->state() != QAbstractSocket::ConnectedState || !connection) {
+        q->stop();
+        return;
+    }
+
+    const bool maximum = pace == IrcTrafficReplay::MaximumPace;
+    const bool pending = socket->bytesAvailable() > 0 || connection->bufferedBytes() > 0;
+
+    // as fast as possible, but no faster than the connection consumes
+    if (!maximum || !pending) {
+        const qint64 elapsed = clock.nsecsElapsed();
+        qint64 batch = 0;
+        while (offset < size) {
+            const qint64 stamp = qFromLittleEndian<qint64>(data + offset) - origin;
+            const qint64 length = qFromLittleEndian<quint32>(data + offset + 8);
+            if (maximum ? batch >= irc_replay_batch_size : stamp > elapsed)
+                break;
+            socket->feed(reinterpret_cast<const char*>(data + offset + irc_capture_record_size), length);
+            offset += irc_capture_record_size + length;
+            batch += length;
+            ++position;
+        }
+        if (batch > 0)
+            emit socket->readyRead();
+    }
+
+    if (!active || !socket || !connection)
+        return;
+
+    if (offset < size) {
+        if (maximum) {
+            timer.start(0);
+        } else {
+            const qint64 stamp = qFromLittleEndian<qint64>(data + offset) - origin;
+            timer.start(int(qMax<qint64>(0, stamp - clock.nsecsElapsed()) / 1000000));
+        }
+    } else if (socket->bytesAvailable() > 0 || connection->bufferedBytes() > 0) {
+        timer.start(0);
+    } else {
+        finish();
+    }
+}
+
+void IrcTrafficReplayPrivate::finish()
+{
+    Q_Q(IrcTrafficReplay);
+    close();
+    active = false;
+    emit q->activeChanged(false);
+    emit q->finished();
+}
+#endif // IRC_DOXYGEN
+
+/*!
+    Constructs a new traffic recorder with \a parent.
+ */
+IrcTrafficRecorder::IrcTrafficRecorder(QObject* parent) : QObject(parent), d_ptr(new IrcTrafficRecorderPrivate)
+{
+    Q_D(IrcTrafficRecorder);
+    d->q_ptr = this;
+}
+
+/*!
+    Destructs the traffic recorder. The recording is stopped.
+ */
+IrcTrafficRecorder::~IrcTrafficRecorder()
+{
+    stop();
+}
+
+/*!
+    This property holds the recorded connection.
+
+    \par Access functions:
+    \li \ref IrcConnection* <b>connection</b>() const
+    \li void <b>setConnection</b>(\ref IrcConnection* connection)
+ */
+IrcConnection* IrcTrafficRecorder::connection() const
+{
+    Q_D(const IrcTrafficRecorder);
+    return d->connection;
+}
+
+void IrcTrafficRecorder::setConnection(IrcConnection* connection)
+{
+    Q_D(IrcTrafficRecorder);
+    if (d->connection != connection) {
+        if (d->connection && IrcConnectionPrivate::get(d->connection)->recorder == this)
+            IrcConnectionPrivate::get(d->connection)->recorder = nullptr;
+        d->connection = connection;
+        if (connection && isActive())
+            IrcConnectionPrivate::get(connection)->recorder = this;
+    }
+}
+
+/*!
+    This property holds the name of the capture file.
+
+    An existing file is overwritten when the recording is started.
+
+    \par Access functions:
+    \li QString <b>fileName</b>() const
+    \li void <b>setFileName</b>(const QString& fileName)
+ */
+QString IrcTrafficRecorder::fileName() const
+{
+    Q_D(const IrcTrafficRecorder);
+    return d->fileName;
+}
+
+void IrcTrafficRecorder::setFileName(const QString& fileName)
+{
+    Q_D(IrcTrafficRecorder);
+    d->fileName = fileName;
+}
+
+/*!
+    \property bool IrcTrafficRecorder::active
+    This property holds whether the recording is in progress.
+
+    \par Access function:
+    \li bool <b>isActive</b>() const
+
+    \par Notifier signal:
+    \li void <b>activeChanged</b>(bool active)
+ */
+bool IrcTrafficRecorder::isActive() const
+{
+    Q_D(const IrcTrafficRecorder);
+    return d->file.isOpen();
+}
+
+/*!
+    This property holds the number of records written since the recording was started.
+
+    \par Access function:
+    \li qint64 <b>recordCount</b>() const
+ */
+qint64 IrcTrafficRecorder::recordCount() const
+{
+    Q_D(const IrcTrafficRecorder);
+    return d->records;
+}
+
+/*!
+    This property holds the number of bytes recorded since the recording was started.
+
+    \par Access function:
+    \li qint64 <b>byteCount</b>() const
+ */
+qint64 IrcTrafficRecorder::byteCount() const
+{
+    Q_D(const IrcTrafficRecorder);
+    return d->bytes;
+}
+
+/*!
+    Starts recording.
+
+    Returns \c false if the connection or the file name has not been set,
+    or if the file cannot be opened for writing.
+ */
+bool IrcTrafficRecorder::start()
+{
+    Q_D(IrcTrafficRecorder);
+    stop();
+    if (!d->connection) {
+        qWarning("IrcTrafficRecorder::start(): connection is null!");
+        return false;
+    }
+    d->file.setFileName(d->fileName);
+    if (!d->file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "IrcTrafficRecorder::start(): cannot open" << d->fileName << d->file.errorString();
+        return false;
+    }
+
+    uchar header[irc_capture_header_size];
+    memcpy(header, irc_capture_magic, 4);
+    qToLittleEndian<quint32>(irc_capture_version, header + 4);
+    qToLittleEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), header + 8);
+    d->file.write(reinterpret_cast<const char*>(header), irc_capture_header_size);
+
+    d->records = 0;
+    d->bytes = 0;
+    d->clock.start();
+    IrcConnectionPrivate::get(d->connection)->recorder = this;
+    emit activeChanged(true);
+    return true;
+}
+
+/*!
+    Stops recording, and closes the capture file.
+ */
+void IrcTrafficRecorder::stop()
+{
+    Q_D(IrcTrafficRecorder);
+    if (!d->file.isOpen())
+        return;
+    if (d->connection && IrcConnectionPrivate::get(d->connection)->recorder == this)
+        IrcConnectionPrivate::get(d->connection)->recorder = nullptr;
+    d->file.close();
+    emit activeChanged(false);
+}
+
+/*!
+    Constructs a new traffic replay with \a parent.
+ */
+IrcTrafficReplay::IrcTrafficReplay(QObject* parent) : QObject(parent), d_ptr(new IrcTrafficReplayPrivate)
+{
+    Q_D(IrcTrafficReplay);
+    d->q_ptr = this;
+    d->timer.setSingleShot(true);
+    connect(&d->timer, SIGNAL(timeout()), this, SLOT(_irc_deliver()));
+}
+
+/*!
+    Destructs the traffic replay. The replay is stopped.
+ */
+IrcTrafficReplay::~IrcTrafficReplay()
+{
+    Q_D(IrcTrafficReplay);
+    d->close();
+}
+
+/*!
+    This property holds the connection the traffic is replayed to.
+
+    \par Access functions:
+    \li \ref IrcConnection* <b>connection</b>() const
+    \li void <b>setConnection</b>(\ref IrcConnection* connection)
+ */
+IrcConnection* IrcTrafficReplay::connection() const
+{
+    Q_D(const IrcTrafficReplay);
+    return d->connection;
+}
+
+void IrcTrafficReplay::setConnection(IrcConnection* connection)
+{
+    Q_D(IrcTrafficReplay);
+    if (d->connection != connection) {
+        stop();
+        d->connection = connection;
+    }
+}
+
+/*!
+    This property holds the name of the capture file.
+
+    \par Access functions:
+    \li QString <b>fileName</b>() const
+    \li void <b>setFileName</b>(const QString& fileName)
+ */
+QString IrcTrafficReplay::fileName() const
+{
+    Q_D(const IrcTrafficReplay);
+    return d->fileName;
+}
+
+void IrcTrafficReplay::setFileName(const QString& fileName)
+{
+    Q_D(IrcTrafficReplay);
+    d->fileName = fileName;
+}
+
+/*!
+    This property holds the pace of the replay.
+
+    The default value is \c OriginalPace.
+
+    \par Access functions:
+    \li \ref IrcTrafficReplay::Pace "Pace" <b>pace</b>() const
+    \li void <b>setPace</b>(\ref IrcTrafficReplay::Pace "Pace" pace)
+ */
+IrcTrafficReplay::Pace IrcTrafficReplay::pace() const
+{
+    Q_D(const IrcTrafficReplay);
+    return d->pace;
+}
+
+void IrcTrafficReplay::setPace(Pace pace)
+{
+    Q_D(IrcTrafficReplay);
+    d->pace = pace;
+}
+
+/*!
+    \property bool IrcTrafficReplay::active
+    This property holds whether the replay is in progress.
+
+    \par Access function:
+    \li bool <b>isActive</b>() const
+
+    \par Notifier signal:
+    \li void <b>activeChanged</b>(bool active)
+ */
+bool IrcTrafficReplay::isActive() const
+{
+    Q_D(const IrcTrafficReplay);
+    return d->active;
+}
+
+/*!
+    This property holds the number of records in the capture file.
+
+    \par Access function:
+    \li qint64 <b>recordCount</b>() const
+ */
+qint64 IrcTrafficReplay::recordCount() const
+{
+    Q_D(const IrcTrafficReplay);
+    return d->records;
+}
+
+/*!
+    This property holds the number of records delivered so far.
+
+    \par Access function:
+    \li qint64 <b>position</b>() const
+ */
+qint64 IrcTrafficReplay::position() const
+{
+    Q_D(const IrcTrafficReplay);
+    return d->position;
+}
+
+/*!
+    Starts the replay.
+
+    Returns \c false if the connection has not been set or is already active,
+    or if the capture file cannot be read.
+ */
+bool IrcTrafficReplay::start()
+{
+    Q_D(IrcTrafficReplay);
+    stop();
+    if (!d->connection) {
+        qWarning("IrcTrafficReplay::start(): connection is null!");
+        return false;
+    }
+    if (d->connection->isActive()) {
+        qWarning("IrcTrafficReplay::start(): connection is active!");
+        return false;
+    }
+    if (!d->open())
+        return false;
+
+    d->socket = new IrcReplaySocket(d->connection);
+    d->connection->setSocket(d->socket);
+    d->active = true;
+    emit activeChanged(true);
+
+    d->connection->open();
+    if (d->socket->state() != QAbstractSocket::ConnectingState) {
+        qWarning("IrcTrafficReplay::start(): cannot open the connection!");
+        stop();
+        return false;
+    }
+    QMetaObject::invokeMethod(this, "_irc_connected", Qt::QueuedConnection);
+    return true;
+}
+
+/*!
+    Stops the replay.
+
+    The connection is left open, and keeps the state it has reached.
+ */
+void IrcTrafficReplay::stop()
+{
+    Q_D(IrcTrafficReplay);
+    if (!d->active)
+        return;
+    d->close();
+    d->active = false;
+    emit activeChanged(false);
+}
+
+#include "moc_irctraffic.cpp"
+
+IRC_END_NAMESPACE
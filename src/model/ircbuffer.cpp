@@ -31,6 +31,8 @@
 #include "ircbuffermodel.h"
 #include "ircbuffermodel_p.h"
 #include "ircconnection.h"
+#include "irctrace_p.h"
+#include "ircmemory_p.h"
 #include "ircnetwork.h"
 #include "ircchannel.h"
 
@@ -82,6 +84,11 @@ IrcBufferPrivate::~IrcBufferPrivate()
 {
 }
 
+qint64 IrcBufferPrivate::memoryUsage() const
+{
+    return IrcMemory::ObjectSize + sizeof(IrcBufferPrivate) + IrcMemory::of(name) + IrcMemory::of(prefix) + IrcMemory::of(userData);
+}
+
 void IrcBufferPrivate::init(const QString& title, IrcBufferModel* m)
 {
     name = title;
@@ -156,6 +163,8 @@ bool IrcBufferPrivate::isMonitorable() const
 bool IrcBufferPrivate::processMessage(IrcMessage* message)
 {
     Q_Q(IrcBuffer);
+    // "IrcChannel" for channels
+    IRC_TRACE_SCOPE("model", q->metaObject()->className());
     bool processed = false;
     switch (message->type()) {
     case IrcMessage::Away:
@@ -564,6 +573,23 @@ void IrcBuffer::setUserData(const QVariantMap& data)
     }
 }
 
+/*!
+    \since 3.8
+
+    Returns the approximate number of heap bytes held by the buffer.
+
+    The number includes the name, prefix and \ref userData "user data" of
+    the buffer. For a channel, it also includes the users, the modes, the
+    topic, the names and the lists of the user models attached to the channel.
+
+    \sa IrcBufferModel::memoryUsage(), IrcConnection::memoryUsage()
+ */
+qint64 IrcBuffer::memoryUsage() const
+{
+    Q_D(const IrcBuffer);
+    return d->memoryUsage();
+}
+
 /*!
     Sends a \a command to the server.
 
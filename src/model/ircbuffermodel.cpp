@@ -35,11 +35,14 @@
 #include "ircmessage.h"
 #include "irccommand.h"
 #include "ircconnection.h"
+#include "ircclock.h"
+#include "irctimer_p.h"
+#include "irctrace_p.h"
+#include "ircmemory_p.h"
 #include <qmetatype.h>
 #include <qmetaobject.h>
 #include <qdatastream.h>
 #include <qvariant.h>
-#include <qtimer.h>
 #include <algorithm>
 
 IRC_BEGIN_NAMESPACE
@@ -146,6 +149,7 @@ IrcBufferModelPrivate::IrcBufferModelPrivate()
 bool IrcBufferModelPrivate::messageFilter(IrcMessage* msg)
 {
     Q_Q(IrcBufferModel);
+    IRC_TRACE_SCOPE("model", "IrcBufferModel");
     if (msg->type() == IrcMessage::Join && msg->isOwn())
         createBuffer(static_cast<IrcJoinMessage*>(msg)->channel());
 
@@ -358,7 +362,7 @@ void IrcBufferModelPrivate::insertBuffer(int index, IrcBuffer* buffer, bool noti
             connection->sendCommand(IrcCommand::createMonitor(QStringLiteral("+"), buffer->title()));
             if (!monitorPending) {
                 monitorPending = true;
-                QTimer::singleShot(1000, q, SLOT(_irc_monitorStatus()));
+                IrcTimer::singleShot(connection->clock(), 1000, q, SLOT(_irc_monitorStatus()));
             }
         }
     }
@@ -493,19 +497,20 @@ void IrcBufferModelPrivate::_irc_initialized()
 {
     Q_Q(IrcBufferModel);
     if (joinDelay >= 0)
-        QTimer::singleShot(joinDelay * 1000, q, SLOT(_irc_restoreBuffers()));
+        IrcTimer::singleShot(connection->clock(), joinDelay * 1000, q, SLOT(_irc_restoreBuffers()));
 
-    bool monitored = false;
+    QStringList monitored;
     foreach (IrcBuffer* buffer, bufferList) {
-        if (monitorEnabled && IrcBufferPrivate::get(buffer)->isMonitorable()) {
-            connection->sendCommand(IrcCommand::createMonitor(QStringLiteral("+"), buffer->title()));
-            monitored = true;
-        }
+        if (monitorEnabled && IrcBufferPrivate::get(buffer)->isMonitorable())
+            monitored += buffer->title();
     }
 
-    if (monitored && !monitorPending) {
+    foreach (IrcCommand* cmd, IrcCommand::createPacked(IrcCommand::Monitor, monitored, QStringList(QStringLiteral("+")), connection->network()))
+        connection->sendCommand(cmd);
+
+    if (!monitored.isEmpty() && !monitorPending) {
         monitorPending = true;
-        QTimer::singleShot(1000, q, SLOT(_irc_monitorStatus()));
+        IrcTimer::singleShot(connection->clock(), 1000, q, SLOT(_irc_monitorStatus()));
     }
 }
 
@@ -520,10 +525,6 @@ void IrcBufferModelPrivate::_irc_bufferDestroyed(IrcBuffer* buffer)
     removeBuffer(buffer);
 }
 
-static bool sortIrcChannels_withKeysFirst(IrcChannel *ch1, IrcChannel *ch2) {
-    return ch1->key().length() > ch2->key().length();
-}
-
 void IrcBufferModelPrivate::_irc_restoreBuffers()
 {
     Q_Q(IrcBufferModel);
@@ -555,83 +556,18 @@ void IrcBufferModelPrivate::_irc_restoreBuffers()
             }
         }
 
-        // Join multiple channels:
-        //
-        // * A single IRC command may be 512 bytes long, including the <CR><LF> at the end.
-        //   Therefore, we must collect as many channels as many channels as possible into
-        //   a single command, but without exceeding the 512 bytes.
-        //   NOTES:
-        //       - Previously, communi tried to join all channels in a single command,
-        //         which didn't work because it exceeded the 512 bytes
-        //       - Then, it joined 3 channels at a time
-        //
-        // * We should also group channels with keys separately from channels without keys,
-        //   because the JOIN command doesn't work when channels without keys preceed the
-        //   channels with keys.
-        //   Works:
-        //       JOIN #ch1,#ch2             --- neither #ch1 nor #ch2 have keys
-        //       JOIN #ch1,#ch2 key1,key2   --- both #ch1 and #ch2 have keys
-        //       JOIN #ch1,#ch2 key1        --- #ch1 has key, #ch2 doesn't
-        //   Doesn't work:
-        //       JOIN #ch1,#ch2 ,key2       --- #ch1 doesn't have a key, #ch2 does
-        //                                      (NOTE: this is what communi used to do)
-        //
-
-        // Get channels from buffers
-        QList<IrcChannel*> filteredChannels;
-
+        // pack as many channels as the server allows into each JOIN
+        QStringList chans, keys;
         foreach (IrcBuffer* buf, bufferList) {
-            IrcChannel *channel = buf->toChannel();
+            IrcChannel* channel = buf->toChannel();
             if (channel && !channel->isActive() && IrcChannelPrivate::get(channel)->enabled) {
-                filteredChannels.append(channel);
-            }
-        }
-
-        // Sort channels with keys first
-        std::sort(filteredChannels.begin(), filteredChannels.end(), sortIrcChannels_withKeysFirst);
-
-        if (filteredChannels.size()) {
-
-            // Length of "JOIN  \r\n"
-            const int joinCommandMinLength = 8;
-            const int maxIrcCommandBytes = 512;
-            int joinCommandLength = joinCommandMinLength;
-
-            QStringList chans, keys;
-            foreach (IrcChannel *channel, filteredChannels) {
-                int additonalLength = channel->title().length() + channel->key().length();
-                // Command needs a comma between channels
-                if (chans.length())
-                    additonalLength++;
-                // Command needs a comma between keys
-                if (keys.length() && channel->key().length())
-                    additonalLength++;
-
-                if ((joinCommandLength + additonalLength) > maxIrcCommandBytes) {
-                    // If the command size would exceed the maximum, send a command with the channels collected so far
-                    connection->sendCommand(IrcCommand::createJoin(chans, keys));
-
-                    chans.clear();
-                    keys.clear();
-                    joinCommandLength = joinCommandMinLength;
-                }
-
-                // Add channel to list
                 chans += channel->title();
-
-                // Only add key to list if there is a key,
-                // otherwise not needed, because channels with keys are sorted before channels without keys
-                if (channel->key().length())
-                    keys += channel->key();
-
-                joinCommandLength = additonalLength;
+                keys += channel->key();
             }
-
-            if (!chans.isEmpty()) {
-                connection->sendCommand(IrcCommand::createJoin(chans, keys));
-            }
-
         }
+
+        foreach (IrcCommand* cmd, IrcCommand::createPacked(IrcCommand::Join, chans, keys, connection->network()))
+            connection->sendCommand(cmd);
     }
 }
 
@@ -824,6 +760,32 @@ int IrcBufferModel::indexOf(IrcBuffer* buffer) const
     return d->bufferList.indexOf(buffer);
 }
 
+/*!
+    \since 3.8
+
+    Returns the approximate number of heap bytes held by the model and its buffers.
+
+    The number is the sum of IrcBuffer::memoryUsage() of all buffers, and
+    the lists of the model itself. Together with IrcConnection::memoryUsage(),
+    it gives an estimate of the memory held for a connection.
+
+    \code
+    qint64 bytes = connection->memoryUsage() + bufferModel->memoryUsage();
+    foreach (IrcBuffer* buffer, bufferModel->buffers())
+        qDebug() << buffer->title() << buffer->memoryUsage();
+    \endcode
+ */
+qint64 IrcBufferModel::memoryUsage() const
+{
+    Q_D(const IrcBufferModel);
+    qint64 bytes = IrcMemory::ObjectSize + sizeof(IrcBufferModelPrivate);
+    bytes += IrcMemory::of(d->bufferList) + IrcMemory::of(d->bufferMap) + IrcMemory::of(d->keys);
+    bytes += IrcMemory::of(d->bufferStates) + IrcMemory::of(d->channels);
+    foreach (IrcBuffer* buffer, d->bufferList)
+        bytes += buffer->memoryUsage();
+    return bytes;
+}
+
 /*!
     Adds a buffer with \a title to the model and returns it.
  */
@@ -1416,7 +1378,7 @@ bool IrcBufferModel::restoreState(const QByteArray& state, int version)
     }
 
     if (d->joinDelay >= 0 && d->connection && d->connection->isConnected())
-        QTimer::singleShot(d->joinDelay * 1000, this, SLOT(_irc_restoreBuffers()));
+        IrcTimer::singleShot(d->connection->clock(), d->joinDelay * 1000, this, SLOT(_irc_restoreBuffers()));
 
     return true;
 }
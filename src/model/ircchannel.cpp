@@ -36,6 +36,7 @@
 #include "ircnetwork.h"
 #include "irccommand.h"
 #include "ircuser_p.h"
+#include "ircmemory_p.h"
 #include "irc.h"
 
 IRC_BEGIN_NAMESPACE
@@ -96,6 +97,22 @@ IrcChannelPrivate::~IrcChannelPrivate()
 {
 }
 
+qint64 IrcChannelPrivate::memoryUsage() const
+{
+    qint64 bytes = IrcBufferPrivate::memoryUsage() - sizeof(IrcBufferPrivate) + sizeof(IrcChannelPrivate);
+    bytes += IrcMemory::of(modes) + IrcMemory::of(topic) + IrcMemory::of(names);
+    bytes += IrcMemory::of(userList) + IrcMemory::of(activeUsers) + IrcMemory::of(userMap) + IrcMemory::of(userModels);
+    foreach (IrcUser* user, userList) {
+        const IrcUserPrivate* u = IrcUserPrivate::get(user);
+        bytes += IrcMemory::ObjectSize + sizeof(IrcUserPrivate);
+        bytes += IrcMemory::of(u->name) + IrcMemory::of(u->prefix) + IrcMemory::of(u->mode);
+    }
+    // every attached model holds its own lists of the users
+    foreach (IrcUserModel* model, userModels)
+        bytes += IrcUserModelPrivate::get(model)->memoryUsage();
+    return bytes;
+}
+
 void IrcChannelPrivate::init(const QString& title, IrcBufferModel* m)
 {
     IrcBufferPrivate::init(title, m);
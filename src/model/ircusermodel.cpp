@@ -32,6 +32,7 @@
 #include "ircconnection.h"
 #include "ircchannel_p.h"
 #include "ircuser.h"
+#include "ircmemory_p.h"
 #include <qpointer.h>
 #include <algorithm>
 
@@ -124,6 +125,11 @@ IrcUserModelPrivate::IrcUserModelPrivate()
 {
 }
 
+qint64 IrcUserModelPrivate::memoryUsage() const
+{
+    return IrcMemory::ObjectSize + sizeof(IrcUserModelPrivate) + IrcMemory::of(titles) + IrcMemory::of(userList);
+}
+
 void IrcUserModelPrivate::addUser(IrcUser* user, bool notify)
 {
     insertUser(-1, user, notify);
@@ -469,6 +475,21 @@ int IrcUserModel::indexOf(IrcUser* user) const
     return d->userList.indexOf(user);
 }
 
+/*!
+    \since 3.8
+
+    Returns the approximate number of heap bytes held by the model.
+
+    The users themselves belong to the \ref channel "channel", and are
+    not included. Each model attached to a channel holds its own lists of
+    the users, which are included in IrcBuffer::memoryUsage() of the channel.
+ */
+qint64 IrcUserModel::memoryUsage() const
+{
+    Q_D(const IrcUserModel);
+    return d->memoryUsage();
+}
+
 /*!
     This property holds the model sort method.
 
@@ -32,6 +32,8 @@ DLLDESTDIR = $$IRC_BUILDDIR/bin
 
 DISTFILES += $$CONV_HEADERS
 
+tracing:DEFINES += IRC_TRACE
+
 coverage {
     QMAKE_CLEAN += $$OBJECTS_DIR/*.gcda $$OBJECTS_DIR/*.gcno
 
@@ -29,12 +29,19 @@
 #include "irccommandqueue.h"
 #include "irccommandqueue_p.h"
 #include "ircconnection.h"
+#include "ircconnectionstatistics_p.h"
 #include "irccommand.h"
+#include "ircclock.h"
+#include <QtMath>
 
 IRC_BEGIN_NAMESPACE
 
 static const int DEFAULT_BATCH = 3;
 static const int DEFAULT_INTERVAL = 2;
+static const qreal DEFAULT_BURST = 10.0;
+static const qreal DEFAULT_RATE = 1.0;
+static const qreal DEFAULT_COMMAND_COST = 1.0;
+static const qreal DEFAULT_BYTE_COST = 1.0 / 120.0;
 
 /*!
     \file irccommandqueue.h
@@ -46,6 +53,69 @@ static const int DEFAULT_INTERVAL = 2;
     \class IrcCommandQueue irccommandqueue.h <IrcCommandQueue>
     \ingroup util
     \brief Provides a flood protection queue for commands.
+
+    IrcCommandQueue supports two modes of operation:
+    \li \ref IrcCommandQueue::Batch "Batch" - a fixed \ref batch of commands is
+        sent every \ref interval seconds. This is the default mode.
+    \li \ref IrcCommandQueue::TokenBucket "TokenBucket" - every command costs
+        \ref commandCost tokens plus \ref byteCost tokens per encoded byte.
+        Commands are sent immediately as long as the bucket has enough tokens,
+        which refill at \ref rate tokens per second up to \ref burst tokens.
+        When the bucket runs dry, the queue waits exactly as long as it takes
+        to refill the cost of the next command.
+        Commands that bypass the queue are charged as well, and may leave
+        the bucket in debt of up to \ref burst tokens.
+
+    The default token bucket parameters resemble the penalty rules of common
+    IRC servers, where a client may be up to 10 "seconds" ahead and every line
+    costs a bit more than one second plus a little extra per byte.
+ */
+
+/*!
+    \since 3.8
+    \enum IrcCommandQueue::Mode
+    This enum describes the queue modes.
+ */
+
+/*!
+    \var IrcCommandQueue::Batch
+    \brief A fixed batch of commands is sent at fixed intervals.
+ */
+
+/*!
+    \var IrcCommandQueue::TokenBucket
+    \brief Commands are sent at the rate allowed by a token bucket.
+ */
+
+/*!
+    \since 3.8
+    \enum IrcCommandQueue::Priority
+    This enum describes the command priorities.
+
+    Queued commands are sent in the order of priority. Within the same
+    priority, commands are sent in round-robin order between targets, so
+    that a single busy target cannot monopolize the queue.
+
+    A command never overtakes an earlier queued command to the same target.
+    For example, a PART that follows messages to a channel is sent after
+    the messages, even though it has a higher priority.
+
+    \sa priority(), setPriority()
+ */
+
+/*!
+    \var IrcCommandQueue::HighPriority
+    \brief Connection control commands, such as NICK, PING, PONG and CAP.
+ */
+
+/*!
+    \var IrcCommandQueue::NormalPriority
+    \brief Channel management and query commands.
+ */
+
+/*!
+    \var IrcCommandQueue::LowPriority
+    \brief Bulk commands, such as PRIVMSG and NOTICE.
  */
 
 /*!
@@ -55,7 +125,9 @@ static const int DEFAULT_INTERVAL = 2;
  */
 
 #ifndef IRC_DOXYGEN
-IrcCommandQueuePrivate::IrcCommandQueuePrivate() :  batch(DEFAULT_BATCH), interval(DEFAULT_INTERVAL)
+IrcCommandQueuePrivate::IrcCommandQueuePrivate() :  batch(DEFAULT_BATCH), interval(DEFAULT_INTERVAL),
+    burst(DEFAULT_BURST), rate(DEFAULT_RATE), commandCost(DEFAULT_COMMAND_COST), byteCost(DEFAULT_BYTE_COST),
+    tokens(DEFAULT_BURST)
 {
 }
 
@@ -64,22 +136,163 @@ bool IrcCommandQueuePrivate::commandFilter(IrcCommand* cmd)
     Q_Q(IrcCommandQueue);
     if (cmd->type() == IrcCommand::Quit) {
         _irc_sendBatch(true);
-    } else if (interval > 0 && !cmd->parent() && connection->isConnected()) {
+    } else if (cmd->parent() != q && isEnabled() && connection->isConnected()) {
+        if (mode == IrcCommandQueue::TokenBucket) {
+            refill();
+            const qreal c = cost(cmd);
+            if (cmd->parent() || (size() == 0 && tokens >= c)) {
+                // sent right away, but still accounted for; the server
+                // penalizes it too, so the bucket may go into debt
+                tokens = qMax(-burst, tokens - c);
+                return false;
+            }
+        } else if (cmd->parent()) {
+            return false;
+        }
         cmd->setParent(q);
-        commands.enqueue(cmd);
-        emit q->sizeChanged(commands.size());
-        _irc_updateTimer();
+        int priority = q->priority(cmd->type());
+        const QString t = target(cmd).toLower();
+        // a command never overtakes an earlier queued command to the same
+        // target, e.g. a PART the last messages to the channel
+        if (!t.isEmpty()) {
+            for (int i = IrcCommandQueue::LowPriority; i > priority; --i) {
+                if (lanes[i].contains(t)) {
+                    priority = i;
+                    break;
+                }
+            }
+        }
+        lanes[priority].enqueue(cmd, t, now());
+        updateSize();
+        if (mode == IrcCommandQueue::TokenBucket)
+            _irc_sendBatch(); // a higher priority command may be affordable
+        else
+            _irc_updateTimer();
         return true;
     }
     return false;
 }
 
+bool IrcCommandQueuePrivate::isEnabled() const
+{
+    if (mode == IrcCommandQueue::TokenBucket)
+        return rate > 0;
+    return interval > 0;
+}
+
+int IrcCommandQueuePrivate::size() const
+{
+    int count = 0;
+    for (int i = IrcCommandQueue::HighPriority; i <= IrcCommandQueue::LowPriority; ++i)
+        count += lanes[i].size();
+    return count;
+}
+
+void IrcCommandQueuePrivate::updateSize()
+{
+    Q_Q(IrcCommandQueue);
+    const int count = size();
+    if (connection)
+        IrcConnectionStatisticsPrivate::get(connection->statistics())->setCommandQueueDepth(count);
+    emit q->sizeChanged(count);
+}
+
+IrcCommandLane* IrcCommandQueuePrivate::nextLane()
+{
+    for (int i = IrcCommandQueue::HighPriority; i <= IrcCommandQueue::LowPriority; ++i) {
+        if (!lanes[i].isEmpty())
+            return &lanes[i];
+    }
+    return nullptr;
+}
+
+IrcCommandQueue::Priority IrcCommandQueuePrivate::defaultPriority(IrcCommand::Type type)
+{
+    switch (type) {
+    case IrcCommand::Capability:
+    case IrcCommand::Nick:
+    case IrcCommand::Ping:
+    case IrcCommand::Pong:
+    case IrcCommand::Quit:
+        return IrcCommandQueue::HighPriority;
+    case IrcCommand::CtcpAction:
+    case IrcCommand::CtcpReply:
+    case IrcCommand::CtcpRequest:
+    case IrcCommand::Message:
+    case IrcCommand::Notice:
+        return IrcCommandQueue::LowPriority;
+    default:
+        return IrcCommandQueue::NormalPriority;
+    }
+}
+
+QString IrcCommandQueuePrivate::target(IrcCommand* cmd)
+{
+    // commands with the same priority are scheduled round-robin between their targets
+    switch (cmd->type()) {
+    case IrcCommand::CtcpAction:
+    case IrcCommand::CtcpReply:
+    case IrcCommand::CtcpRequest:
+    case IrcCommand::Join:
+    case IrcCommand::Kick:
+    case IrcCommand::Message:
+    case IrcCommand::Mode:
+    case IrcCommand::Notice:
+    case IrcCommand::Part:
+    case IrcCommand::Topic:
+        return cmd->parameters().value(0);
+    default:
+        return QString();
+    }
+}
+
+qint64 IrcCommandQueuePrivate::now() const
+{
+    return connection ? connection->clock()->elapsed() : IrcClock::system()->elapsed();
+}
+
+void IrcCommandQueuePrivate::refill()
+{
+    const qint64 time = now();
+    if (refilled >= 0)
+        tokens = qMin(burst, tokens + (time - refilled) * rate / 1000.0);
+    refilled = time;
+}
+
+qreal IrcCommandQueuePrivate::cost(IrcCommand* cmd) const
+{
+    // UTF-8 is the default encoding, and never shorter than the legacy
+    // 8-bit encodings, so the estimate errs on the safe side. A single
+    // command never costs more than a full bucket, or it would never fit.
+    const int bytes = cmd->toString().toUtf8().size() + 2; // "\r\n"
+    return qMin(burst, commandCost + bytes * byteCost);
+}
+
+void IrcCommandQueuePrivate::_irc_connected()
+{
+    tokens = burst;
+    refilled = -1;
+    _irc_sendBatch();
+}
+
 void IrcCommandQueuePrivate::_irc_updateTimer()
 {
-    if (connection && interval > 0 && !commands.isEmpty() && connection->isConnected()) {
-        timer.setInterval(interval * 1000);
-        if (!timer.isActive())
-            timer.start();
+    IrcCommandLane* lane = nextLane();
+    if (connection && isEnabled() && lane && connection->isConnected()) {
+        timer.setClock(connection->clock());
+        if (mode == IrcCommandQueue::TokenBucket) {
+            // wake up exactly when the next command can be afforded
+            refill();
+            IrcCommand* cmd = lane->head();
+            const qreal missing = cmd ? cost(cmd) - tokens : 0;
+            timer.setSingleShot(true);
+            timer.start(qMax(0, qCeil(missing * 1000 / rate)));
+        } else {
+            timer.setSingleShot(false);
+            timer.setInterval(interval * 1000);
+            if (!timer.isActive())
+                timer.start();
+        }
     } else {
         if (timer.isActive())
             timer.stop();
@@ -89,19 +302,93 @@ void IrcCommandQueuePrivate::_irc_updateTimer()
 void IrcCommandQueuePrivate::_irc_sendBatch(bool force)
 {
     Q_Q(IrcCommandQueue);
-    if (!commands.isEmpty()) {
-        int i = batch;
-        while ((force || --i >= 0) && !commands.isEmpty()) {
-            IrcCommand* cmd = commands.dequeue();
-            if (cmd) {
-                connection->sendCommand(cmd);
-                cmd->deleteLater();
+    IrcCommandLane* lane = nextLane();
+    if (lane) {
+        if (mode == IrcCommandQueue::TokenBucket) {
+            refill();
+            while (lane) {
+                IrcCommand* cmd = lane->head();
+                const qreal c = cmd ? cost(cmd) : 0;
+                if (!force && tokens < c)
+                    break;
+                lane->dequeue();
+                if (cmd) {
+                    tokens = qMax(-burst, tokens - c);
+                    connection->sendCommand(cmd);
+                    cmd->deleteLater();
+                }
+                lane = nextLane();
+            }
+        } else {
+            int i = batch;
+            while ((force || --i >= 0) && lane) {
+                IrcCommand* cmd = lane->dequeue();
+                if (cmd) {
+                    connection->sendCommand(cmd);
+                    cmd->deleteLater();
+                }
+                lane = nextLane();
             }
         }
-        emit q->sizeChanged(commands.size());
+        updateSize();
     }
     _irc_updateTimer();
 }
+
+IrcCommand* IrcCommandLane::head() const
+{
+    if (targets.isEmpty())
+        return nullptr;
+    return commands.value(targets.head()).head().command;
+}
+
+qint64 IrcCommandLane::waitTime(qint64 now) const
+{
+    qint64 wait = 0;
+    foreach (const QQueue<IrcQueuedCommand>& queue, commands)
+        wait = qMax(wait, now - queue.head().queued);
+    return wait;
+}
+
+void IrcCommandLane::enqueue(IrcCommand* cmd, const QString& target, qint64 now)
+{
+    QQueue<IrcQueuedCommand>& queue = commands[target];
+    if (queue.isEmpty())
+        targets.enqueue(target);
+    IrcQueuedCommand entry;
+    entry.command = cmd;
+    entry.queued = now;
+    queue.enqueue(entry);
+    ++count;
+}
+
+IrcCommand* IrcCommandLane::dequeue()
+{
+    if (targets.isEmpty())
+        return nullptr;
+    // round-robin between the targets, so that a single busy
+    // target cannot monopolize the lane
+    const QString target = targets.dequeue();
+    QQueue<IrcQueuedCommand>& queue = commands[target];
+    IrcCommand* cmd = queue.dequeue().command;
+    if (queue.isEmpty())
+        commands.remove(target);
+    else
+        targets.enqueue(target);
+    --count;
+    return cmd;
+}
+
+void IrcCommandLane::clear()
+{
+    foreach (const QQueue<IrcQueuedCommand>& queue, commands) {
+        foreach (const IrcQueuedCommand& entry, queue)
+            delete entry.command;
+    }
+    commands.clear();
+    targets.clear();
+    count = 0;
+}
 #endif // IRC_DOXYGEN
 
 /*!
@@ -126,6 +413,32 @@ IrcCommandQueue::~IrcCommandQueue()
     clear();
 }
 
+/*!
+    \since 3.8
+
+    This property holds the queue mode.
+
+    The default value is \ref IrcCommandQueue::Batch "Batch".
+
+    \par Access functions:
+    \li IrcCommandQueue::Mode <b>mode</b>() const
+    \li void <b>setMode</b>(IrcCommandQueue::Mode mode)
+ */
+IrcCommandQueue::Mode IrcCommandQueue::mode() const
+{
+    Q_D(const IrcCommandQueue);
+    return d->mode;
+}
+
+void IrcCommandQueue::setMode(Mode mode)
+{
+    Q_D(IrcCommandQueue);
+    if (d->mode != mode) {
+        d->mode = mode;
+        d->_irc_updateTimer();
+    }
+}
+
 /*!
     This property holds the batch size.
 
@@ -173,6 +486,127 @@ void IrcCommandQueue::setInterval(int seconds)
     }
 }
 
+/*!
+    \since 3.8
+
+    This property holds the token bucket capacity.
+
+    This is the amount of tokens that may be spent at once
+    after the queue has been idle. The default value is \c 10.
+
+    \note Only applies in the \ref IrcCommandQueue::TokenBucket "TokenBucket" mode.
+
+    \par Access functions:
+    \li qreal <b>burst</b>() const
+    \li void <b>setBurst</b>(qreal burst)
+ */
+qreal IrcCommandQueue::burst() const
+{
+    Q_D(const IrcCommandQueue);
+    return d->burst;
+}
+
+void IrcCommandQueue::setBurst(qreal burst)
+{
+    Q_D(IrcCommandQueue);
+    if (d->burst != burst) {
+        d->burst = burst;
+        d->tokens = qMin(d->tokens, burst);
+        d->_irc_updateTimer();
+    }
+}
+
+/*!
+    \since 3.8
+
+    This property holds the token bucket refill rate in tokens per second.
+
+    The default value is \c 1 token per second. A value equal to or
+    less than \c 0 disables command queueing.
+
+    \note Only applies in the \ref IrcCommandQueue::TokenBucket "TokenBucket" mode.
+
+    \par Access functions:
+    \li qreal <b>rate</b>() const
+    \li void <b>setRate</b>(qreal rate)
+ */
+qreal IrcCommandQueue::rate() const
+{
+    Q_D(const IrcCommandQueue);
+    return d->rate;
+}
+
+void IrcCommandQueue::setRate(qreal rate)
+{
+    Q_D(IrcCommandQueue);
+    if (d->rate != rate) {
+        d->refill();
+        d->rate = rate;
+        d->_irc_updateTimer();
+    }
+}
+
+/*!
+    \since 3.8
+
+    This property holds the amount of tokens each command costs.
+
+    The default value is \c 1 token.
+
+    \note Only applies in the \ref IrcCommandQueue::TokenBucket "TokenBucket" mode.
+
+    \par Access functions:
+    \li qreal <b>commandCost</b>() const
+    \li void <b>setCommandCost</b>(qreal cost)
+
+    \sa byteCost
+ */
+qreal IrcCommandQueue::commandCost() const
+{
+    Q_D(const IrcCommandQueue);
+    return d->commandCost;
+}
+
+void IrcCommandQueue::setCommandCost(qreal cost)
+{
+    Q_D(IrcCommandQueue);
+    if (d->commandCost != cost) {
+        d->commandCost = cost;
+        d->_irc_updateTimer();
+    }
+}
+
+/*!
+    \since 3.8
+
+    This property holds the amount of tokens each encoded byte costs.
+
+    The default value is \c 1/120 tokens, meaning that a full
+    512-byte line costs roughly five times as much as a short one.
+
+    \note Only applies in the \ref IrcCommandQueue::TokenBucket "TokenBucket" mode.
+
+    \par Access functions:
+    \li qreal <b>byteCost</b>() const
+    \li void <b>setByteCost</b>(qreal cost)
+
+    \sa commandCost
+ */
+qreal IrcCommandQueue::byteCost() const
+{
+    Q_D(const IrcCommandQueue);
+    return d->byteCost;
+}
+
+void IrcCommandQueue::setByteCost(qreal cost)
+{
+    Q_D(IrcCommandQueue);
+    if (d->byteCost != cost) {
+        d->byteCost = cost;
+        d->_irc_updateTimer();
+    }
+}
+
 /*!
     This property holds the current size of the queue.
 
@@ -185,7 +619,77 @@ void IrcCommandQueue::setInterval(int seconds)
 int IrcCommandQueue::size() const
 {
     Q_D(const IrcCommandQueue);
-    return d->commands.size();
+    return d->size();
+}
+
+/*!
+    \since 3.8
+
+    Returns the priority of commands of \a type.
+
+    By default, CAP, NICK, PING, PONG and QUIT commands have \ref IrcCommandQueue::HighPriority
+    "HighPriority", PRIVMSG, NOTICE and CTCP commands have \ref IrcCommandQueue::LowPriority
+    "LowPriority", and the rest have \ref IrcCommandQueue::NormalPriority "NormalPriority".
+
+    Commands with the same priority are scheduled in round-robin order between
+    their targets, that is, the channel or the user they are sent to.
+
+    \sa setPriority()
+ */
+IrcCommandQueue::Priority IrcCommandQueue::priority(IrcCommand::Type type) const
+{
+    Q_D(const IrcCommandQueue);
+    return d->priorities.value(type, IrcCommandQueuePrivate::defaultPriority(type));
+}
+
+/*!
+    \since 3.8
+
+    Sets the \a priority of commands of \a type. Commands that have
+    already been queued keep their priority.
+
+    \code
+    // let joins overtake the other queued channel commands and messages
+    queue->setPriority(IrcCommand::Join, IrcCommandQueue::HighPriority);
+    \endcode
+
+    \sa priority()
+ */
+void IrcCommandQueue::setPriority(IrcCommand::Type type, IrcCommandQueue::Priority priority)
+{
+    Q_D(IrcCommandQueue);
+    d->priorities.insert(type, IrcCommandQueue::Priority(qBound<int>(HighPriority, priority, LowPriority)));
+}
+
+/*!
+    \since 3.8
+
+    Returns the amount of queued commands with \a priority.
+
+    \sa size, waitTime()
+ */
+int IrcCommandQueue::depth(Priority priority) const
+{
+    Q_D(const IrcCommandQueue);
+    if (priority < HighPriority || priority > LowPriority)
+        return 0;
+    return d->lanes[priority].size();
+}
+
+/*!
+    \since 3.8
+
+    Returns the time in milliseconds that the oldest queued
+    command with \a priority has been waiting in the queue.
+
+    \sa depth()
+ */
+qint64 IrcCommandQueue::waitTime(Priority priority) const
+{
+    Q_D(const IrcCommandQueue);
+    if (priority < HighPriority || priority > LowPriority)
+        return 0;
+    return d->lanes[priority].waitTime(d->now());
 }
 
 /*!
@@ -207,13 +711,13 @@ void IrcCommandQueue::setConnection(IrcConnection* connection)
     if (d->connection != connection) {
         if (d->connection) {
             d->connection->removeCommandFilter(d);
-            disconnect(d->connection, SIGNAL(connected()), this, SLOT(_irc_sendBatch()));
+            disconnect(d->connection, SIGNAL(connected()), this, SLOT(_irc_connected()));
             disconnect(d->connection, SIGNAL(disconnected()), this, SLOT(_irc_updateTimer()));
         }
         d->connection = connection;
         if (connection) {
             connection->installCommandFilter(d);
-            connect(connection, SIGNAL(connected()), this, SLOT(_irc_sendBatch()));
+            connect(connection, SIGNAL(connected()), this, SLOT(_irc_connected()));
             connect(connection, SIGNAL(disconnected()), this, SLOT(_irc_updateTimer()));
         }
         d->_irc_updateTimer();
@@ -230,8 +734,8 @@ void IrcCommandQueue::setConnection(IrcConnection* connection)
 void IrcCommandQueue::clear()
 {
     Q_D(IrcCommandQueue);
-    qDeleteAll(d->commands);
-    d->commands.clear();
+    for (int i = HighPriority; i <= LowPriority; ++i)
+        d->lanes[i].clear();
     d->_irc_updateTimer();
 }
 
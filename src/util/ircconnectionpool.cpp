@@ -0,0 +1,382 @@
+/*
+  Copyright (C) 2008-2020 The Communi Project
+
+  You may use this file under the terms of BSD license as follows:
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holder nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE LIABLE FOR
+  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+  ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ircconnectionpool.h"
+#include "ircconnectionpool_p.h"
+#include "ircconnection.h"
+#include "ircmessage.h"
+#include "irccommand.h"
+#include <QMetaMethod>
+#include <QMutexLocker>
+
+IRC_BEGIN_NAMESPACE
+
+/*!
+    \file ircconnectionpool.h
+    \brief \#include &lt;IrcConnectionPool&gt;
+ */
+
+/*!
+    \since 3.8
+    \class IrcConnectionPool ircconnectionpool.h <IrcConnectionPool>
+    \ingroup util
+    \brief Spreads connections across worker threads.
+
+    IrcConnectionPool owns a set of worker threads, each running its own
+    event loop. Connections added to the pool are assigned to the least
+    loaded thread and moved there together with their children, such as
+    the socket, the protocol, the network and the reconnect timer. Objects
+    operating on a connection, such as IrcLagTimer or IrcCommandQueue,
+    should be children of the connection to be moved along with it.
+
+    Once a connection has been moved to a worker thread, it must only be
+    accessed from that thread, with the exception of the thread-safe
+    IrcConnection::sendCommand() and IrcConnection::sendData(), which
+    pass the outgoing data to the thread of the connection. The
+    messageReceived() signal delivers copies of the received messages
+    to the thread of the pool.
+
+    \code
+    IrcConnectionPool* pool = new IrcConnectionPool(this);
+    connect(pool, &IrcConnectionPool::messageReceived, this, &MyService::processMessage);
+
+    IrcConnection* connection = new IrcConnection("irc.libera.chat");
+    // ...
+    pool->addConnection(connection);
+    QMetaObject::invokeMethod(connection, "open", Qt::QueuedConnection);
+    \endcode
+ */
+
+/*!
+    \fn void IrcConnectionPool::messageReceived(IrcConnection* connection, IrcMessage* message)
+
+    This signal is emitted when a \a message has been received by a \a connection in the pool.
+
+    The signal is emitted in the thread of the pool. The \a message is a copy of
+    the received message, which is automatically deleted after the signal has
+    been delivered. The messages are only copied while the signal is connected.
+    Messages received by a connection that has been destructed or removed from
+    the pool before the delivery are not emitted.
+
+    \note The \a connection lives in a worker thread, and it is not safe to access
+    its state from the thread of the pool.
+ */
+
+#ifndef IRC_DOXYGEN
+IrcConnectionPoolPrivate::IrcConnectionPoolPrivate() : threadCount(QThread::idealThreadCount())
+{
+    if (threadCount < 1)
+        threadCount = 1;
+}
+
+void IrcConnectionPoolPrivate::startThreads()
+{
+    // threads are started on demand when the first connection is added
+    while (threads.count() < threadCount) {
+        QThread* thread = new QThread;
+        thread->setObjectName(QStringLiteral("IrcConnectionPool/%1").arg(threads.count()));
+        IrcConnectionPoolWorker* worker = new IrcConnectionPoolWorker;
+        worker->moveToThread(thread);
+        thread->start();
+        threads += thread;
+        workers += worker;
+        loads += 0;
+    }
+}
+
+int IrcConnectionPoolPrivate::leastLoaded() const
+{
+    int index = 0;
+    for (int i = 1; i < loads.count(); ++i) {
+        if (loads.at(i) < loads.at(index))
+            index = i;
+    }
+    return index;
+}
+
+void IrcConnectionPoolPrivate::receiveMessage(IrcMessage* message)
+{
+    // called in the thread of the connection
+    if (receivers.loadAcquire()) {
+        IrcMessage* copy = message->clone();
+        if (copy) {
+            copy->moveToThread(thread());
+            // queued calls are discarded with the pool, so it deletes the copies left behind
+            QMutexLocker locker(&mutex);
+            pending += copy;
+            locker.unlock();
+            QMetaObject::invokeMethod(this, "deliverMessage", Qt::QueuedConnection, Q_ARG(IrcMessage*, copy));
+        }
+    }
+}
+
+void IrcConnectionPoolPrivate::deliverMessage(IrcMessage* message)
+{
+    Q_Q(IrcConnectionPool);
+    QMutexLocker locker(&mutex);
+    pending.removeOne(message);
+    // the connection may have been destructed or removed in the meanwhile
+    IrcConnection* connection = message->connection();
+    const bool assigned = assignments.contains(connection);
+    locker.unlock();
+
+    if (assigned)
+        emit q->messageReceived(connection, message);
+    message->deleteLater();
+}
+
+void IrcConnectionPoolPrivate::connectionDestroyed(QObject* object)
+{
+    // called in the thread of the connection
+    QMutexLocker locker(&mutex);
+    IrcConnection* connection = static_cast<IrcConnection*>(object);
+    if (assignments.contains(connection)) {
+        --loads[assignments.take(connection)];
+        connections.removeOne(connection);
+    }
+}
+#endif // IRC_DOXYGEN
+
+/*!
+    Constructs a new connection pool with \a parent.
+ */
+IrcConnectionPool::IrcConnectionPool(QObject* parent) : QObject(parent), d_ptr(new IrcConnectionPoolPrivate)
+{
+    Q_D(IrcConnectionPool);
+    d->q_ptr = this;
+    qRegisterMetaType<IrcCommand*>();
+    qRegisterMetaType<IrcMessage*>();
+}
+
+/*!
+    Destructs the connection pool.
+
+    The connections in the pool are destructed in their worker threads,
+    and the worker threads are stopped.
+ */
+IrcConnectionPool::~IrcConnectionPool()
+{
+    Q_D(IrcConnectionPool);
+    QMutexLocker locker(&d->mutex);
+    foreach (IrcConnection* connection, d->connections) {
+        connection->disconnect(d);
+        connection->deleteLater();
+    }
+    d->connections.clear();
+    d->assignments.clear();
+    locker.unlock();
+
+    // pending deferred deletes are processed when the threads finish
+    for (int i = 0; i < d->threads.count(); ++i) {
+        d->workers.at(i)->deleteLater();
+        d->threads.at(i)->quit();
+    }
+    for (int i = 0; i < d->threads.count(); ++i) {
+        d->threads.at(i)->wait();
+        delete d->threads.at(i);
+    }
+
+    // the copies whose delivery was still queued
+    qDeleteAll(d->pending);
+    d->pending.clear();
+}
+
+/*!
+    This property holds the number of worker threads.
+
+    The default value is QThread::idealThreadCount(). The threads are started
+    when the first connection is added to the pool, and the thread count can
+    not be changed after that.
+
+    \par Access functions:
+    \li int <b>threadCount</b>() const
+    \li void <b>setThreadCount</b>(int count)
+ */
+int IrcConnectionPool::threadCount() const
+{
+    Q_D(const IrcConnectionPool);
+    return d->threadCount;
+}
+
+void IrcConnectionPool::setThreadCount(int count)
+{
+    Q_D(IrcConnectionPool);
+    QMutexLocker locker(&d->mutex);
+    if (!d->threads.isEmpty()) {
+        qWarning("IrcConnectionPool::setThreadCount(): cannot change the thread count of a running pool");
+        return;
+    }
+    d->threadCount = qMax(1, count);
+}
+
+/*!
+    This property holds the number of connections in the pool.
+
+    \par Access function:
+    \li int <b>count</b>() const
+ */
+int IrcConnectionPool::count() const
+{
+    Q_D(const IrcConnectionPool);
+    QMutexLocker locker(&d->mutex);
+    return d->connections.count();
+}
+
+/*!
+    Returns the connections in the pool.
+ */
+QList<IrcConnection*> IrcConnectionPool::connections() const
+{
+    Q_D(const IrcConnectionPool);
+    QMutexLocker locker(&d->mutex);
+    return d->connections;
+}
+
+/*!
+    Returns the number of connections assigned to the worker \a thread.
+
+    \sa threadCount
+ */
+int IrcConnectionPool::load(int thread) const
+{
+    Q_D(const IrcConnectionPool);
+    QMutexLocker locker(&d->mutex);
+    return d->loads.value(thread);
+}
+
+/*!
+    Adds a \a connection to the pool, and moves it to the least loaded worker thread.
+
+    The pool takes ownership of the \a connection. The connection must
+    live in the calling thread. It is recommended to add connections
+    before they are opened.
+
+    Returns \c true if the connection was added; otherwise \c false.
+
+    \sa removeConnection()
+ */
+bool IrcConnectionPool::addConnection(IrcConnection* connection)
+{
+    Q_D(IrcConnectionPool);
+    if (!connection)
+        return false;
+
+    if (connection->thread() != QThread::currentThread()) {
+        qWarning("IrcConnectionPool::addConnection(): the connection must live in the calling thread");
+        return false;
+    }
+
+    QMutexLocker locker(&d->mutex);
+    if (d->assignments.contains(connection))
+        return false;
+
+    d->startThreads();
+    const int index = d->leastLoaded();
+    d->assignments.insert(connection, index);
+    d->connections += connection;
+    ++d->loads[index];
+    locker.unlock();
+
+    connection->setParent(nullptr);
+    connect(connection, SIGNAL(messageReceived(IrcMessage*)), d, SLOT(receiveMessage(IrcMessage*)), Qt::DirectConnection);
+    connect(connection, SIGNAL(destroyed(QObject*)), d, SLOT(connectionDestroyed(QObject*)), Qt::DirectConnection);
+    connection->moveToThread(d->threads.at(index));
+    return true;
+}
+
+/*!
+    Removes a \a connection from the pool, and moves it back to the calling thread.
+
+    The ownership of the \a connection is transferred to the caller.
+    This function blocks until the worker thread of the connection
+    has moved the connection.
+
+    Returns \c true if the connection was removed; otherwise \c false.
+
+    \sa addConnection()
+ */
+bool IrcConnectionPool::removeConnection(IrcConnection* connection)
+{
+    Q_D(IrcConnectionPool);
+    QMutexLocker locker(&d->mutex);
+    if (!d->assignments.contains(connection))
+        return false;
+
+    const int index = d->assignments.take(connection);
+    d->connections.removeOne(connection);
+    --d->loads[index];
+    locker.unlock();
+
+    connection->disconnect(d);
+    if (connection->thread() != QThread::currentThread())
+        QMetaObject::invokeMethod(d->workers.at(index), "relocate", Qt::BlockingQueuedConnection,
+                                  Q_ARG(QObject*, connection), Q_ARG(QThread*, QThread::currentThread()));
+    return true;
+}
+
+/*!
+    Sends a \a command to the server of a \a connection.
+
+    This function is thread-safe. It is a convenience for the thread-safe
+    IrcConnection::sendCommand(), which queues the \a command when called
+    from another thread than the one of the \a connection.
+
+    Returns \c true if the command was sent or queued for sending; otherwise \c false.
+
+    \sa IrcConnection::sendCommand()
+ */
+bool IrcConnectionPool::sendCommand(IrcConnection* connection, IrcCommand* command)
+{
+    return connection && connection->sendCommand(command);
+}
+
+/*!
+    \reimp
+ */
+void IrcConnectionPool::connectNotify(const QMetaMethod& signal)
+{
+    Q_D(IrcConnectionPool);
+    if (signal == QMetaMethod::fromSignal(&IrcConnectionPool::messageReceived))
+        d->receivers.storeRelease(1);
+}
+
+/*!
+    \reimp
+ */
+void IrcConnectionPool::disconnectNotify(const QMetaMethod& signal)
+{
+    Q_D(IrcConnectionPool);
+    // the signal is invalid when everything was disconnected at once
+    if (!signal.isValid() || signal == QMetaMethod::fromSignal(&IrcConnectionPool::messageReceived))
+        d->receivers.storeRelease(receivers(SIGNAL(messageReceived(IrcConnection*,IrcMessage*))) > 0);
+}
+
+#include "moc_ircconnectionpool.cpp"
+#include "moc_ircconnectionpool_p.cpp"
+
+IRC_END_NAMESPACE
@@ -29,14 +29,20 @@
 #include "irclagtimer.h"
 #include "irclagtimer_p.h"
 #include "ircconnection.h"
+#include "ircconnectionstatistics_p.h"
 #include "ircmessage.h"
 #include "irccommand.h"
-#include <QDateTime>
+#include "ircclock.h"
+#include <algorithm>
 
 IRC_BEGIN_NAMESPACE
 
 static const int DEFAULT_INTERVAL = 60;
 
+// how many lost probes are remembered, so that their
+// late replies are recognized and consumed
+static const int MAX_LOST_PROBES = 16;
+
 /*!
     \file irclagtimer.h
     \brief \#include &lt;IrcLagTimer&gt;
@@ -47,6 +53,27 @@ static const int DEFAULT_INTERVAL = 60;
     \ingroup util
     \brief Provides a timer for measuring lag.
 
+    IrcLagTimer sends a \c PING probe to the server every \ref interval
+    "interval" seconds. Each probe carries a unique token, so that its
+    \c PONG reply is matched exactly. Up to \ref maximumProbes "maximumProbes"
+    probes may be in flight at a time. A probe that is still unanswered when
+    a later one is answered, or that is pushed out by newer probes, counts
+    as \ref lostProbes "lost".
+
+    The \ref lag "lag" is the round trip time of the latest answered probe,
+    or the age of the oldest unanswered probe if that is longer. The round
+    trip times of the last \ref window "window" probes are kept, and are
+    available as roundTripTimes() and percentile(). Each round trip time is
+    also added to the IrcConnectionStatistics::RoundTripTime histogram of
+    the connection.
+
+    \code
+    IrcLagTimer* timer = new IrcLagTimer(connection);
+    timer->setInterval(10);
+    // ...
+    qDebug() << "p50:" << timer->percentile(50) << "p99:" << timer->percentile(99);
+    \endcode
+
     \note IrcLagTimer relies on functionality introduced in Qt 4.7.0, and is
           therefore not functional when built against earlier versions of Qt.
  */
@@ -75,12 +102,19 @@ bool IrcLagTimerPrivate::processPongReply(IrcPongMessage* msg)
     // TODO: configurable format?
     if (msg->argument().startsWith(QLatin1String("communi/"))) {
         bool ok = false;
-        qint64 timestamp = msg->argument().mid(8).toLongLong(&ok);
-        if (ok) {
-            --pendingPings;
-            updateLag(QDateTime::currentMSecsSinceEpoch() - timestamp);
+        const quint32 token = msg->argument().mid(8).toUInt(&ok);
+        if (!ok)
+            return false;
+        if (probes.contains(token)) {
+            const qint64 rtt = connection->clock()->elapsed() - probes.value(token);
+            // servers reply in order, so the probes sent earlier are lost
+            while (probes.firstKey() != token)
+                loseProbe(probes.firstKey());
+            probes.remove(token);
+            addRoundTrip(rtt);
             return true;
         }
+        return lost.removeOne(token);
     }
 #endif // QT_VERSION
     return false;
@@ -89,22 +123,37 @@ bool IrcLagTimerPrivate::processPongReply(IrcPongMessage* msg)
 void IrcLagTimerPrivate::_irc_connected()
 {
 #if QT_VERSION >= 0x040700
-    pendingPings = 0;
-    if (interval > 0)
+    resetProbes();
+    roundTrips.clear();
+    lostProbes = 0;
+    if (interval > 0) {
+        timer.setClock(connection->clock());
         timer.start();
+    }
 #endif // QT_VERSION
 }
 
 void IrcLagTimerPrivate::_irc_pingServer()
 {
 #if QT_VERSION >= 0x040700
+    static QBasicAtomicInteger<quint32> serial = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+    const qint64 now = connection->clock()->elapsed();
+
+    // the oldest unanswered probe tells that the lag is at least this much
+    if (!probes.isEmpty()) {
+        const qint64 age = now - probes.first();
+        if (lag > -1 && age > lag)
+            updateLag(age);
+    }
+
+    while (probes.count() >= maximumProbes)
+        loseProbe(probes.firstKey());
+
     // TODO: configurable format?
-    QString cmd = QStringLiteral("PING communi/%1").arg(QDateTime::currentMSecsSinceEpoch());
-    connection->sendData(cmd.toUtf8());
-    qint64 pingLag = pendingPings * interval * 1000ll;
-    if (lag > -1 && pingLag > lag)
-        updateLag(pingLag);
-    ++pendingPings;
+    const quint32 token = serial.fetchAndAddRelaxed(1) + 1;
+    probes.insert(token, now);
+    connection->sendData("PING communi/" + QByteArray::number(token));
 #endif // QT_VERSION
 }
 
@@ -112,7 +161,7 @@ void IrcLagTimerPrivate::_irc_disconnected()
 {
 #if QT_VERSION >= 0x040700
     updateLag(-1);
-    pendingPings = 0;
+    resetProbes();
     if (timer.isActive())
         timer.stop();
 #endif // QT_VERSION
@@ -122,6 +171,7 @@ void IrcLagTimerPrivate::updateTimer()
 {
 #if QT_VERSION >= 0x040700
     if (connection && interval > 0) {
+        timer.setClock(connection->clock());
         timer.setInterval(interval * 1000);
         if (!timer.isActive() && connection->isConnected())
             timer.start();
@@ -139,9 +189,35 @@ void IrcLagTimerPrivate::updateLag(qint64 value)
     value = qMax(-1ll, value);
     if (lag != value) {
         lag = value;
+        if (connection)
+            IrcConnectionStatisticsPrivate::get(connection->statistics())->setLag(lag);
         emit q->lagChanged(lag);
     }
 }
+
+void IrcLagTimerPrivate::resetProbes()
+{
+    probes.clear();
+    lost.clear();
+}
+
+void IrcLagTimerPrivate::loseProbe(quint32 token)
+{
+    probes.remove(token);
+    lost.append(token);
+    while (lost.count() > MAX_LOST_PROBES)
+        lost.removeFirst();
+    ++lostProbes;
+}
+
+void IrcLagTimerPrivate::addRoundTrip(qint64 rtt)
+{
+    roundTrips.append(rtt);
+    while (roundTrips.count() > window)
+        roundTrips.removeFirst();
+    IrcConnectionStatisticsPrivate::get(connection->statistics())->addRoundTripTime(rtt);
+    updateLag(rtt);
+}
 #endif // IRC_DOXYGEN
 
 /*!
@@ -188,6 +264,9 @@ void IrcLagTimer::setConnection(IrcConnection* connection)
             disconnect(d->connection, SIGNAL(disconnected()), this, SLOT(_irc_disconnected()));
         }
         d->connection = connection;
+        d->resetProbes();
+        d->roundTrips.clear();
+        d->lostProbes = 0;
         if (connection) {
             connection->installMessageFilter(d);
             connect(connection, SIGNAL(connected()), this, SLOT(_irc_connected()));
@@ -244,6 +323,119 @@ void IrcLagTimer::setInterval(int seconds)
     }
 }
 
+/*!
+    \since 3.8
+
+    This property holds the maximum number of lag probes in flight.
+
+    When a probe is due while this many probes are still unanswered,
+    the oldest one is considered lost. The default value is \c 3.
+
+    \par Access functions:
+    \li int <b>maximumProbes</b>() const
+    \li void <b>setMaximumProbes</b>(int probes)
+ */
+int IrcLagTimer::maximumProbes() const
+{
+    Q_D(const IrcLagTimer);
+    return d->maximumProbes;
+}
+
+void IrcLagTimer::setMaximumProbes(int probes)
+{
+    Q_D(IrcLagTimer);
+    d->maximumProbes = qMax(1, probes);
+}
+
+/*!
+    \since 3.8
+
+    This property holds the number of lag probes waiting for a reply.
+
+    \par Access function:
+    \li int <b>pendingProbes</b>() const
+ */
+int IrcLagTimer::pendingProbes() const
+{
+    Q_D(const IrcLagTimer);
+    return d->probes.count();
+}
+
+/*!
+    \since 3.8
+
+    This property holds the number of lag probes lost since the connection was established.
+
+    \par Access function:
+    \li int <b>lostProbes</b>() const
+ */
+int IrcLagTimer::lostProbes() const
+{
+    Q_D(const IrcLagTimer);
+    return d->lostProbes;
+}
+
+/*!
+    \since 3.8
+
+    This property holds the number of most recent round trip times kept.
+
+    The percentiles are calculated over this sliding window.
+    The default value is \c 100.
+
+    \par Access functions:
+    \li int <b>window</b>() const
+    \li void <b>setWindow</b>(int samples)
+
+    \sa roundTripTimes(), percentile()
+ */
+int IrcLagTimer::window() const
+{
+    Q_D(const IrcLagTimer);
+    return d->window;
+}
+
+void IrcLagTimer::setWindow(int samples)
+{
+    Q_D(IrcLagTimer);
+    d->window = qMax(1, samples);
+    while (d->roundTrips.count() > d->window)
+        d->roundTrips.removeFirst();
+}
+
+/*!
+    \since 3.8
+
+    Returns the round trip times in the \ref window "window", in milliseconds, oldest first.
+ */
+QList<qint64> IrcLagTimer::roundTripTimes() const
+{
+    Q_D(const IrcLagTimer);
+    return d->roundTrips;
+}
+
+/*!
+    \since 3.8
+
+    Returns the \a percent percentile of the round trip times in
+    the \ref window "window", in milliseconds, or \c -1 if no round
+    trip time has been measured since the connection was established.
+
+    For example, \c percentile(99) returns the round trip time that
+    99% of the probes in the window did not exceed.
+ */
+qint64 IrcLagTimer::percentile(int percent) const
+{
+    Q_D(const IrcLagTimer);
+    if (d->roundTrips.isEmpty())
+        return -1;
+    QList<qint64> sorted = d->roundTrips;
+    std::sort(sorted.begin(), sorted.end());
+    // nearest rank
+    const int rank = (qBound(0, percent, 100) * sorted.count() + 99) / 100;
+    return sorted.at(qBound(0, rank - 1, sorted.count() - 1));
+}
+
 #include "moc_irclagtimer.cpp"
 #include "moc_irclagtimer_p.cpp"
 
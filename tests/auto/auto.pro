@@ -6,10 +6,15 @@ TEMPLATE = subdirs
 
 # IrcCore
 SUBDIRS += irc
+SUBDIRS += ircclock
 SUBDIRS += ircconnection
 SUBDIRS += irccommand
+SUBDIRS += ircdebug
 SUBDIRS += ircmessage
 SUBDIRS += ircnetwork
+SUBDIRS += ircreconnectpolicy
+SUBDIRS += irctrace
+SUBDIRS += irctraffic
 
 # IrcModel
 SUBDIRS += ircbuffer
@@ -22,6 +27,7 @@ SUBDIRS += ircusermodel
 SUBDIRS += irccommandparser
 SUBDIRS += irccommandqueue
 SUBDIRS += irccompleter
+SUBDIRS += ircconnectionpool
 SUBDIRS += irclagtimer
 SUBDIRS += ircpalette
 SUBDIRS += irctextformat
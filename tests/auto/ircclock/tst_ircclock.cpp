@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2008-2020 The Communi Project
+ *
+ * This test is free, and not covered by the BSD license. There is no
+ * restriction applied to their modification, redistribution, using and so on.
+ * You can study them, modify them, use them in your own program - either
+ * completely or partially.
+ */
+
+#include "ircclock.h"
+#include "irctimer_p.h"
+#include "ircconnection.h"
+#include <QtTest/QtTest>
+
+class tst_IrcClock : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void record() { fired += sender() ? sender()->objectName() : QString(); }
+    void tick() { ++ticks; }
+
+private slots:
+    void testDefaults();
+    void testAdvance();
+    void testRepeat();
+    void testSingleShot();
+    void testConnection();
+
+private:
+    QStringList fired;
+    int ticks = 0;
+};
+
+void tst_IrcClock::testDefaults()
+{
+    QVERIFY(IrcClock::system());
+    QCOMPARE(IrcClock::system()->mode(), IrcClock::RealTime);
+
+    IrcClock real;
+    QCOMPARE(real.mode(), IrcClock::RealTime);
+    QCOMPARE(real.pendingTimers(), 0);
+    QVERIFY(real.elapsed() >= 0);
+
+    IrcClock clock(IrcClock::VirtualTime);
+    QCOMPARE(clock.mode(), IrcClock::VirtualTime);
+    QCOMPARE(clock.elapsed(), 0ll);
+    QCOMPARE(clock.pendingTimers(), 0);
+    QVERIFY(!clock.advanceToNextTimer());
+
+    const qint64 epoch = clock.currentMSecsSinceEpoch();
+    clock.advance(60 * 60 * 1000);
+    QCOMPARE(clock.elapsed(), 60ll * 60 * 1000);
+    QCOMPARE(clock.currentMSecsSinceEpoch(), epoch + 60 * 60 * 1000);
+    QCOMPARE(clock.currentDateTime().toMSecsSinceEpoch(), epoch + 60 * 60 * 1000);
+}
+
+void tst_IrcClock::testAdvance()
+{
+    IrcClock clock(IrcClock::VirtualTime);
+    fired.clear();
+
+    IrcTimer a, b, c;
+    a.setObjectName("a");
+    b.setObjectName("b");
+    c.setObjectName("c");
+    foreach (IrcTimer* timer, QList<IrcTimer*>() << &a << &b << &c) {
+        timer->setClock(&clock);
+        timer->setSingleShot(true);
+        connect(timer, SIGNAL(timeout()), this, SLOT(record()));
+    }
+
+    c.start(3000);
+    a.start(1000);
+    b.start(1000);
+    QCOMPARE(clock.pendingTimers(), 3);
+    QVERIFY(a.isActive());
+    QCOMPARE(a.remainingTime(), 1000);
+
+    clock.advance(999);
+    QVERIFY(fired.isEmpty());
+    QCOMPARE(a.remainingTime(), 1);
+
+    // due at the same time: in the order they were started
+    clock.advance(1);
+    QCOMPARE(fired, QStringList() << "a" << "b");
+    QVERIFY(!a.isActive());
+    QCOMPARE(a.remainingTime(), -1);
+    QCOMPARE(clock.pendingTimers(), 1);
+
+    c.stop();
+    QCOMPARE(clock.pendingTimers(), 0);
+    clock.advance(5000);
+    QCOMPARE(fired, QStringList() << "a" << "b");
+
+    QVERIFY(!clock.advanceToNextTimer());
+    b.start(250);
+    QVERIFY(clock.advanceToNextTimer());
+    QCOMPARE(clock.elapsed(), 6250ll);
+    QCOMPARE(fired, QStringList() << "a" << "b" << "b");
+}
+
+void tst_IrcClock::testRepeat()
+{
+    IrcClock clock(IrcClock::VirtualTime);
+    ticks = 0;
+
+    IrcTimer timer;
+    timer.setClock(&clock);
+    timer.setInterval(100);
+    connect(&timer, SIGNAL(timeout()), this, SLOT(tick()));
+    timer.start();
+
+    clock.advance(1000);
+    QCOMPARE(ticks, 10);
+    QVERIFY(timer.isActive());
+
+    clock.advance(50);
+    QCOMPARE(ticks, 10);
+    QCOMPARE(timer.remainingTime(), 50);
+
+    timer.stop();
+    clock.advance(1000);
+    QCOMPARE(ticks, 10);
+
+    // a zero interval must not spin forever
+    timer.setInterval(0);
+    timer.start();
+    clock.advance(10);
+    QCOMPARE(ticks, 21);
+}
+
+void tst_IrcClock::testSingleShot()
+{
+    IrcClock clock(IrcClock::VirtualTime);
+    ticks = 0;
+
+    IrcTimer::singleShot(&clock, 500, this, SLOT(tick()));
+    IrcTimer::singleShot(&clock, 1500, this, SLOT(tick()));
+    QCOMPARE(clock.pendingTimers(), 2);
+
+    clock.advance(1000);
+    QCOMPARE(ticks, 1);
+    QCOMPARE(clock.pendingTimers(), 1);
+
+    clock.advance(1000);
+    QCOMPARE(ticks, 2);
+    QCOMPARE(clock.pendingTimers(), 0);
+
+    // real time: a plain QTimer
+    IrcTimer::singleShot(nullptr, 0, this, SLOT(tick()));
+    QTRY_COMPARE(ticks, 3);
+}
+
+void tst_IrcClock::testConnection()
+{
+    IrcConnection connection;
+    QCOMPARE(connection.clock(), IrcClock::system());
+
+    qRegisterMetaType<IrcClock*>();
+    QSignalSpy spy(&connection, SIGNAL(clockChanged(IrcClock*)));
+    QVERIFY(spy.isValid());
+
+    IrcClock clock(IrcClock::VirtualTime);
+    connection.setClock(&clock);
+    QCOMPARE(connection.clock(), &clock);
+    QCOMPARE(spy.count(), 1);
+
+    connection.setClock(&clock);
+    QCOMPARE(spy.count(), 1);
+
+    QScopedPointer<IrcConnection> clone(connection.clone());
+    QCOMPARE(clone->clock(), &clock);
+
+    connection.setClock(nullptr);
+    QCOMPARE(connection.clock(), IrcClock::system());
+    QCOMPARE(spy.count(), 2);
+}
+
+QTEST_MAIN(tst_IrcClock)
+
+#include "tst_ircclock.moc"
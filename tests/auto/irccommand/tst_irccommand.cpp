@@ -62,6 +62,8 @@ private slots:
     void testWhois();
     void testWhowas();
 
+    void testPacked();
+
     void testDebug();
 };
 
@@ -541,6 +543,58 @@ void tst_IrcCommand::testWhowas()
     QVERIFY(cmd->toString().contains(QRegularExpression("\\bmask\\b")));
 }
 
+void tst_IrcCommand::testPacked()
+{
+    QList<IrcCommand*> cmds;
+
+    // keyed channels first
+    cmds = IrcCommand::createPacked(IrcCommand::Join, QStringList() << "#a" << "#b" << "#c", QStringList() << QString() << "key");
+    QCOMPARE(cmds.count(), 1);
+    QCOMPARE(cmds.first()->toString(), QString("JOIN #b,#a,#c key"));
+    qDeleteAll(cmds);
+
+    cmds = IrcCommand::createPacked(IrcCommand::Part, QStringList() << "#a" << "#b", QStringList() << "bye");
+    QCOMPARE(cmds.count(), 1);
+    QCOMPARE(cmds.first()->toString(), QString("PART #a,#b :bye"));
+    qDeleteAll(cmds);
+
+    cmds = IrcCommand::createPacked(IrcCommand::Monitor, QStringList() << "a" << "b", QStringList() << "+");
+    QCOMPARE(cmds.count(), 1);
+    QCOMPARE(cmds.first()->toString(), QString("MONITOR + a,b"));
+    qDeleteAll(cmds);
+
+    // no multiple message targets unless allowed by TARGMAX
+    cmds = IrcCommand::createPacked(IrcCommand::Message, QStringList() << "#a" << "#b", QStringList() << "hi");
+    QCOMPARE(cmds.count(), 2);
+    QCOMPARE(cmds.at(0)->toString(), QString("PRIVMSG #a :hi"));
+    QCOMPARE(cmds.at(1)->toString(), QString("PRIVMSG #b :hi"));
+    qDeleteAll(cmds);
+
+    // 400 channels, 50 bytes each (including the comma)
+    QStringList chans;
+    for (int i = 0; i < 400; ++i)
+        chans += QString("#%1").arg(i, 48, 10, QChar('0'));
+    cmds = IrcCommand::createPacked(IrcCommand::Join, chans);
+    QCOMPARE(cmds.count(), 40);
+    int joined = 0;
+    foreach (IrcCommand* cmd, cmds) {
+        QVERIFY(cmd->toString().toUtf8().size() + 2 <= 512);
+        joined += cmd->toString().count(",") + 1;
+    }
+    QCOMPARE(joined, 400);
+    qDeleteAll(cmds);
+
+    // multi-byte characters are counted as encoded bytes
+    chans.clear();
+    for (int i = 0; i < 10; ++i)
+        chans += "#" + QString(50, QChar(0x00e4));
+    cmds = IrcCommand::createPacked(IrcCommand::Names, chans);
+    QCOMPARE(cmds.count(), 3);
+    foreach (IrcCommand* cmd, cmds)
+        QVERIFY(cmd->toString().toUtf8().size() + 2 <= 512);
+    qDeleteAll(cmds);
+}
+
 void tst_IrcCommand::testDebug()
 {
     QString str;
@@ -8,6 +8,7 @@
  */
 
 #include "irccommandqueue.h"
+#include "ircclock.h"
 #include "ircconnection.h"
 #include "irccommand.h"
 #include "ircfilter.h"
@@ -21,15 +22,28 @@ class tst_IrcCommandQueue : public tst_IrcClientServer
     Q_OBJECT
 
 private slots:
+    void testMode();
     void testBatch();
     void testInterval();
+    void testBucket();
     void testConnection();
     void testSize();
     void testClear();
     void testFlush();
     void testQuit();
+    void testTokenBucket();
+    void testPriority();
+    void testTargetOrder();
 };
 
+void tst_IrcCommandQueue::testMode()
+{
+    IrcCommandQueue queue;
+    QCOMPARE(queue.mode(), IrcCommandQueue::Batch);
+    queue.setMode(IrcCommandQueue::TokenBucket);
+    QCOMPARE(queue.mode(), IrcCommandQueue::TokenBucket);
+}
+
 void tst_IrcCommandQueue::testBatch()
 {
     IrcCommandQueue queue;
@@ -46,6 +60,26 @@ void tst_IrcCommandQueue::testInterval()
     QCOMPARE(queue.interval(), 5);
 }
 
+void tst_IrcCommandQueue::testBucket()
+{
+    IrcCommandQueue queue;
+    QCOMPARE(queue.burst(), 10.0);
+    queue.setBurst(5.0);
+    QCOMPARE(queue.burst(), 5.0);
+
+    QCOMPARE(queue.rate(), 1.0);
+    queue.setRate(2.5);
+    QCOMPARE(queue.rate(), 2.5);
+
+    QCOMPARE(queue.commandCost(), 1.0);
+    queue.setCommandCost(2.0);
+    QCOMPARE(queue.commandCost(), 2.0);
+
+    QCOMPARE(queue.byteCost(), 1.0 / 120.0);
+    queue.setByteCost(0.0);
+    QCOMPARE(queue.byteCost(), 0.0);
+}
+
 void tst_IrcCommandQueue::testConnection()
 {
     IrcConnection connection1;
@@ -144,6 +178,164 @@ void tst_IrcCommandQueue::testQuit()
     QCOMPARE(queue.size(), 0);
 }
 
+void tst_IrcCommandQueue::testTokenBucket()
+{
+    IrcClock clock(IrcClock::VirtualTime);
+    connection->setClock(&clock);
+
+    TestCommandFilter filter(connection);
+    IrcCommandQueue queue(connection);
+    queue.setMode(IrcCommandQueue::TokenBucket);
+    queue.setBurst(3.0);
+    queue.setRate(1.0);
+    queue.setCommandCost(1.0);
+    queue.setByteCost(0.0);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+
+    filter.commands.clear();
+
+    // the burst is sent right away
+    for (int i = 0; i < 5; ++i)
+        connection->sendCommand(IrcCommand::createAway());
+
+    QCOMPARE(filter.commands.size(), 3);
+    QCOMPARE(queue.size(), 2);
+
+    // ...and the rest as soon as the bucket has refilled
+    clock.advance(999);
+    QCOMPARE(queue.size(), 2);
+    clock.advance(1);
+    QCOMPARE(queue.size(), 1);
+    QCOMPARE(filter.commands.size(), 4);
+    clock.advance(1000);
+    QCOMPARE(queue.size(), 0);
+    QCOMPARE(filter.commands.size(), 5);
+
+    // commands with a foreign parent are sent right away, but the
+    // queued commands wait for the debt they leave behind
+    QObject owner;
+    IrcCommand* command = IrcCommand::createAway();
+    command->setParent(&owner);
+    connection->sendCommand(command);
+    QCOMPARE(filter.commands.size(), 6);
+
+    connection->sendCommand(IrcCommand::createAway());
+    QCOMPARE(queue.size(), 1);
+    clock.advance(1999);
+    QCOMPARE(queue.size(), 1);
+    clock.advance(1);
+    QCOMPARE(queue.size(), 0);
+    QCOMPARE(filter.commands.size(), 7);
+
+    // ...which is bounded by the burst
+    for (int i = 0; i < 10; ++i) {
+        command = IrcCommand::createAway();
+        command->setParent(&owner);
+        connection->sendCommand(command);
+    }
+    QCOMPARE(filter.commands.size(), 17);
+
+    connection->sendCommand(IrcCommand::createAway());
+    QCOMPARE(queue.size(), 1);
+    clock.advance(3999);
+    QCOMPARE(queue.size(), 1);
+    clock.advance(1);
+    QCOMPARE(queue.size(), 0);
+    QCOMPARE(filter.commands.size(), 18);
+
+    connection->setClock(nullptr);
+}
+
+void tst_IrcCommandQueue::testPriority()
+{
+    TestCommandFilter filter(connection);
+    IrcCommandQueue queue(connection);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+
+    filter.commands.clear();
+
+    connection->sendCommand(IrcCommand::createMessage("#a", "1"));
+    connection->sendCommand(IrcCommand::createMessage("#a", "2"));
+    connection->sendCommand(IrcCommand::createMessage("#a", "3"));
+    connection->sendCommand(IrcCommand::createMessage("#b", "4"));
+    connection->sendCommand(IrcCommand::createJoin("#c"));
+    connection->sendCommand(IrcCommand::createNick("other"));
+
+    QCOMPARE(queue.size(), 6);
+    QCOMPARE(queue.depth(IrcCommandQueue::HighPriority), 1);
+    QCOMPARE(queue.depth(IrcCommandQueue::NormalPriority), 1);
+    QCOMPARE(queue.depth(IrcCommandQueue::LowPriority), 4);
+    QVERIFY(queue.waitTime(IrcCommandQueue::LowPriority) >= 0);
+
+    queue.flush();
+    QCOMPARE(queue.size(), 0);
+    QCOMPARE(queue.depth(IrcCommandQueue::LowPriority), 0);
+    QCOMPARE(queue.waitTime(IrcCommandQueue::LowPriority), 0ll);
+
+    QCOMPARE(filter.commands.size(), 6);
+    QCOMPARE(filter.commands.at(0)->type(), IrcCommand::Nick);
+    QCOMPARE(filter.commands.at(1)->type(), IrcCommand::Join);
+    QCOMPARE(filter.commands.at(2)->parameters().value(1), QString("1"));
+    QCOMPARE(filter.commands.at(3)->parameters().value(1), QString("4"));
+    QCOMPARE(filter.commands.at(4)->parameters().value(1), QString("2"));
+    QCOMPARE(filter.commands.at(5)->parameters().value(1), QString("3"));
+
+    // customized priorities
+    QCOMPARE(queue.priority(IrcCommand::Nick), IrcCommandQueue::HighPriority);
+    QCOMPARE(queue.priority(IrcCommand::Join), IrcCommandQueue::NormalPriority);
+    QCOMPARE(queue.priority(IrcCommand::Message), IrcCommandQueue::LowPriority);
+    queue.setPriority(IrcCommand::Message, IrcCommandQueue::HighPriority);
+    QCOMPARE(queue.priority(IrcCommand::Message), IrcCommandQueue::HighPriority);
+
+    filter.commands.clear();
+    connection->sendCommand(IrcCommand::createJoin("#d"));
+    connection->sendCommand(IrcCommand::createMessage("#e", "5"));
+    QCOMPARE(queue.depth(IrcCommandQueue::HighPriority), 1);
+    QCOMPARE(queue.depth(IrcCommandQueue::NormalPriority), 1);
+
+    queue.flush();
+    QCOMPARE(filter.commands.size(), 2);
+    QCOMPARE(filter.commands.at(0)->type(), IrcCommand::Message);
+    QCOMPARE(filter.commands.at(1)->type(), IrcCommand::Join);
+}
+
+void tst_IrcCommandQueue::testTargetOrder()
+{
+    TestCommandFilter filter(connection);
+    IrcCommandQueue queue(connection);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+
+    filter.commands.clear();
+
+    // a part must not overtake the last messages to the channel
+    connection->sendCommand(IrcCommand::createMessage("#c", "bye"));
+    connection->sendCommand(IrcCommand::createPart("#C"));
+    connection->sendCommand(IrcCommand::createJoin("#d"));
+    connection->sendCommand(IrcCommand::createMessage("#d", "hi"));
+    connection->sendCommand(IrcCommand::createTopic("#d", "topic"));
+    QCOMPARE(queue.depth(IrcCommandQueue::NormalPriority), 1);
+    QCOMPARE(queue.depth(IrcCommandQueue::LowPriority), 4);
+
+    queue.flush();
+    QCOMPARE(filter.commands.size(), 5);
+    QCOMPARE(filter.commands.at(0)->type(), IrcCommand::Join);
+    QCOMPARE(filter.commands.at(1)->type(), IrcCommand::Message);
+    QCOMPARE(filter.commands.at(1)->parameters().value(1), QString("bye"));
+    QCOMPARE(filter.commands.at(2)->type(), IrcCommand::Message);
+    QCOMPARE(filter.commands.at(2)->parameters().value(1), QString("hi"));
+    QCOMPARE(filter.commands.at(3)->type(), IrcCommand::Part);
+    QCOMPARE(filter.commands.at(4)->type(), IrcCommand::Topic);
+}
+
 QTEST_MAIN(tst_IrcCommandQueue)
 
 #include "tst_irccommandqueue.moc"
@@ -0,0 +1,7 @@
+######################################################################
+# Communi
+######################################################################
+
+SOURCES += tst_ircconnectionpool.cpp
+
+include(../auto.pri)
@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2008-2020 The Communi Project
+ *
+ * This test is free, and not covered by the BSD license. There is no
+ * restriction applied to their modification, redistribution, using and so on.
+ * You can study them, modify them, use them in your own program - either
+ * completely or partially.
+ */
+
+#include "ircconnectionpool.h"
+#include "ircconnectionpool_p.h"
+#include "ircconnection.h"
+#include "irccommand.h"
+#include "ircmessage.h"
+#include <QtTest/QtTest>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+
+// waits without processing the events of this thread, where the copies are delivered
+static QList<QPointer<IrcMessage> > waitForPending(IrcConnectionPool* pool, int count)
+{
+    IrcConnectionPoolPrivate* d = IrcConnectionPoolPrivate::get(pool);
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < 5000) {
+        QMutexLocker locker(&d->mutex);
+        if (d->pending.count() >= count) {
+            QList<QPointer<IrcMessage> > pending;
+            foreach (IrcMessage* message, d->pending)
+                pending += message;
+            return pending;
+        }
+        locker.unlock();
+        QThread::msleep(10);
+    }
+    return QList<QPointer<IrcMessage> >();
+}
+
+class tst_IrcConnectionPool : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testDefaults();
+    void testThreadCount();
+    void testAddRemove();
+    void testLoad();
+    void testDestroyed();
+    void testTraffic();
+    void testUndelivered();
+};
+
+void tst_IrcConnectionPool::testDefaults()
+{
+    IrcConnectionPool pool;
+    QCOMPARE(pool.threadCount(), qMax(1, QThread::idealThreadCount()));
+    QCOMPARE(pool.count(), 0);
+    QVERIFY(pool.connections().isEmpty());
+    QCOMPARE(pool.load(0), 0);
+}
+
+void tst_IrcConnectionPool::testThreadCount()
+{
+    IrcConnectionPool pool;
+    pool.setThreadCount(0);
+    QCOMPARE(pool.threadCount(), 1);
+    pool.setThreadCount(3);
+    QCOMPARE(pool.threadCount(), 3);
+
+    QVERIFY(pool.addConnection(new IrcConnection));
+
+    // cannot be changed after the threads have been started
+    QTest::ignoreMessage(QtWarningMsg, "IrcConnectionPool::setThreadCount(): cannot change the thread count of a running pool");
+    pool.setThreadCount(5);
+    QCOMPARE(pool.threadCount(), 3);
+}
+
+void tst_IrcConnectionPool::testAddRemove()
+{
+    IrcConnectionPool pool;
+    pool.setThreadCount(2);
+
+    QVERIFY(!pool.addConnection(nullptr));
+
+    IrcConnection* connection = new IrcConnection(this);
+    QVERIFY(pool.addConnection(connection));
+    QVERIFY(!pool.addConnection(connection));
+    QCOMPARE(pool.count(), 1);
+    QCOMPARE(pool.connections(), QList<IrcConnection*>() << connection);
+
+    // moved to a worker thread together with its children
+    QVERIFY(!connection->parent());
+    QVERIFY(connection->thread() != QThread::currentThread());
+    QCOMPARE(connection->socket()->thread(), connection->thread());
+    QCOMPARE(connection->protocol()->thread(), connection->thread());
+    QCOMPARE(connection->network()->thread(), connection->thread());
+
+    QVERIFY(pool.removeConnection(connection));
+    QVERIFY(!pool.removeConnection(connection));
+    QCOMPARE(pool.count(), 0);
+    QCOMPARE(connection->thread(), QThread::currentThread());
+    QCOMPARE(connection->socket()->thread(), QThread::currentThread());
+    delete connection;
+}
+
+void tst_IrcConnectionPool::testLoad()
+{
+    IrcConnectionPool pool;
+    pool.setThreadCount(3);
+
+    for (int i = 0; i < 7; ++i)
+        QVERIFY(pool.addConnection(new IrcConnection));
+
+    QCOMPARE(pool.count(), 7);
+    QCOMPARE(pool.load(0), 3);
+    QCOMPARE(pool.load(1), 2);
+    QCOMPARE(pool.load(2), 2);
+
+    QSet<QThread*> threads;
+    foreach (IrcConnection* connection, pool.connections())
+        threads.insert(connection->thread());
+    QCOMPARE(threads.count(), 3);
+
+    // the next one goes to the least loaded thread
+    IrcConnection* connection = pool.connections().first();
+    QVERIFY(pool.removeConnection(connection));
+    QCOMPARE(pool.load(0), 2);
+    QVERIFY(pool.addConnection(connection));
+    QCOMPARE(pool.load(0), 3);
+    QCOMPARE(pool.load(1), 2);
+    QCOMPARE(pool.load(2), 2);
+}
+
+void tst_IrcConnectionPool::testDestroyed()
+{
+    IrcConnectionPool pool;
+    pool.setThreadCount(1);
+
+    IrcConnection* connection = new IrcConnection;
+    QVERIFY(pool.addConnection(connection));
+    QCOMPARE(pool.count(), 1);
+
+    connection->deleteLater();
+    QTRY_COMPARE(pool.count(), 0);
+    QCOMPARE(pool.load(0), 0);
+}
+
+void tst_IrcConnectionPool::testTraffic()
+{
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    IrcConnectionPool pool;
+    pool.setThreadCount(2);
+
+    QList<IrcMessage::Type> types;
+    QList<QThread*> threads;
+    connect(&pool, &IrcConnectionPool::messageReceived, [&](IrcConnection*, IrcMessage* message) {
+        types += message->type();
+        threads += message->thread();
+    });
+
+    IrcConnection* connection = new IrcConnection(QStringLiteral("127.0.0.1"));
+    connection->setPort(server.serverPort());
+    connection->setUserName(QStringLiteral("user"));
+    connection->setNickName(QStringLiteral("nick"));
+    connection->setRealName(QStringLiteral("real"));
+    QVERIFY(pool.addConnection(connection));
+    QVERIFY(QMetaObject::invokeMethod(connection, "open", Qt::QueuedConnection));
+
+    QVERIFY(server.waitForNewConnection(1000));
+    QTcpSocket* socket = server.nextPendingConnection();
+    QVERIFY(socket);
+
+    QByteArray written;
+    QTRY_VERIFY((written += socket->readAll()).contains("NICK nick"));
+
+    socket->write(":irc.ser.ver 001 nick :Welcome to the Internet Relay Network nick\r\n");
+    QTRY_COMPARE(types.count(), 1);
+    QCOMPARE(types.first(), IrcMessage::Numeric);
+    QCOMPARE(threads.first(), QThread::currentThread());
+
+    QVERIFY(pool.sendCommand(connection, IrcCommand::createMessage(QStringLiteral("#communi"), QStringLiteral("hello"))));
+    QTRY_VERIFY((written += socket->readAll()).contains("PRIVMSG #communi :hello"));
+}
+
+void tst_IrcConnectionPool::testUndelivered()
+{
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    IrcConnectionPool* pool = new IrcConnectionPool;
+    pool->setThreadCount(1);
+
+    int received = 0;
+    connect(pool, &IrcConnectionPool::messageReceived, [&](IrcConnection*, IrcMessage*) {
+        ++received;
+    });
+
+    IrcConnection* connection = new IrcConnection(QStringLiteral("127.0.0.1"));
+    connection->setPort(server.serverPort());
+    connection->setUserName(QStringLiteral("user"));
+    connection->setNickName(QStringLiteral("nick"));
+    connection->setRealName(QStringLiteral("real"));
+    QVERIFY(pool->addConnection(connection));
+    QVERIFY(QMetaObject::invokeMethod(connection, "open", Qt::QueuedConnection));
+
+    QVERIFY(server.waitForNewConnection(1000));
+    QTcpSocket* socket = server.nextPendingConnection();
+    QVERIFY(socket);
+    QTRY_VERIFY(socket->readAll().contains("NICK nick"));
+
+    // the copies are queued to this thread, which does not process them yet
+    for (int i = 0; i < 10; ++i)
+        socket->write(":irc.ser.ver NOTICE nick :hello\r\n");
+    QVERIFY(socket->waitForBytesWritten(1000));
+    QList<QPointer<IrcMessage> > copies = waitForPending(pool, 10);
+    QCOMPARE(copies.count(), 10);
+
+    // no messages of a connection that has been removed from the pool
+    QVERIFY(pool->removeConnection(connection));
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::MetaCall);
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+    QCOMPARE(received, 0);
+    QCOMPARE(IrcConnectionPoolPrivate::get(pool)->pending.count(), 0);
+    foreach (const QPointer<IrcMessage>& copy, copies)
+        QVERIFY(!copy);
+
+    // destructing the pool deletes the copies that were not delivered
+    QVERIFY(pool->addConnection(connection));
+    for (int i = 0; i < 10; ++i)
+        socket->write(":irc.ser.ver NOTICE nick :hello\r\n");
+    QVERIFY(socket->waitForBytesWritten(1000));
+    copies = waitForPending(pool, 10);
+    QCOMPARE(copies.count(), 10);
+
+    delete pool;
+    foreach (const QPointer<IrcMessage>& copy, copies)
+        QVERIFY(!copy);
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::MetaCall);
+    QCOMPARE(received, 0);
+}
+
+QTEST_MAIN(tst_IrcConnectionPool)
+
+#include "tst_ircconnectionpool.moc"
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2008-2020 The Communi Project
+ *
+ * This test is free, and not covered by the BSD license. There is no
+ * restriction applied to their modification, redistribution, using and so on.
+ * You can study them, modify them, use them in your own program - either
+ * completely or partially.
+ */
+
+#include "ircconnection.h"
+#include "ircdebug_p.h"
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+
+class tst_IrcDebug : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void testLevel();
+    void testFile();
+
+private:
+    QTemporaryDir dir;
+};
+
+static int evaluated = 0;
+
+static QByteArray line(const QByteArray& data)
+{
+    ++evaluated;
+    return data;
+}
+
+void tst_IrcDebug::initTestCase()
+{
+    // the environment is read once, when the first line is logged
+    QVERIFY(dir.isValid());
+    qputenv("IRC_DEBUG_LEVEL", "write");
+    qputenv("IRC_DEBUG_FILE", QFile::encodeName(dir.filePath("%1.log")));
+}
+
+void tst_IrcDebug::testLevel()
+{
+    IrcConnection connection;
+    connection.setDisplayName("Level");
+
+    ircDebug(&connection, IrcDebug::Error) << line("init");
+    QCOMPARE(evaluated, 1);
+
+    QVERIFY(IrcDebug::isEnabled(IrcDebug::Error));
+    QVERIFY(IrcDebug::isEnabled(IrcDebug::Status));
+    QVERIFY(IrcDebug::isEnabled(IrcDebug::Write));
+    QVERIFY(!IrcDebug::isEnabled(IrcDebug::Read));
+
+    // disabled levels do not evaluate their arguments
+    ircDebug(&connection, IrcDebug::Read) << line("PING :disabled");
+    QCOMPARE(evaluated, 1);
+
+    if (evaluated > 0)
+        ircDebug(&connection, IrcDebug::Read) << line("PING :dangling");
+    else
+        QFAIL("the macro must not swallow the else branch");
+    QCOMPARE(evaluated, 1);
+}
+
+void tst_IrcDebug::testFile()
+{
+    IrcConnection first;
+    first.setDisplayName("First Network");
+
+    IrcConnection second;
+    second.setDisplayName("Second");
+
+    ircDebug(&first, IrcDebug::Write) << QByteArray("NICK first");
+    ircDebug(&second, IrcDebug::Write) << QByteArray("NICK second");
+    ircDebug(&first, IrcDebug::Read) << QByteArray("PING :ignored");
+    ircDebug(&first, IrcDebug::Status) << IrcConnection::Connected;
+
+    IrcDebug::flush();
+
+    QFile file1(dir.filePath("First_Network.log"));
+    QVERIFY(file1.open(QIODevice::ReadOnly | QIODevice::Text));
+    const QList<QByteArray> lines1 = file1.readAll().split('\n');
+    QCOMPARE(lines1.count(), 3);
+    QVERIFY(lines1.at(0).startsWith('['));
+    QVERIFY(lines1.at(0).contains(" First Network] -> "));
+    QVERIFY(lines1.at(0).contains("NICK first"));
+    QVERIFY(lines1.at(1).contains(" First Network] ?? "));
+    QVERIFY(lines1.at(2).isEmpty());
+
+    QFile file2(dir.filePath("Second.log"));
+    QVERIFY(file2.open(QIODevice::ReadOnly | QIODevice::Text));
+    const QList<QByteArray> lines2 = file2.readAll().split('\n');
+    QCOMPARE(lines2.count(), 2);
+    QVERIFY(lines2.at(0).contains(" Second] -> "));
+    QVERIFY(lines2.at(0).contains("NICK second"));
+}
+
+QTEST_MAIN(tst_IrcDebug)
+
+#include "tst_ircdebug.moc"
@@ -9,6 +9,8 @@
 
 #include "irclagtimer.h"
 #include "ircconnection.h"
+#include "ircconnectionstatistics.h"
+#include "ircclock.h"
 #include "tst_ircclientserver.h"
 #include "tst_ircdata.h"
 #include <QtTest/QtTest>
@@ -22,6 +24,11 @@ private slots:
     void testInterval();
     void testConnection();
     void testLag();
+    void testProbes();
+    void testPercentiles();
+
+private:
+    QString readProbe();
 };
 
 void tst_IrcLagTimer::testDefaults()
@@ -30,6 +37,17 @@ void tst_IrcLagTimer::testDefaults()
     QCOMPARE(timer.lag(), qint64(-1));
     QVERIFY(!timer.connection());
     QCOMPARE(timer.interval(), 60);
+    QCOMPARE(timer.maximumProbes(), 3);
+    QCOMPARE(timer.pendingProbes(), 0);
+    QCOMPARE(timer.lostProbes(), 0);
+    QCOMPARE(timer.window(), 100);
+    QVERIFY(timer.roundTripTimes().isEmpty());
+    QCOMPARE(timer.percentile(50), -1ll);
+
+    timer.setMaximumProbes(0);
+    QCOMPARE(timer.maximumProbes(), 1);
+    timer.setWindow(-1);
+    QCOMPARE(timer.window(), 1);
 }
 
 void tst_IrcLagTimer::testInterval()
@@ -53,9 +71,20 @@ void tst_IrcLagTimer::testConnection()
     QCOMPARE(timer.connection(), connection.data());
 }
 
+QString tst_IrcLagTimer::readProbe()
+{
+    if (!clientSocket->waitForBytesWritten(1000) || !serverSocket->waitForReadyRead(1000))
+        return QString();
+    QRegularExpression rx(QStringLiteral("PING (communi/\\d+)"));
+    QRegularExpressionMatch match = rx.match(QString::fromUtf8(serverSocket->readAll()));
+    return match.hasMatch() ? match.captured(1) : QString();
+}
+
 void tst_IrcLagTimer::testLag()
 {
 #if QT_VERSION >= 0x040700
+    IrcClock clock(IrcClock::VirtualTime);
+    connection->setClock(&clock);
     IrcLagTimer timer(connection);
 
     QSignalSpy lagSpy(&timer, SIGNAL(lagChanged(qint64)));
@@ -71,17 +100,17 @@ void tst_IrcLagTimer::testLag()
 
     // cheat a bit to avoid waiting a 1s interval at minimum...
     QMetaObject::invokeMethod(&timer, "_irc_pingServer");
-    QVERIFY(clientSocket->waitForBytesWritten(1000));
-    QVERIFY(serverSocket->waitForReadyRead(1000));
-
-    QRegularExpression rx(QStringLiteral("PING communi/(\\d+)"));
-    QString written = QString::fromUtf8(serverSocket->readAll());
-    QVERIFY(rx.match(written).hasMatch());
-
-    waitForWritten(QStringLiteral(":irc.ser.ver PONG communi communi/%1").arg(QDateTime::currentMSecsSinceEpoch() - 1234ll).toUtf8());
-    QVERIFY(timer.lag() >= 1234ll);
+    QString probe = readProbe();
+    QVERIFY(!probe.isEmpty());
+    QCOMPARE(timer.pendingProbes(), 1);
+
+    clock.advance(1234);
+    waitForWritten(QStringLiteral(":irc.ser.ver PONG communi %1").arg(probe).toUtf8());
+    QCOMPARE(timer.lag(), 1234ll);
+    QCOMPARE(timer.pendingProbes(), 0);
     QCOMPARE(lagSpy.count(), ++lagCount);
-    QVERIFY(lagSpy.last().at(0).toLongLong() >= 1234ll);
+    QCOMPARE(lagSpy.last().at(0).toLongLong(), 1234ll);
+    QCOMPARE(connection->statistics()->timingCount(IrcConnectionStatistics::RoundTripTime), 1ll);
 
     timer.setConnection(nullptr);
     QCOMPARE(timer.lag(), -1ll);
@@ -92,10 +121,19 @@ void tst_IrcLagTimer::testLag()
     QCOMPARE(timer.lag(), -1ll);
     QCOMPARE(lagSpy.count(), lagCount);
 
-    waitForWritten(QStringLiteral(":irc.ser.ver PONG communi communi/%1").arg(QDateTime::currentMSecsSinceEpoch() - 4321ll).toUtf8());
-    QVERIFY(timer.lag() >= 4321ll);
+    // a reply to a probe of another timer is not ours
+    waitForWritten(":irc.ser.ver PONG communi communi/0");
+    QCOMPARE(timer.lag(), -1ll);
+    QCOMPARE(lagSpy.count(), lagCount);
+
+    QMetaObject::invokeMethod(&timer, "_irc_pingServer");
+    probe = readProbe();
+    QVERIFY(!probe.isEmpty());
+    clock.advance(4321);
+    waitForWritten(QStringLiteral(":irc.ser.ver PONG communi %1").arg(probe).toUtf8());
+    QCOMPARE(timer.lag(), 4321ll);
     QCOMPARE(lagSpy.count(), ++lagCount);
-    QVERIFY(lagSpy.last().at(0).toLongLong() >= 4321ll);
+    QCOMPARE(lagSpy.last().at(0).toLongLong(), 4321ll);
 
     connection->close();
     QCOMPARE(timer.lag(), -1ll);
@@ -104,6 +142,92 @@ void tst_IrcLagTimer::testLag()
 #endif // QT_VERSION >= 0x040700
 }
 
+void tst_IrcLagTimer::testProbes()
+{
+    IrcClock clock(IrcClock::VirtualTime);
+    connection->setClock(&clock);
+    IrcLagTimer timer(connection);
+    timer.setMaximumProbes(2);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+
+    QMetaObject::invokeMethod(&timer, "_irc_pingServer");
+    const QString first = readProbe();
+    clock.advance(100);
+    QMetaObject::invokeMethod(&timer, "_irc_pingServer");
+    const QString second = readProbe();
+    QVERIFY(!first.isEmpty());
+    QVERIFY(!second.isEmpty());
+    QVERIFY(first != second);
+    QCOMPARE(timer.pendingProbes(), 2);
+
+    // the second reply overtakes the first: the first is lost
+    clock.advance(200);
+    waitForWritten(QStringLiteral(":irc.ser.ver PONG communi %1").arg(second).toUtf8());
+    QCOMPARE(timer.lag(), 200ll);
+    QCOMPARE(timer.pendingProbes(), 0);
+    QCOMPARE(timer.lostProbes(), 1);
+
+    // a late reply to a lost probe is consumed, but not measured
+    QSignalSpy messageSpy(connection, SIGNAL(pongMessageReceived(IrcPongMessage*)));
+    QVERIFY(messageSpy.isValid());
+    waitForWritten(QStringLiteral(":irc.ser.ver PONG communi %1").arg(first).toUtf8());
+    QCOMPARE(messageSpy.count(), 0);
+    QCOMPARE(timer.lag(), 200ll);
+    QCOMPARE(timer.roundTripTimes(), QList<qint64>() << 200);
+
+    // too many probes in flight: the oldest is lost
+    for (int i = 0; i < 3; ++i) {
+        QMetaObject::invokeMethod(&timer, "_irc_pingServer");
+        QVERIFY(!readProbe().isEmpty());
+        clock.advance(1000);
+    }
+    QCOMPARE(timer.pendingProbes(), 2);
+    QCOMPARE(timer.lostProbes(), 2);
+
+    // unanswered probes raise the lag
+    QMetaObject::invokeMethod(&timer, "_irc_pingServer");
+    QVERIFY(!readProbe().isEmpty());
+    QCOMPARE(timer.lag(), 2000ll);
+    QCOMPARE(timer.lostProbes(), 3);
+}
+
+void tst_IrcLagTimer::testPercentiles()
+{
+    IrcClock clock(IrcClock::VirtualTime);
+    connection->setClock(&clock);
+    IrcLagTimer timer(connection);
+    timer.setWindow(10);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+
+    // 20 round trips of 1..20ms, the window keeps the last 10
+    for (int i = 1; i <= 20; ++i) {
+        QMetaObject::invokeMethod(&timer, "_irc_pingServer");
+        const QString probe = readProbe();
+        QVERIFY(!probe.isEmpty());
+        clock.advance(i);
+        waitForWritten(QStringLiteral(":irc.ser.ver PONG communi %1").arg(probe).toUtf8());
+        QCOMPARE(timer.lag(), qint64(i));
+    }
+
+    QCOMPARE(timer.roundTripTimes().count(), 10);
+    QCOMPARE(timer.roundTripTimes().first(), 11ll);
+    QCOMPARE(timer.percentile(0), 11ll);
+    QCOMPARE(timer.percentile(50), 15ll);
+    QCOMPARE(timer.percentile(95), 20ll);
+    QCOMPARE(timer.percentile(100), 20ll);
+    QCOMPARE(connection->statistics()->timingCount(IrcConnectionStatistics::RoundTripTime), 20ll);
+
+    timer.setWindow(4);
+    QCOMPARE(timer.roundTripTimes(), QList<qint64>() << 17 << 18 << 19 << 20);
+    QCOMPARE(timer.percentile(50), 18ll);
+}
+
 QTEST_MAIN(tst_IrcLagTimer)
 
 #include "tst_irclagtimer.moc"
@@ -10,6 +10,7 @@
 #include "ircmessage.h"
 #include "ircconnection.h"
 #include "ircprotocol.h"
+#include "ircmessage_p.h"
 #include <QtTest/QtTest>
 #include <QTextCodec>
 #include <QtCore/QScopedPointer>
@@ -87,6 +88,7 @@ private slots:
     void testWhoReplyMessage();
 
     void testClone();
+    void testCloneServerPrefix();
     void testNullConnection();
 
     void testDebug();
@@ -1133,6 +1135,58 @@ void tst_IrcMessage::testClone()
     QCOMPARE(clone->parameters(), pm->parameters());
     QCOMPARE(clone->timeStamp(), pm->timeStamp());
     QCOMPARE(clone->account(), pm->account());
+
+    // modifying a clone must not affect the original
+    clone->setParameters(QStringList() << "you" << "bye");
+    clone->setTag("a", "e");
+    QCOMPARE(clone->parameters(), QStringList() << "you" << "bye");
+    QCOMPARE(clone->tag("a").toString(), QString("e"));
+    QCOMPARE(pm->parameters(), QStringList() << "me" << "hello");
+    QCOMPARE(pm->tag("a").toString(), QString("b"));
+
+    // ...and vice versa
+    IrcMessage* other = pm->clone(this);
+    pm->setEncoding("UTF-8");
+    pm->setPrefix("someone!else@where");
+    QCOMPARE(pm->nick(), QString("someone"));
+    QCOMPARE(other->nick(), QString("nick"));
+    QCOMPARE(other->encoding(), QByteArray("ISO-8859-15"));
+    QCOMPARE(other->toData(), QByteArray("@a=b;c=d :nick!ident@host PRIVMSG me :hello"));
+
+    // clones outlive the original
+    delete pm;
+    QCOMPARE(other->prefix(), QString("nick!ident@host"));
+    QCOMPARE(other->parameters(), QStringList() << "me" << "hello");
+    QCOMPARE(clone->prefix(), QString("nick!ident@host"));
+}
+
+void tst_IrcMessage::testCloneServerPrefix()
+{
+    IrcConnection connection;
+    QScopedPointer<IrcMessage> msg(IrcMessage::fromData(":irc.example.org NOTICE * :*** Looking up your hostname", &connection));
+    QVERIFY(msg);
+    QScopedPointer<IrcMessage> clone(msg->clone());
+    QVERIFY(clone);
+
+    // the clone shares the body, which clone() has already parsed
+    const IrcMessageBody* body = IrcMessagePrivate::get(msg.data())->body.constData();
+    QCOMPARE(IrcMessagePrivate::get(clone.data())->body.constData(), body);
+    QVERIFY(body->m_parsed);
+    QVERIFY(body->m_ident.isNull());
+    QVERIFY(body->m_host.isNull());
+
+    const QChar* nick = body->m_nick.constData();
+    QCOMPARE(clone->nick(), QString("irc.example.org"));
+    QVERIFY(clone->ident().isEmpty());
+    QVERIFY(clone->host().isEmpty());
+    QVERIFY(msg->ident().isEmpty());
+    QVERIFY(msg->host().isEmpty());
+
+    // reading must not write the shared body
+    QCOMPARE(IrcMessagePrivate::get(clone.data())->body.constData(), body);
+    QCOMPARE(body->m_nick.constData(), nick);
+    QVERIFY(body->m_ident.isNull());
+    QVERIFY(body->m_host.isNull());
 }
 
 void tst_IrcMessage::testNullConnection()
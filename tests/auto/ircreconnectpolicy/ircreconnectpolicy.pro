@@ -0,0 +1,7 @@
+######################################################################
+# Communi
+######################################################################
+
+SOURCES += tst_ircreconnectpolicy.cpp
+
+include(../auto.pri)
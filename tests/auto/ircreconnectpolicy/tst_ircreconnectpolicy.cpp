@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2008-2020 The Communi Project
+ *
+ * This test is free, and not covered by the BSD license. There is no
+ * restriction applied to their modification, redistribution, using and so on.
+ * You can study them, modify them, use them in your own program - either
+ * completely or partially.
+ */
+
+#include "ircreconnectpolicy.h"
+#include "ircconnection.h"
+#include <QtTest/QtTest>
+
+// QThread::create() requires Qt 5.10
+class tst_PolicyThread : public QThread
+{
+public:
+    tst_PolicyThread(IrcReconnectPolicy* policy, const QStringList& servers, int index, QAtomicInt* mismatches)
+        : policy(policy), servers(servers), index(index), mismatches(mismatches) { }
+
+protected:
+    void run() override
+    {
+        for (int j = 0; j < 1000; ++j) {
+            const QString server = servers.at((index + j) % servers.count());
+            if (j % 2)
+                policy->serverFailed(server);
+            else
+                policy->serverSucceeded(server, j);
+            if (policy->rankServers(servers).count() != servers.count())
+                mismatches->ref();
+        }
+    }
+
+private:
+    IrcReconnectPolicy* policy;
+    QStringList servers;
+    int index;
+    QAtomicInt* mismatches;
+};
+
+class tst_IrcReconnectPolicy : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testDefaults();
+    void testDelays();
+    void testRanking();
+    void testGlobalRate();
+    void testConnection();
+    void testThreads();
+};
+
+void tst_IrcReconnectPolicy::testDefaults()
+{
+    IrcReconnectPolicy policy;
+    QCOMPARE(policy.minimumDelay(), 1000);
+    QCOMPARE(policy.maximumDelay(), 300000);
+    QCOMPARE(policy.failures("irc.ser.ver"), 0);
+    QCOMPARE(policy.latency("irc.ser.ver"), qint64(-1));
+    QCOMPARE(IrcReconnectPolicy::globalRate(), qreal(0));
+
+    policy.setMinimumDelay(-1);
+    QCOMPARE(policy.minimumDelay(), 0);
+    policy.setMaximumDelay(-1);
+    QCOMPARE(policy.maximumDelay(), 0);
+}
+
+void tst_IrcReconnectPolicy::testDelays()
+{
+    IrcReconnectPolicy policy;
+    policy.setMinimumDelay(100);
+    policy.setMaximumDelay(1000);
+
+    for (int attempt = 0; attempt < 40; ++attempt) {
+        const int ceiling = qMin(1000, 100 << qMin(attempt, 30));
+        for (int i = 0; i < 20; ++i) {
+            const int delay = policy.reconnectDelay(attempt);
+            QVERIFY(delay >= 0);
+            QVERIFY(delay <= ceiling);
+        }
+    }
+
+    // jitter: the delays must not all be the same
+    QSet<int> delays;
+    for (int i = 0; i < 50; ++i)
+        delays += policy.reconnectDelay(5);
+    QVERIFY(delays.count() > 1);
+
+    policy.setMaximumDelay(0);
+    QCOMPARE(policy.reconnectDelay(0), 0);
+    QCOMPARE(policy.reconnectDelay(10), 0);
+}
+
+void tst_IrcReconnectPolicy::testRanking()
+{
+    IrcReconnectPolicy policy;
+    const QStringList servers = QStringList() << "a 6667" << "b 6667" << "c 6667";
+
+    // round-robin among equally healthy servers
+    QCOMPARE(policy.rankServers(servers), servers);
+    policy.serverFailed("a 6667");
+    QCOMPARE(policy.failures("a 6667"), 1);
+    QCOMPARE(policy.rankServers(servers), QStringList() << "b 6667" << "c 6667" << "a 6667");
+    policy.serverFailed("b 6667");
+    QCOMPARE(policy.rankServers(servers), QStringList() << "c 6667" << "a 6667" << "b 6667");
+
+    // known latency goes before unknown, lower latency first
+    policy.serverSucceeded("b 6667", 50);
+    QCOMPARE(policy.failures("b 6667"), 0);
+    QCOMPARE(policy.latency("b 6667"), qint64(50));
+    QCOMPARE(policy.rankServers(servers), QStringList() << "b 6667" << "c 6667" << "a 6667");
+    policy.serverSucceeded("c 6667", 20);
+    QCOMPARE(policy.rankServers(servers), QStringList() << "c 6667" << "b 6667" << "a 6667");
+
+    // latency is a moving average
+    policy.serverSucceeded("b 6667", 10);
+    QCOMPARE(policy.latency("b 6667"), qint64(40));
+
+    // repeated failures sink a server
+    policy.serverFailed("c 6667");
+    policy.serverFailed("c 6667");
+    QCOMPARE(policy.failures("c 6667"), 2);
+    QCOMPARE(policy.rankServers(servers), QStringList() << "b 6667" << "a 6667" << "c 6667");
+
+    QVERIFY(policy.rankServers(QStringList()).isEmpty());
+}
+
+void tst_IrcReconnectPolicy::testGlobalRate()
+{
+    IrcReconnectPolicy policy1;
+    policy1.setMaximumDelay(0);
+    IrcReconnectPolicy policy2;
+    policy2.setMaximumDelay(0);
+
+    IrcReconnectPolicy::setGlobalRate(-1);
+    QCOMPARE(IrcReconnectPolicy::globalRate(), qreal(0));
+
+    // 10 reconnects per second -> 100ms apart, shared by all policies
+    IrcReconnectPolicy::setGlobalRate(10);
+    QCOMPARE(IrcReconnectPolicy::globalRate(), qreal(10));
+    const int d1 = policy1.reconnectDelay(0);
+    const int d2 = policy2.reconnectDelay(0);
+    const int d3 = policy1.reconnectDelay(0);
+    QVERIFY(d1 <= 100);
+    QVERIFY(d2 >= 90 && d2 <= 200);
+    QVERIFY(d3 >= 190 && d3 <= 300);
+
+    IrcReconnectPolicy::setGlobalRate(0);
+    QCOMPARE(policy1.reconnectDelay(0), 0);
+}
+
+void tst_IrcReconnectPolicy::testConnection()
+{
+    IrcConnection connection;
+    QVERIFY(!connection.reconnectPolicy());
+
+    IrcReconnectPolicy* policy = new IrcReconnectPolicy;
+    connection.setReconnectPolicy(policy);
+    QCOMPARE(connection.reconnectPolicy(), policy);
+
+    QScopedPointer<IrcConnection> clone(connection.clone());
+    QCOMPARE(clone->reconnectPolicy(), policy);
+
+    // not owned, and not left dangling
+    delete policy;
+    QVERIFY(!connection.reconnectPolicy());
+    QVERIFY(!clone->reconnectPolicy());
+}
+
+void tst_IrcReconnectPolicy::testThreads()
+{
+    IrcReconnectPolicy policy;
+    const QStringList servers = QStringList() << "a" << "b" << "c";
+
+    // connections in different threads report to the same policy
+    QAtomicInt mismatches;
+    QList<QThread*> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads += new tst_PolicyThread(&policy, servers, i, &mismatches);
+        threads.last()->start();
+    }
+    foreach (QThread* thread, threads) {
+        QVERIFY(thread->wait(10000));
+        delete thread;
+    }
+    QCOMPARE(mismatches.loadAcquire(), 0);
+
+    foreach (const QString& server, servers)
+        QVERIFY(policy.latency(server) >= 0);
+}
+
+QTEST_MAIN(tst_IrcReconnectPolicy)
+
+#include "tst_ircreconnectpolicy.moc"
@@ -0,0 +1,7 @@
+######################################################################
+# Communi
+######################################################################
+
+SOURCES += tst_irctrace.cpp
+
+include(../auto.pri)
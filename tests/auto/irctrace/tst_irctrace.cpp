@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2008-2020 The Communi Project
+ *
+ * This test is free, and not covered by the BSD license. There is no
+ * restriction applied to their modification, redistribution, using and so on.
+ * You can study them, modify them, use them in your own program - either
+ * completely or partially.
+ */
+
+#include "irctrace.h"
+#include "ircmessage.h"
+#include <QtTest/QtTest>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+class tst_IrcTrace : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testDefaults();
+    void testJson();
+    void testRecording();
+};
+
+static QJsonArray traceEvents()
+{
+    QJsonParseError error;
+    const QJsonDocument doc = QJsonDocument::fromJson(IrcTrace::toJson(), &error);
+    return error.error == QJsonParseError::NoError ? doc.object().value("traceEvents").toArray() : QJsonArray();
+}
+
+void tst_IrcTrace::testDefaults()
+{
+    QVERIFY(!IrcTrace::isEnabled());
+    if (IrcTrace::isSupported())
+        QCOMPARE(IrcTrace::capacity(), 65536);
+    else
+        QCOMPARE(IrcTrace::capacity(), 0);
+}
+
+void tst_IrcTrace::testJson()
+{
+    QJsonParseError error;
+    const QJsonDocument doc = QJsonDocument::fromJson(IrcTrace::toJson(), &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QVERIFY(doc.object().value("traceEvents").isArray());
+}
+
+void tst_IrcTrace::testRecording()
+{
+    if (!IrcTrace::isSupported())
+        QSKIP("built without -config tracing");
+
+    IrcTrace::setCapacity(8);
+    QCOMPARE(IrcTrace::capacity(), 8);
+
+    IrcTrace::setEnabled(true);
+    QVERIFY(IrcTrace::isEnabled());
+
+    QTest::ignoreMessage(QtWarningMsg, "IrcTrace::setCapacity(): cannot change the capacity after tracing has been enabled");
+    IrcTrace::setCapacity(16);
+    QCOMPARE(IrcTrace::capacity(), 8);
+
+    QScopedPointer<IrcMessage> msg(IrcMessage::fromData(":nick!user@host PRIVMSG #communi :hello", nullptr));
+    QVERIFY(msg);
+    QCOMPARE(msg->parameters().value(1), QString("hello"));
+
+    IrcTrace::setEnabled(false);
+    QScopedPointer<IrcMessage> ignored(IrcMessage::fromData("PING :ignored", nullptr));
+
+    QJsonArray events = traceEvents();
+    QStringList names;
+    foreach (const QJsonValue& value, events) {
+        const QJsonObject event = value.toObject();
+        QCOMPARE(event.value("ph").toString(), QString("X"));
+        QVERIFY(event.value("ts").toDouble() >= 0);
+        QVERIFY(event.value("dur").toDouble() >= 0);
+        QVERIFY(event.value("tid").toInt() > 0);
+        names += event.value("name").toString();
+    }
+    QCOMPARE(names.count("fromData"), 1);
+    QVERIFY(names.contains("decode"));
+
+    // the ring buffer keeps the most recent events
+    IrcTrace::setEnabled(true);
+    for (int i = 0; i < 20; ++i)
+        delete IrcMessage::fromData("PING :overflow", nullptr);
+    IrcTrace::setEnabled(false);
+    QCOMPARE(traceEvents().count(), 8);
+
+    IrcTrace::clear();
+    QVERIFY(traceEvents().isEmpty());
+
+    const QString fileName = QDir::temp().filePath("tst_irctrace.json");
+    QVERIFY(IrcTrace::save(fileName));
+    QVERIFY(QFile::exists(fileName));
+    QFile::remove(fileName);
+}
+
+QTEST_MAIN(tst_IrcTrace)
+
+#include "tst_irctrace.moc"
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2008-2020 The Communi Project
+ *
+ * This test is free, and not covered by the BSD license. There is no
+ * restriction applied to their modification, redistribution, using and so on.
+ * You can study them, modify them, use them in your own program - either
+ * completely or partially.
+ */
+
+#include "irctraffic.h"
+#include "ircconnection.h"
+#include "ircmessage.h"
+#include "irccore.h"
+#include <QtTest/QtTest>
+#include <QTemporaryDir>
+
+#include "tst_ircdata.h"
+#include "tst_ircclientserver.h"
+
+class tst_IrcTraffic : public tst_IrcClientServer
+{
+    Q_OBJECT
+
+private slots:
+    void testDefaults();
+    void testRecord();
+    void testReplay_data();
+    void testReplay();
+    void testInvalid();
+
+private:
+    int record(const QString& fileName);
+
+    QTemporaryDir dir;
+};
+
+// records the welcome and join sequences, and returns the amount of recorded messages
+int tst_IrcTraffic::record(const QString& fileName)
+{
+    IrcTrafficRecorder recorder;
+    recorder.setConnection(connection);
+    recorder.setFileName(fileName);
+
+    QSignalSpy messageSpy(connection, SIGNAL(messageReceived(IrcMessage*)));
+    if (!messageSpy.isValid() || !recorder.start())
+        return -1;
+
+    connection->open();
+    if (!waitForOpened() || !waitForWritten(tst_IrcData::welcome()) || !waitForWritten(tst_IrcData::join()))
+        return -1;
+
+    recorder.stop();
+    return messageSpy.count();
+}
+
+void tst_IrcTraffic::testDefaults()
+{
+    IrcCore::registerMetaTypes();
+    QVERIFY(dir.isValid());
+
+    IrcTrafficRecorder recorder;
+    QVERIFY(!recorder.connection());
+    QVERIFY(recorder.fileName().isNull());
+    QVERIFY(!recorder.isActive());
+    QCOMPARE(recorder.recordCount(), 0ll);
+    QCOMPARE(recorder.byteCount(), 0ll);
+
+    IrcTrafficReplay replay;
+    QVERIFY(!replay.connection());
+    QVERIFY(replay.fileName().isNull());
+    QCOMPARE(replay.pace(), IrcTrafficReplay::OriginalPace);
+    QVERIFY(!replay.isActive());
+    QCOMPARE(replay.recordCount(), 0ll);
+    QCOMPARE(replay.position(), 0ll);
+}
+
+void tst_IrcTraffic::testRecord()
+{
+    IrcTrafficRecorder recorder;
+    recorder.setConnection(connection);
+    recorder.setFileName(dir.filePath("welcome.capture"));
+
+    QSignalSpy activeSpy(&recorder, SIGNAL(activeChanged(bool)));
+    QVERIFY(activeSpy.isValid());
+    QVERIFY(recorder.start());
+    QVERIFY(recorder.isActive());
+    QCOMPARE(activeSpy.count(), 1);
+
+    QSignalSpy messageSpy(connection, SIGNAL(messageReceived(IrcMessage*)));
+    QVERIFY(messageSpy.isValid());
+
+    connection->open();
+    QVERIFY(waitForOpened());
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+    QVERIFY(waitForWritten(tst_IrcData::join()));
+    QVERIFY(connection->isConnected());
+
+    recorder.stop();
+    QVERIFY(!recorder.isActive());
+    QCOMPARE(activeSpy.count(), 2);
+
+    // not recorded anymore
+    QVERIFY(waitForWritten(":nick!user@host PRIVMSG #communi :not recorded"));
+
+    QVERIFY(recorder.recordCount() > 0);
+    QVERIFY(recorder.byteCount() >= tst_IrcData::welcome().size() + tst_IrcData::join().size());
+
+    QFile file(recorder.fileName());
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.read(4), QByteArray("ICAP"));
+    QCOMPARE(file.size(), 16 + recorder.recordCount() * 12 + recorder.byteCount());
+}
+
+void tst_IrcTraffic::testReplay_data()
+{
+    QTest::addColumn<int>("pace");
+
+    QTest::newRow("original") << int(IrcTrafficReplay::OriginalPace);
+    QTest::newRow("maximum") << int(IrcTrafficReplay::MaximumPace);
+}
+
+void tst_IrcTraffic::testReplay()
+{
+    QFETCH(int, pace);
+    QVERIFY(dir.isValid());
+
+    const QString fileName = dir.filePath(QString("replay-%1.capture").arg(pace));
+    const int recordedMessages = record(fileName);
+    QVERIFY(recordedMessages > 0);
+
+    IrcConnection replayed("replay.capture");
+    replayed.setUserName("user");
+    replayed.setNickName("nick");
+    replayed.setRealName("real");
+
+    QSignalSpy messageSpy(&replayed, SIGNAL(messageReceived(IrcMessage*)));
+    QVERIFY(messageSpy.isValid());
+
+    IrcTrafficReplay replay;
+    replay.setConnection(&replayed);
+    replay.setFileName(fileName);
+    replay.setPace(static_cast<IrcTrafficReplay::Pace>(pace));
+
+    QSignalSpy finishedSpy(&replay, SIGNAL(finished()));
+    QVERIFY(finishedSpy.isValid());
+
+    QVERIFY(replay.start());
+    QVERIFY(replay.isActive());
+    QVERIFY(replay.recordCount() > 0);
+    QVERIFY(finishedSpy.wait(5000));
+
+    QVERIFY(!replay.isActive());
+    QCOMPARE(replay.position(), replay.recordCount());
+    QVERIFY(replayed.isConnected());
+    QCOMPARE(messageSpy.count(), recordedMessages);
+    QCOMPARE(replayed.bufferedBytes(), 0ll);
+
+    // the same connection cannot be replayed to while active
+    QTest::ignoreMessage(QtWarningMsg, "IrcTrafficReplay::start(): connection is active!");
+    QVERIFY(!replay.start());
+
+    replayed.close();
+    QVERIFY(!replayed.isActive());
+}
+
+void tst_IrcTraffic::testInvalid()
+{
+    IrcConnection replayed("invalid.capture");
+    replayed.setUserName("user");
+    replayed.setNickName("nick");
+    replayed.setRealName("real");
+
+    IrcTrafficReplay replay;
+    QTest::ignoreMessage(QtWarningMsg, "IrcTrafficReplay::start(): connection is null!");
+    QVERIFY(!replay.start());
+
+    QFile file(dir.filePath("invalid.capture"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("PING :not a capture\r\n");
+    file.close();
+
+    replay.setConnection(&replayed);
+    replay.setFileName(file.fileName());
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression("not a capture file"));
+    QVERIFY(!replay.start());
+    QVERIFY(!replay.isActive());
+    QVERIFY(!replayed.isActive());
+}
+
+QTEST_MAIN(tst_IrcTraffic)
+
+#include "tst_irctraffic.moc"
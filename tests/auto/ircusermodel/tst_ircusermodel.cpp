@@ -49,6 +49,7 @@ private slots:
     void testRoles();
     void testAIM();
     void testUser();
+    void testMemoryUsage();
 };
 
 Q_DECLARE_METATYPE(QModelIndex)
@@ -1684,6 +1685,42 @@ void tst_IrcUserModel::testUser()
     QCOMPARE(qoutServOpSpy.count(), 0);
 }
 
+void tst_IrcUserModel::testMemoryUsage()
+{
+    IrcBufferModel bufferModel;
+    bufferModel.setConnection(connection);
+
+    connection->open();
+    QVERIFY(waitForOpened());
+
+    QVERIFY(waitForWritten(tst_IrcData::welcome()));
+    QVERIFY(connection->memoryUsage() > 0);
+    QVERIFY(bufferModel.memoryUsage() > 0);
+
+    waitForWritten(":communi!communi@hidd.en JOIN :#channel");
+    QCOMPARE(bufferModel.count(), 1);
+
+    IrcChannel* channel = bufferModel.get(0)->toChannel();
+    QVERIFY(channel);
+
+    const qint64 empty = channel->memoryUsage();
+    QVERIFY(empty > 0);
+
+    waitForWritten(":irc.ser.ver 353 communi = #channel :a @b +c d e f");
+    waitForWritten(":irc.ser.ver 366 communi #channel :End of /NAMES list.");
+    const qint64 users = channel->memoryUsage();
+    QVERIFY(users > empty);
+
+    IrcUserModel* userModel = new IrcUserModel(channel);
+    QVERIFY(userModel->memoryUsage() > 0);
+    QCOMPARE(userModel->count(), 6);
+    QVERIFY(channel->memoryUsage() >= users + userModel->memoryUsage());
+    QVERIFY(bufferModel.memoryUsage() >= channel->memoryUsage());
+
+    delete userModel;
+    QCOMPARE(channel->memoryUsage(), users);
+}
+
 QTEST_MAIN(tst_IrcUserModel)
 
 #include "tst_ircusermodel.moc"
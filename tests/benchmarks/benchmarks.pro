@@ -4,6 +4,9 @@
 
 TEMPLATE = subdirs
 
+SUBDIRS += ircallocation
+SUBDIRS += ircchannel
+SUBDIRS += ircingest
 SUBDIRS += ircmessage
 SUBDIRS += irctextformat
 
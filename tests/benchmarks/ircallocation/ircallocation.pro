@@ -0,0 +1,7 @@
+######################################################################
+# Communi
+######################################################################
+
+SOURCES += tst_ircallocation.cpp
+
+include(../benchmarks.pri)
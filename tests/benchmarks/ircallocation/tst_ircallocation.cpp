@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2008-2020 The Communi Project
+ *
+ * This test is free, and not covered by the BSD license. There is no
+ * restriction applied to their modification, redistribution, using and so on.
+ * You can study them, modify them, use them in your own program - either
+ * completely or partially.
+ */
+
+#include "ircconnection.h"
+#include "ircprotocol.h"
+#include "ircmessage.h"
+#include "irccommand.h"
+#include "ircbuffermodel.h"
+#include "ircusermodel.h"
+#include "ircchannel.h"
+#include <QtTest/QtTest>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+
+// The allocation budgets. A change that makes an operation exceed its
+// budget fails the test. Lower a budget when an optimization lands, and
+// raise one only with a good reason.
+static const double PARSE_ALLOCATIONS = 48;         // per parsed PRIVMSG
+static const double CLONE_ALLOCATIONS = 16;         // per cloned PRIVMSG
+static const double COMMAND_ALLOCATIONS = 48;       // per IrcCommand sent
+static const double USER_ALLOCATIONS = 128;         // per IrcUser added by a JOIN
+static const double CHANNEL_BYTES = 4096;           // resident bytes per user in a 10k-user channel
+static const double BUFFER_BYTES = 8192;            // resident bytes per buffer in a 1k-buffer model
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+
+// The allocator is interposed at the C level, which covers both operator
+// new and the plain malloc() used by the Qt containers. Only the thread
+// that is measuring is accounted for.
+static thread_local bool tracking = false;
+static thread_local qint64 allocations = 0;
+static thread_local qint64 residentBytes = 0;
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size)
+{
+    void* ptr = __libc_malloc(size);
+    if (tracking && ptr) {
+        ++allocations;
+        residentBytes += malloc_usable_size(ptr);
+    }
+    return ptr;
+}
+
+void* calloc(size_t count, size_t size)
+{
+    void* ptr = __libc_calloc(count, size);
+    if (tracking && ptr) {
+        ++allocations;
+        residentBytes += malloc_usable_size(ptr);
+    }
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    const size_t before = (tracking && ptr) ? malloc_usable_size(ptr) : 0;
+    void* res = __libc_realloc(ptr, size);
+    if (tracking && res) {
+        ++allocations;
+        residentBytes += qint64(malloc_usable_size(res)) - qint64(before);
+    }
+    return res;
+}
+
+void free(void* ptr)
+{
+    if (tracking && ptr)
+        residentBytes -= malloc_usable_size(ptr);
+    __libc_free(ptr);
+}
+}
+
+#define IRC_ALLOCATION_TRACKING
+#endif // __GLIBC__
+
+class tst_AllocationScope
+{
+public:
+    tst_AllocationScope()
+    {
+#ifdef IRC_ALLOCATION_TRACKING
+        ::allocations = 0;
+        ::residentBytes = 0;
+        tracking = true;
+#endif
+    }
+
+    ~tst_AllocationScope() { stop(); }
+
+    void stop()
+    {
+#ifdef IRC_ALLOCATION_TRACKING
+        tracking = false;
+#endif
+    }
+
+    qint64 allocations() const
+    {
+#ifdef IRC_ALLOCATION_TRACKING
+        return ::allocations;
+#else
+        return 0;
+#endif
+    }
+
+    qint64 residentBytes() const
+    {
+#ifdef IRC_ALLOCATION_TRACKING
+        return ::residentBytes;
+#else
+        return 0;
+#endif
+    }
+};
+
+static void verifyBudget(const char* what, double value, double budget)
+{
+    qInfo("%.1f %s (budget %.0f)", value, what, budget);
+    if (value > budget)
+        QFAIL(qPrintable(QString::asprintf("%s: %.1f exceeds the budget of %.0f", what, value, budget)));
+}
+
+static void flush()
+{
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+
+class tst_IrcAllocation : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void testParse();
+    void testClone();
+    void testCommand();
+    void testUser();
+    void testChannel();
+    void testBuffers();
+};
+
+void tst_IrcAllocation::initTestCase()
+{
+#ifndef IRC_ALLOCATION_TRACKING
+    QSKIP("allocation tracking requires glibc");
+#endif
+}
+
+void tst_IrcAllocation::testParse()
+{
+    const int count = 1000;
+    const QByteArray line(":nick!~ident@host.example.org PRIVMSG #channel :Vestibulum eu libero eget metus.");
+
+    IrcConnection connection;
+    for (int i = 0; i < 10; ++i)
+        delete IrcMessage::fromData(line, &connection);
+
+    tst_AllocationScope scope;
+    for (int i = 0; i < count; ++i) {
+        IrcMessage* message = IrcMessage::fromData(line, &connection);
+        // the parameters are decoded on demand
+        message->parameters();
+        delete message;
+    }
+    scope.stop();
+
+    verifyBudget("allocations per PRIVMSG", double(scope.allocations()) / count, PARSE_ALLOCATIONS);
+}
+
+void tst_IrcAllocation::testClone()
+{
+    const int count = 1000;
+    const QByteArray line("@time=2020-01-01T00:00:00.000Z :nick!~ident@host.example.org PRIVMSG #channel :Vestibulum eu libero eget metus.");
+
+    IrcConnection connection;
+    IrcMessage* message = IrcMessage::fromData(line, &connection);
+    for (int i = 0; i < 10; ++i)
+        delete message->clone();
+
+    tst_AllocationScope scope;
+    for (int i = 0; i < count; ++i) {
+        IrcMessage* clone = message->clone();
+        // the decoded content is shared with the original
+        clone->parameters();
+        clone->tags();
+        delete clone;
+    }
+    scope.stop();
+    delete message;
+
+    verifyBudget("allocations per cloned PRIVMSG", double(scope.allocations()) / count, CLONE_ALLOCATIONS);
+}
+
+void tst_IrcAllocation::testCommand()
+{
+    const int count = 1000;
+
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    IrcConnection connection;
+    connection.setUserName("communi");
+    connection.setNickName("communi");
+    connection.setRealName("communi");
+    connection.setHost("127.0.0.1");
+    connection.setPort(server.serverPort());
+    connection.open();
+    QVERIFY(server.waitForNewConnection(1000));
+    QScopedPointer<QTcpSocket> socket(server.nextPendingConnection());
+    QTRY_VERIFY(connection.isActive());
+
+    for (int i = 0; i < 10; ++i)
+        QVERIFY(connection.sendCommand(IrcCommand::createMessage("#channel", "Vestibulum eu libero eget metus.")));
+    flush();
+
+    tst_AllocationScope scope;
+    for (int i = 0; i < count; ++i)
+        connection.sendCommand(IrcCommand::createMessage("#channel", "Vestibulum eu libero eget metus."));
+    flush();
+    scope.stop();
+
+    verifyBudget("allocations per IrcCommand sent", double(scope.allocations()) / count, COMMAND_ALLOCATIONS);
+}
+
+void tst_IrcAllocation::testUser()
+{
+    const int count = 1000;
+
+    IrcConnection connection;
+    connection.setNickName("communi");
+    IrcBufferModel model(&connection);
+    connection.protocol()->receiveMessage(IrcMessage::fromData(":communi!~communi@localhost JOIN #channel", &connection));
+    IrcChannel* channel = model.find("#channel")->toChannel();
+    QVERIFY(channel);
+    IrcUserModel users(channel);
+    flush();
+
+    QList<QByteArray> lines;
+    for (int i = 0; i < count; ++i)
+        lines += ":user" + QByteArray::number(i) + "!~ident@host.example.org JOIN #channel";
+
+    tst_AllocationScope scope;
+    foreach (const QByteArray& line, lines)
+        connection.protocol()->receiveMessage(IrcMessage::fromData(line, &connection));
+    flush();
+    scope.stop();
+
+    QVERIFY(users.count() >= count);
+    verifyBudget("allocations per IrcUser added", double(scope.allocations()) / count, USER_ALLOCATIONS);
+}
+
+void tst_IrcAllocation::testChannel()
+{
+    const int count = 10000;
+
+    QList<QByteArray> lines;
+    QByteArray line;
+    for (int i = 0; i < count; ++i) {
+        if (line.isEmpty())
+            line = ":irc.example.org 353 communi = #channel :";
+        else
+            line += ' ';
+        line += "user" + QByteArray::number(i);
+        if (i % 40 == 39 || i == count - 1) {
+            lines += line;
+            line.clear();
+        }
+    }
+    lines += ":irc.example.org 366 communi #channel :End of /NAMES list.";
+
+    IrcConnection connection;
+    connection.setNickName("communi");
+
+    // everything that is left after the messages are gone is the channel
+    tst_AllocationScope scope;
+    IrcBufferModel model(&connection);
+    connection.protocol()->receiveMessage(IrcMessage::fromData(":communi!~communi@localhost JOIN #channel", &connection));
+    IrcChannel* channel = model.find("#channel")->toChannel();
+    IrcUserModel users(channel);
+    foreach (const QByteArray& line, lines)
+        connection.protocol()->receiveMessage(IrcMessage::fromData(line, &connection));
+    flush();
+    scope.stop();
+
+    QVERIFY(users.count() >= count);
+    verifyBudget("resident bytes per channel user", double(scope.residentBytes()) / count, CHANNEL_BYTES);
+}
+
+void tst_IrcAllocation::testBuffers()
+{
+    const int count = 1000;
+
+    QStringList titles;
+    for (int i = 0; i < count; ++i)
+        titles += QStringLiteral("#channel%1").arg(i);
+
+    IrcConnection connection;
+    connection.setNickName("communi");
+
+    tst_AllocationScope scope;
+    IrcBufferModel model(&connection);
+    foreach (const QString& title, titles)
+        model.add(title);
+    flush();
+    scope.stop();
+
+    QCOMPARE(model.count(), count);
+    verifyBudget("resident bytes per buffer", double(scope.residentBytes()) / count, BUFFER_BYTES);
+}
+
+QTEST_MAIN(tst_IrcAllocation)
+
+#include "tst_ircallocation.moc"
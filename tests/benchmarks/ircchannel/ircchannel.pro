@@ -0,0 +1,7 @@
+######################################################################
+# Communi
+######################################################################
+
+SOURCES += tst_ircchannel.cpp
+
+include(../benchmarks.pri)
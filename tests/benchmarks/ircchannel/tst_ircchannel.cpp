@@ -0,0 +1,331 @@
+/*
+ * Copyright (C) 2008-2020 The Communi Project
+ *
+ * This test is free, and not covered by the BSD license. There is no
+ * restriction applied to their modification, redistribution, using and so on.
+ * You can study them, modify them, use them in your own program - either
+ * completely or partially.
+ */
+
+#include "irc.h"
+#include "ircconnection.h"
+#include "ircprotocol.h"
+#include "ircmessage.h"
+#include "ircbuffermodel.h"
+#include "ircusermodel.h"
+#include "ircchannel.h"
+#include "ircuser.h"
+#include <QtTest/QtTest>
+
+// the number of users taking part in a wave of operations
+static const int WAVE = 1000;
+
+static QByteArray nick(int user)
+{
+    return "user" + QByteArray::number(user);
+}
+
+static QByteArray prefix(int user, const QByteArray& name = QByteArray())
+{
+    const QByteArray id = QByteArray::number(user);
+    return ':' + (name.isNull() ? nick(user) : name) + "!~ident" + id + "@host-" + id + ".example.org";
+}
+
+// the users of a wave, spread over the whole channel
+static QList<int> wave(int users)
+{
+    QList<int> list;
+    const int count = qMin(WAVE, users);
+    for (int i = 0; i < count; ++i)
+        list += int(qint64(i) * users / count);
+    return list;
+}
+
+// the mode a user is given in the names reply
+static char mode(int user)
+{
+    if (user % 20 == 0)
+        return 'o';
+    if (user % 5 == 0)
+        return 'v';
+    return 0;
+}
+
+// gives the users back the modes they had after the names reply
+static QList<QByteArray> restore(const QList<int>& users)
+{
+    QList<QByteArray> lines;
+    foreach (int user, users) {
+        if (const char m = mode(user))
+            lines += ":ChanServ!ChanServ@services. MODE #channel +" + QByteArray(1, m) + ' ' + nick(user);
+    }
+    return lines;
+}
+
+class tst_SignalCounter : public QObject
+{
+    Q_OBJECT
+
+public:
+    void watch(QObject* object)
+    {
+        const int slot = metaObject()->indexOfSlot("count()");
+        const QMetaObject* mo = object->metaObject();
+        for (int i = 0; i < mo->methodCount(); ++i) {
+            const QMetaMethod method = mo->method(i);
+            if (method.methodType() == QMetaMethod::Signal && method.name() != "destroyed" && method.name() != "objectNameChanged")
+                QMetaObject::connect(object, i, this, slot);
+        }
+    }
+
+    qint64 emissions = 0;
+
+public slots:
+    void count() { ++emissions; }
+};
+
+// a channel with two attached user models, fed directly through the protocol
+class tst_Channel
+{
+public:
+    tst_Channel(int users, Irc::SortMethod method) : users(users)
+    {
+        connection.setNickName("communi");
+        model = new IrcBufferModel(&connection);
+        feed(":communi!~communi@localhost JOIN #channel");
+        channel = model->find(QStringLiteral("#channel"))->toChannel();
+        for (int i = 0; i < 2; ++i) {
+            IrcUserModel* userModel = new IrcUserModel(channel);
+            userModel->setSortMethod(method);
+            userModel->setSortOrder(i ? Qt::DescendingOrder : Qt::AscendingOrder);
+            userModel->setChannel(channel);
+            counter.watch(userModel);
+        }
+    }
+
+    void feed(const QByteArray& line)
+    {
+        connection.protocol()->receiveMessage(IrcMessage::fromData(line, &connection));
+    }
+
+    void feed(const QList<QByteArray>& lines)
+    {
+        foreach (const QByteArray& line, lines)
+            feed(line);
+        // the processed messages are deleted later
+        QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+    }
+
+    void names()
+    {
+        QList<QByteArray> lines;
+        QByteArray line;
+        for (int user = 0; user < users; ++user) {
+            if (line.isEmpty())
+                line = ":irc.example.org 353 communi = #channel :";
+            else
+                line += ' ';
+            if (const char m = mode(user))
+                line += m == 'o' ? '@' : '+';
+            line += nick(user);
+            if (user % 40 == 39 || user == users - 1) {
+                lines += line;
+                line.clear();
+            }
+        }
+        lines += ":irc.example.org 366 communi #channel :End of /NAMES list.";
+        feed(lines);
+    }
+
+    // the users with their prefixes, to check that a wave leaves the channel as it was
+    QStringList state() const
+    {
+        QStringList list;
+        foreach (IrcUser* user, channel->findChild<IrcUserModel*>()->users())
+            list += user->prefix() + user->name();
+        // sorting by activity reorders the users that took part
+        list.sort();
+        return list;
+    }
+
+    int users;
+    IrcConnection connection;
+    IrcBufferModel* model;
+    IrcChannel* channel;
+    tst_SignalCounter counter;
+};
+
+class tst_IrcChannel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testNames_data();
+    void testNames();
+
+    void testChurn_data();
+    void testChurn();
+
+    void testModes_data();
+    void testModes();
+
+    void testAway_data();
+    void testAway();
+
+private:
+    void addRows();
+    void run(tst_Channel* channel, const QList<QByteArray>& lines, int operations);
+};
+
+void tst_IrcChannel::addRows()
+{
+    QTest::addColumn<int>("users");
+    QTest::addColumn<int>("method");
+
+    const QMetaEnum methods = Irc::staticMetaObject.enumerator(Irc::staticMetaObject.indexOfEnumerator("SortMethod"));
+    foreach (int users, QList<int>() << 1000 << 10000 << 50000) {
+        for (int i = 0; i < methods.keyCount(); ++i) {
+            const QByteArray name = QByteArray::number(users) + " users / " + methods.key(i);
+            QTest::newRow(name.constData()) << users << methods.value(i);
+        }
+    }
+}
+
+void tst_IrcChannel::run(tst_Channel* channel, const QList<QByteArray>& lines, int operations)
+{
+    channel->counter.emissions = 0;
+
+    int iterations = 0;
+    QElapsedTimer timer;
+    qint64 elapsed = 0;
+    QBENCHMARK {
+        timer.start();
+        channel->feed(lines);
+        elapsed += timer.nsecsElapsed();
+        ++iterations;
+    }
+
+    const qint64 total = qint64(iterations) * operations;
+    qInfo("%.2f us/op, %.2f model signals/op", elapsed / 1e3 / total, double(channel->counter.emissions) / total);
+}
+
+void tst_IrcChannel::testNames_data()
+{
+    addRows();
+}
+
+void tst_IrcChannel::testNames()
+{
+    QFETCH(int, users);
+    QFETCH(int, method);
+
+    // a fresh channel per iteration, torn down outside the measurement
+    QList<tst_Channel*> channels;
+    int iterations = 0;
+    qint64 emissions = 0;
+    QBENCHMARK {
+        tst_Channel* channel = new tst_Channel(users, static_cast<Irc::SortMethod>(method));
+        channel->names();
+        emissions += channel->counter.emissions;
+        channels += channel;
+        ++iterations;
+    }
+    QVERIFY(channels.last()->channel->findChild<IrcUserModel*>()->count() >= users);
+    qDeleteAll(channels);
+
+    qInfo("%.2f model signals/user", double(emissions) / iterations / users);
+}
+
+void tst_IrcChannel::testChurn_data()
+{
+    addRows();
+}
+
+void tst_IrcChannel::testChurn()
+{
+    QFETCH(int, users);
+    QFETCH(int, method);
+
+    tst_Channel channel(users, static_cast<Irc::SortMethod>(method));
+    channel.names();
+    const QStringList state = channel.state();
+
+    // every user leaves and comes back, and gets the lost modes back, so that each
+    // iteration starts from the same state
+    const QList<int> list = wave(users);
+    QList<QByteArray> lines;
+    foreach (int user, list) {
+        const QByteArray away = nick(user) + "|away";
+        lines += prefix(user) + " PART #channel :bye";
+        lines += prefix(user) + " JOIN #channel";
+        lines += prefix(user) + " NICK :" + away;
+        lines += prefix(user, away) + " NICK :" + nick(user);
+        lines += prefix(user) + " QUIT :Quit: bye";
+        lines += prefix(user) + " JOIN #channel";
+    }
+    lines += restore(list);
+    run(&channel, lines, lines.count());
+    QCOMPARE(channel.state(), state);
+}
+
+void tst_IrcChannel::testModes_data()
+{
+    addRows();
+}
+
+void tst_IrcChannel::testModes()
+{
+    QFETCH(int, users);
+    QFETCH(int, method);
+
+    tst_Channel channel(users, static_cast<Irc::SortMethod>(method));
+    channel.names();
+    const QStringList state = channel.state();
+
+    // ops the whole wave four at a time, deops it again, and re-ops the original ops
+    const QList<int> list = wave(users);
+    QList<QByteArray> op, deop;
+    for (int i = 0; i < list.count(); i += 4) {
+        QByteArray modes, nicks;
+        for (int j = i; j < qMin(i + 4, list.count()); ++j) {
+            modes += 'o';
+            nicks += ' ' + nick(list.at(j));
+        }
+        op += ":ChanServ!ChanServ@services. MODE #channel +" + modes + nicks;
+        deop += ":ChanServ!ChanServ@services. MODE #channel -" + modes + nicks;
+    }
+    QList<int> ops;
+    foreach (int user, list) {
+        if (mode(user) == 'o')
+            ops += user;
+    }
+    const QList<QByteArray> reop = restore(ops);
+    run(&channel, op + deop + reop, 2 * list.count() + reop.count());
+    QCOMPARE(channel.state(), state);
+}
+
+void tst_IrcChannel::testAway_data()
+{
+    addRows();
+}
+
+void tst_IrcChannel::testAway()
+{
+    QFETCH(int, users);
+    QFETCH(int, method);
+
+    tst_Channel channel(users, static_cast<Irc::SortMethod>(method));
+    channel.names();
+
+    // away-notify: the wave goes away, and comes back
+    QList<QByteArray> lines;
+    foreach (int user, wave(users))
+        lines += prefix(user) + " AWAY :Auto away";
+    foreach (int user, wave(users))
+        lines += prefix(user) + " AWAY";
+    run(&channel, lines, lines.count());
+}
+
+QTEST_MAIN(tst_IrcChannel)
+
+#include "tst_ircchannel.moc"
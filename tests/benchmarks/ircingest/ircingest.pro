@@ -0,0 +1,7 @@
+######################################################################
+# Communi
+######################################################################
+
+SOURCES += tst_ircingest.cpp
+
+include(../benchmarks.pri)
@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2008-2020 The Communi Project
+ *
+ * This test is free, and not covered by the BSD license. There is no
+ * restriction applied to their modification, redistribution, using and so on.
+ * You can study them, modify them, use them in your own program - either
+ * completely or partially.
+ */
+
+#include "ircconnection.h"
+#include "ircmessage.h"
+#include "ircbuffer.h"
+#include "ircbuffermodel.h"
+#include "ircusermodel.h"
+#include "ircchannel.h"
+#include <QtTest/QtTest>
+#include <QtCore/QPointer>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+#include <algorithm>
+
+// the size of the simulated network
+static const int USERS = 500;
+static const int CHANNELS = 10;
+
+// lines per write, and how many writes may be in flight
+static const int CHUNK = 64;
+static const int WINDOW = 16;
+
+static const char* const TEXTS[] = {
+    "hi",
+    "Vestibulum eu libero eget metus.",
+    "Phasellus enim dui, sodales sed tincidunt quis, ultricies metus.",
+    "Ut porttitor volutpat tristique. Aenean semper ligula eget nulla condimentum tempor in quis felis. Sed sem diam, tincidunt amet.",
+    "Vestibulum quis lorem velit, a varius augue. Suspendisse risus augue, ultricies at convallis in, elementum in velit. Fusce fermentum congue augue sit amet dapibus. Fusce ultrices urna ut tortor laoreet a aliquet elit lobortis. Suspendisse volutpat posuere."
+};
+
+static QByteArray nick(int user)
+{
+    return "user" + QByteArray::number(user);
+}
+
+static QByteArray prefix(int user, const QByteArray& name = QByteArray())
+{
+    const QByteArray id = QByteArray::number(user);
+    return ':' + (name.isNull() ? nick(user) : name) + "!~ident" + id + "@host-" + id + ".example.org";
+}
+
+static QByteArray channel(int index)
+{
+    return "#channel" + QByteArray::number(index);
+}
+
+static QByteArray text(int index)
+{
+    return TEXTS[index % 5];
+}
+
+static QList<QByteArray> privmsgTraffic(int count)
+{
+    QList<QByteArray> lines;
+    for (int i = 0; i < count; ++i) {
+        const int user = (i * 7919) % USERS;
+        if (i % 32 == 0)
+            lines += prefix(user) + " NOTICE " + channel(i % CHANNELS) + " :" + text(i);
+        else if (i % 16 == 0)
+            lines += prefix(user) + " PRIVMSG " + channel(i % CHANNELS) + " :\1ACTION " + text(i) + '\1';
+        else
+            lines += prefix(user) + " PRIVMSG " + channel(i % CHANNELS) + " :" + text(i);
+    }
+    return lines;
+}
+
+static QList<QByteArray> churnTraffic(int count)
+{
+    QList<QByteArray> lines;
+    for (int i = 0; lines.count() < count; ++i) {
+        const int user = (i * 31) % USERS;
+        const QByteArray chan = channel(i % CHANNELS);
+        const QByteArray away = nick(user) + "|away";
+        lines += prefix(user) + " PART " + chan + " :" + text(i);
+        lines += prefix(user) + " JOIN " + chan;
+        lines += prefix(user) + " NICK :" + away;
+        lines += prefix(user, away) + " NICK :" + nick(user);
+    }
+    return lines;
+}
+
+static QList<QByteArray> netsplitTraffic(int count)
+{
+    QList<QByteArray> lines;
+    for (int i = 0; lines.count() < count; ++i) {
+        // a split takes 50 users, who then rejoin all channels
+        const int first = (i * 50) % USERS;
+        for (int user = first; user < first + 50; ++user)
+            lines += prefix(user) + " QUIT :irc.a.example.org irc.b.example.org";
+        for (int chan = 0; chan < CHANNELS; ++chan) {
+            for (int user = first; user < first + 50; ++user)
+                lines += prefix(user) + " JOIN " + channel(chan);
+            lines += ":irc.b.example.org MODE " + channel(chan) + " +oo " + nick(first) + ' ' + nick(first + 1);
+        }
+    }
+    return lines;
+}
+
+static QList<QByteArray> playbackTraffic(int count)
+{
+    QList<QByteArray> lines;
+    const QDateTime base(QDate(2020, 1, 1), QTime(0, 0), Qt::UTC);
+    for (int i = 0; lines.count() < count; ++i) {
+        // chathistory playback, 100 messages per batch
+        const QByteArray chan = channel(i % CHANNELS);
+        const QByteArray ref = "b" + QByteArray::number(i);
+        lines += ":irc.example.org BATCH +" + ref + " chathistory " + chan;
+        for (int j = 0; j < 100; ++j) {
+            const int user = (i * 100 + j) % USERS;
+            const QByteArray time = base.addMSecs((i * 100 + j) * 1500ll).toString(Qt::ISODateWithMs).toLatin1();
+            lines += "@batch=" + ref + ";time=" + time + ' ' + prefix(user) + " PRIVMSG " + chan + " :" + text(j);
+        }
+        lines += ":irc.example.org BATCH -" + ref;
+    }
+    return lines;
+}
+
+class tst_IrcIngest : public QObject
+{
+    Q_OBJECT
+
+public slots:
+    void attach(IrcBuffer* buffer);
+    void receive(IrcMessage* message);
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testIngest_data();
+    void testIngest();
+
+private:
+    void record(IrcMessage* message);
+
+    QTcpServer server;
+    QElapsedTimer timer;
+    QVector<qint64> written;
+    QVector<qint64> latencies;
+    int last = -1;
+};
+
+void tst_IrcIngest::initTestCase()
+{
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+}
+
+void tst_IrcIngest::cleanupTestCase()
+{
+    server.close();
+}
+
+void tst_IrcIngest::testIngest_data()
+{
+    QTest::addColumn<QList<QByteArray> >("traffic");
+
+    QTest::newRow("privmsg") << privmsgTraffic(50000);
+    QTest::newRow("join/part/nick churn") << churnTraffic(50000);
+    QTest::newRow("netsplits") << netsplitTraffic(50000);
+    QTest::newRow("playback") << playbackTraffic(50000);
+}
+
+void tst_IrcIngest::testIngest()
+{
+    QFETCH(QList<QByteArray>, traffic);
+
+    // the last line marks the end of the traffic
+    traffic += ":irc.example.org NOTICE communi :end of traffic";
+
+    IrcConnection connection;
+    connection.setUserName("communi");
+    connection.setNickName("communi");
+    connection.setRealName("communi");
+    connection.setHost("127.0.0.1");
+    connection.setPort(server.serverPort());
+
+    IrcBufferModel model(&connection);
+    connect(&model, SIGNAL(added(IrcBuffer*)), this, SLOT(attach(IrcBuffer*)));
+    connect(&connection, SIGNAL(messageReceived(IrcMessage*)), this, SLOT(receive(IrcMessage*)));
+
+    connection.open();
+    QVERIFY(server.waitForNewConnection(1000));
+    QScopedPointer<QTcpSocket> socket(server.nextPendingConnection());
+    QVERIFY(socket);
+
+    // registration, and a full channel list with all users
+    socket->write(":irc.example.org 001 communi :Welcome to the benchmark\r\n");
+    socket->write(":irc.example.org 005 communi PREFIX=(qaohv)~&@%+ CHANTYPES=# NETWORK=Benchmark :are supported by this server\r\n");
+    for (int chan = 0; chan < CHANNELS; ++chan) {
+        socket->write(":communi!~communi@localhost JOIN " + channel(chan) + "\r\n");
+        QByteArray names;
+        for (int user = 0; user < USERS; ++user) {
+            if (names.isEmpty())
+                names = ":irc.example.org 353 communi = " + channel(chan) + " :";
+            else
+                names += ' ';
+            names += QByteArray("  @+%").mid(user % 5, 1).trimmed() + nick(user);
+            if (user % 40 == 39 || user == USERS - 1) {
+                socket->write(names + "\r\n");
+                names.clear();
+            }
+        }
+        socket->write(":irc.example.org 366 communi " + channel(chan) + " :End of /NAMES list.\r\n");
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(model.channels().count(), CHANNELS, 10000);
+    IrcUserModel* users = model.find(QString::fromLatin1(channel(0)))->findChild<IrcUserModel*>();
+    QVERIFY(users);
+    QTRY_VERIFY_WITH_TIMEOUT(users->count() >= USERS, 10000);
+
+    QVector<QByteArray> chunks;
+    for (int i = 0; i < traffic.count(); i += CHUNK) {
+        QByteArray chunk;
+        for (int j = i; j < qMin(i + CHUNK, traffic.count()); ++j) {
+            // every line carries a msgid, which identifies its chunk
+            const QByteArray msgid = "msgid=" + QByteArray::number(j);
+            const QByteArray& line = traffic.at(j);
+            if (line.startsWith('@'))
+                chunk += '@' + msgid + ';' + line.mid(1) + "\r\n";
+            else
+                chunk += '@' + msgid + ' ' + line + "\r\n";
+        }
+        chunks += chunk;
+    }
+
+    // wake up the event loop now and then, should a write stall
+    QTimer ticker;
+    ticker.start(100);
+
+    written.clear();
+    latencies.clear();
+    latencies.reserve(traffic.count());
+    last = -1;
+
+    qint64 bytes = 0;
+    timer.start();
+    while (last < traffic.count() - 1 && timer.elapsed() < 60000) {
+        while (written.count() < chunks.count() && written.count() - (last + 1) / CHUNK < WINDOW) {
+            written += timer.nsecsElapsed();
+            bytes += socket->write(chunks.at(written.count() - 1));
+        }
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+    QCOMPARE(last, traffic.count() - 1);
+    QVERIFY(!latencies.isEmpty());
+
+    connection.close();
+
+    std::sort(latencies.begin(), latencies.end());
+    const int n = latencies.count();
+    qInfo("%d lines, %.0f msgs/s, %.2f MB/s, latency p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us",
+          traffic.count(), traffic.count() * 1e9 / elapsed, bytes * 1e3 / elapsed,
+          latencies.at(n / 2) / 1e3, latencies.at(n * 9 / 10) / 1e3,
+          latencies.at(qMin(n - 1, n * 99 / 100)) / 1e3, latencies.last() / 1e3);
+
+    QTest::setBenchmarkResult(bytes * 1e9 / elapsed, QTest::BytesPerSecond);
+}
+
+void tst_IrcIngest::attach(IrcBuffer* buffer)
+{
+    IrcChannel* channel = buffer->toChannel();
+    if (channel) {
+        IrcUserModel* users = new IrcUserModel(channel);
+        users->setChannel(channel);
+    }
+}
+
+void tst_IrcIngest::receive(IrcMessage* message)
+{
+    record(message);
+    if (message->type() == IrcMessage::Batch) {
+        foreach (IrcMessage* msg, static_cast<IrcBatchMessage*>(message)->messages())
+            record(msg);
+    }
+}
+
+void tst_IrcIngest::record(IrcMessage* message)
+{
+    bool ok = false;
+    const int index = message->tag(QStringLiteral("msgid")).toInt(&ok);
+    if (ok && timer.isValid() && index / CHUNK < written.count()) {
+        latencies += timer.nsecsElapsed() - written.at(index / CHUNK);
+        last = qMax(last, index);
+    }
+}
+
+QTEST_MAIN(tst_IrcIngest)
+
+#include "tst_ircingest.moc"